@@ -0,0 +1,130 @@
+/**
+ * @file ompt-bench-kernels.c
+ * @brief Scaled-up versions of the examples in examples/omp, each of which
+ * repeats one OpenMP construct many times so that the cost of the OMPT
+ * callbacks it triggers can be measured. The number of threads is taken from
+ * OMP_NUM_THREADS as usual.
+ *
+ * Prints "<constructs> <elapsed_ns>" to stdout, where elapsed_ns excludes the
+ * start-up and shut-down of the runtime and any tool.
+ *
+ * usage: ompt-bench-kernels kernel [repetitions]
+ */
+
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* A trivial amount of work which the compiler cannot remove */
+static volatile int sink = 0;
+#define WORK() (sink++)
+
+/* Each construct is a parallel region containing a worksharing loop */
+static void parallel_for(long reps) {
+  for (long r = 0; r < reps; r++) {
+#pragma omp parallel for
+    for (int k = 0; k < 64; k++) {
+      WORK();
+    }
+  }
+}
+
+/* Each construct is an explicit task spawned from a single region */
+static void spawn_n_tasks(long reps) {
+#pragma omp parallel
+#pragma omp single nowait
+  for (long r = 0; r < reps; r++) {
+#pragma omp task
+    WORK();
+  }
+}
+
+/* Each construct is a taskloop creating one task per thread */
+static void taskloop(long reps) {
+#pragma omp parallel
+#pragma omp single
+  for (long r = 0; r < reps; r++) {
+#pragma omp taskloop num_tasks(omp_get_num_threads())
+    for (int k = 0; k < 64; k++) {
+      WORK();
+    }
+  }
+}
+
+/* Each construct is a parallel region nested inside another on each thread */
+static void nested_parallel(long reps) {
+  omp_set_max_active_levels(2);
+#pragma omp parallel
+  for (long r = 0; r < reps; r++) {
+#pragma omp parallel num_threads(2)
+    WORK();
+  }
+}
+
+/* Each construct is a taskgroup around a single explicit task */
+static void taskgroup(long reps) {
+#pragma omp parallel
+#pragma omp single
+  for (long r = 0; r < reps; r++) {
+#pragma omp taskgroup
+    {
+#pragma omp task
+      WORK();
+    }
+  }
+}
+
+typedef struct kernel_t {
+  const char *name;
+  void (*run)(long reps);
+  long default_reps;
+} kernel_t;
+
+static const kernel_t kernels[] = {
+    {"parallel-for", parallel_for, 10000},
+    {"spawn-n-tasks", spawn_n_tasks, 100000},
+    {"taskloop", taskloop, 10000},
+    {"nested-parallel", nested_parallel, 1000},
+    {"taskgroup", taskgroup, 100000},
+};
+
+#define N_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+int main(int argc, char *argv[]) {
+  const kernel_t *kernel = NULL;
+  for (size_t k = 0; argc > 1 && k < N_KERNELS; k++) {
+    if (strcmp(argv[1], kernels[k].name) == 0) {
+      kernel = &kernels[k];
+    }
+  }
+
+  if (kernel == NULL) {
+    fprintf(stderr, "usage: %s kernel [repetitions]\nkernels:", argv[0]);
+    for (size_t k = 0; k < N_KERNELS; k++) {
+      fprintf(stderr, " %s", kernels[k].name);
+    }
+    fprintf(stderr, "\n");
+    return EXIT_FAILURE;
+  }
+
+  long reps = argc > 2 ? atol(argv[2]) : kernel->default_reps;
+
+  /* Start the runtime (and tool) before timing */
+#pragma omp parallel
+  WORK();
+
+  double start = omp_get_wtime();
+  kernel->run(reps);
+  double elapsed = omp_get_wtime() - start;
+
+  /* nested-parallel repeats its construct on every outer thread */
+  long constructs = reps;
+  if (kernel->run == nested_parallel) {
+    constructs *= omp_get_max_threads();
+  }
+
+  printf("%ld %.0f\n", constructs, elapsed * 1e9);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+#!/usr/bin/env bash
+# Measure the overhead of the otter-ompt tool on the kernels in
+# ompt-bench-kernels.c. Each kernel is run with and without the tool loaded
+# through OMP_TOOL_LIBRARIES for a sweep of thread counts, and the best of
+# several runs is kept. The number of events is taken from one further run with
+# OTTER_SELF_PROFILE set, which is not timed as self-profiling adds its own
+# overhead. Prints CSV to stdout.
+#
+# usage: ompt-bench.sh kernels-exe libotter-ompt.so [max_threads] [runs]
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 kernels-exe libotter-ompt.so [max_threads] [runs]" >&2
+    exit 1
+fi
+
+KERNELS_EXE=$(realpath "$1")
+TOOL=$(realpath "$2")
+MAX_THREADS=${3:-$(nproc)}
+RUNS=${4:-3}
+
+# The callbacks each kernel is intended to exercise
+declare -A CALLBACKS=(
+    [parallel-for]="parallel_begin/end+work(loop)"
+    [spawn-n-tasks]="task_create+task_schedule"
+    [taskloop]="work(taskloop)+task_create+task_schedule"
+    [nested-parallel]="parallel_begin/end(nested)"
+    [taskgroup]="sync_region(taskgroup)"
+)
+
+SCRATCH=$(mktemp -d)
+trap 'rm -rf "$SCRATCH"' EXIT
+
+# Print the lowest elapsed_ns of $RUNS runs of a kernel, followed by the number
+# of constructs. Arguments are passed to env before the kernels executable.
+best_of_runs() {
+    local best="" constructs="" elapsed=""
+    for ((run = 0; run < RUNS; run++)); do
+        rm -rf "$SCRATCH/trace"
+        read -r constructs elapsed < <(env "$@" "$KERNELS_EXE" "$KERNEL" 2>"$SCRATCH/stderr")
+        if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]; then
+            best=$elapsed
+        fi
+    done
+    echo "$constructs $best"
+}
+
+# Run a kernel once with the tool and self-profiling, keeping only its stderr.
+# Arguments are passed to env before the kernels executable.
+self_profiled_run() {
+    rm -rf "$SCRATCH/trace"
+    env "$@" OTTER_SELF_PROFILE=1 "$KERNELS_EXE" "$KERNEL" \
+        >/dev/null 2>"$SCRATCH/stderr"
+}
+
+# Sum the size of the OTF2 files of the last traced run, excluding aux/
+trace_bytes() {
+    find "$SCRATCH/trace" -path '*/aux' -prune -o -type f -printf '%s\n' 2>/dev/null \
+        | awk '{ total += $1 } END { print total + 0 }'
+}
+
+# The number of events written, from the OTTER_SELF_PROFILE summary of the
+# last self-profiled run
+trace_events() {
+    awk '/event writes:/ { print $3; found = 1 } END { if (!found) print 0 }' \
+        "$SCRATCH/stderr"
+}
+
+THREAD_COUNTS=()
+for ((threads = 1; threads < MAX_THREADS; threads *= 2)); do
+    THREAD_COUNTS+=("$threads")
+done
+THREAD_COUNTS+=("$MAX_THREADS")
+
+echo "kernel,callbacks,threads,constructs,base_ns,tool_ns,overhead_ns_per_construct,events,events_per_construct,trace_bytes,bytes_per_event"
+for KERNEL in parallel-for spawn-n-tasks taskloop nested-parallel taskgroup; do
+    for threads in "${THREAD_COUNTS[@]}"; do
+        read -r constructs base_ns < <(best_of_runs OMP_NUM_THREADS="$threads")
+        read -r _ tool_ns < <(best_of_runs OMP_NUM_THREADS="$threads" \
+            OMP_TOOL_LIBRARIES="$TOOL" OTTER_TRACE_PATH="$SCRATCH/trace")
+        bytes=$(trace_bytes)
+        self_profiled_run OMP_NUM_THREADS="$threads" \
+            OMP_TOOL_LIBRARIES="$TOOL" OTTER_TRACE_PATH="$SCRATCH/trace"
+        events=$(trace_events)
+        awk -v k="$KERNEL" -v cb="${CALLBACKS[$KERNEL]}" -v t="$threads" \
+            -v c="$constructs" -v b="$base_ns" -v o="$tool_ns" -v e="$events" \
+            -v s="$bytes" 'BEGIN {
+                printf "%s,%s,%d,%d,%.0f,%.0f,%.1f,%d,%.2f,%.0f,%.1f\n", k, cb, t, c,
+                    b, o, (o - b) / c, e, e / c, s, (e > 0 ? s / e : 0)
+            }'
+    done
+done
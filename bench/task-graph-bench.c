@@ -0,0 +1,311 @@
+/**
+ * @file task-graph-bench.c
+ * @brief Microbenchmarks for the otter-task-graph API. Each benchmark times
+ * `iterations` calls of one entry point on each of N threads, for N from 1 up
+ * to the number of cores, and reports the mean time and number of heap
+ * allocations per call as CSV on stdout.
+ *
+ * usage: task-graph-bench [iterations] [max_threads]
+ */
+
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* call the API directly rather than through the OTTER_* macros */
+#define OTTER_USE_PRIVATE_HEADER
+#include "api/otter-task-graph/otter-task-graph.h"
+
+#define BENCH_SRC __FILE__, __func__, __LINE__
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*   ALLOCATION COUNTING                                                     */
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Interpose the allocator so that every heap allocation made by this thread,
+   including those made inside Otter, is counted. Only supported with glibc,
+   otherwise allocations are reported as -1. */
+
+static __thread uint64_t thread_allocs = 0;
+
+#if defined(__GLIBC__)
+#define BENCH_COUNT_ALLOCS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+  thread_allocs++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+  thread_allocs++;
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  thread_allocs++;
+  return __libc_realloc(ptr, size);
+}
+#else
+#define BENCH_COUNT_ALLOCS 0
+#endif
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*   BENCHMARKS                                                              */
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Per-thread state passed to each stage of a benchmark */
+typedef struct bench_thread_t {
+  int id;
+  size_t iterations;
+  char label[32];
+  otter_task_context *parent;
+  otter_task_context **tasks;
+} bench_thread_t;
+
+typedef void(bench_stage_fn)(bench_thread_t *);
+
+/* A benchmark is an untimed setup stage, a timed stage which makes
+   `iterations` calls of the entry point, and an untimed teardown stage */
+typedef struct bench_t {
+  const char *name;
+  bool single_threaded;
+  bench_stage_fn *setup;
+  bench_stage_fn *timed;
+  bench_stage_fn *teardown;
+} bench_t;
+
+static void init_tasks(bench_thread_t *t) {
+  for (size_t k = 0; k < t->iterations; k++) {
+    t->tasks[k] = otterTaskInitialise(t->parent, 0, otter_no_add_to_pool,
+                                      false, BENCH_SRC, "%s", t->label);
+  }
+}
+
+static void init_and_start_tasks(bench_thread_t *t) {
+  init_tasks(t);
+  for (size_t k = 0; k < t->iterations; k++) {
+    otterTaskStart(t->tasks[k], BENCH_SRC);
+  }
+}
+
+static void init_and_push_tasks(bench_thread_t *t) {
+  init_tasks(t);
+  for (size_t k = 0; k < t->iterations; k++) {
+    otterTaskPushLabel(t->tasks[k], "%s", t->label);
+  }
+}
+
+static void start_tasks(bench_thread_t *t) {
+  for (size_t k = 0; k < t->iterations; k++) {
+    otterTaskStart(t->tasks[k], BENCH_SRC);
+  }
+}
+
+static void end_tasks(bench_thread_t *t) {
+  for (size_t k = 0; k < t->iterations; k++) {
+    otterTaskEnd(t->tasks[k], BENCH_SRC);
+  }
+}
+
+static void start_and_end_tasks(bench_thread_t *t) {
+  start_tasks(t);
+  end_tasks(t);
+}
+
+static void pop_start_and_end_tasks(bench_thread_t *t) {
+  for (size_t k = 0; k < t->iterations; k++) {
+    otterTaskPopLabel("%s", t->label);
+  }
+  start_and_end_tasks(t);
+}
+
+static void create_tasks(bench_thread_t *t) {
+  for (size_t k = 0; k < t->iterations; k++) {
+    otterTaskCreate(t->tasks[k], t->parent, BENCH_SRC);
+  }
+}
+
+static void push_tasks(bench_thread_t *t) {
+  for (size_t k = 0; k < t->iterations; k++) {
+    otterTaskPushLabel(t->tasks[k], "%s", t->label);
+  }
+}
+
+static void pop_tasks(bench_thread_t *t) {
+  for (size_t k = 0; k < t->iterations; k++) {
+    otterTaskPopLabel("%s", t->label);
+  }
+}
+
+static void init_one_and_push(bench_thread_t *t) {
+  t->tasks[0] = otterTaskInitialise(t->parent, 0, otter_add_to_pool, false,
+                                    BENCH_SRC, "%s", t->label);
+}
+
+static void borrow_tasks(bench_thread_t *t) {
+  for (size_t k = 0; k < t->iterations; k++) {
+    otterTaskBorrowLabel("%s", t->label);
+  }
+}
+
+static void pop_one_start_and_end(bench_thread_t *t) {
+  otter_task_context *task = otterTaskPopLabel("%s", t->label);
+  otterTaskStart(task, BENCH_SRC);
+  otterTaskEnd(task, BENCH_SRC);
+}
+
+static void synchronise_tasks(bench_thread_t *t) {
+  for (size_t k = 0; k < t->iterations; k++) {
+    otterSynchroniseTasks(t->parent, otter_sync_children,
+                          otter_endpoint_discrete);
+  }
+}
+
+static void begin_and_end_phases(bench_thread_t *t) {
+  for (size_t k = 0; k < t->iterations; k++) {
+    otterPhaseBegin("bench", BENCH_SRC);
+    otterPhaseEnd(BENCH_SRC);
+  }
+}
+
+static const bench_t benchmarks[] = {
+    {"otterTaskInitialise", false, NULL, init_tasks, start_and_end_tasks},
+    {"otterTaskCreate", false, init_tasks, create_tasks, start_and_end_tasks},
+    {"otterTaskStart", false, init_tasks, start_tasks, end_tasks},
+    {"otterTaskEnd", false, init_and_start_tasks, end_tasks, NULL},
+    {"otterTaskPushLabel", false, init_tasks, push_tasks,
+     pop_start_and_end_tasks},
+    {"otterTaskPopLabel", false, init_and_push_tasks, pop_tasks,
+     start_and_end_tasks},
+    {"otterTaskBorrowLabel", false, init_one_and_push, borrow_tasks,
+     pop_one_start_and_end},
+    {"otterSynchroniseTasks", false, NULL, synchronise_tasks, NULL},
+    /* phases are global, so can only be measured on one thread. Each call is
+       a matching otterPhaseBegin/otterPhaseEnd pair */
+    {"otterPhaseBegin+End", true, NULL, begin_and_end_phases, NULL},
+};
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*   DRIVER                                                                  */
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+typedef struct bench_run_t {
+  const bench_t *bench;
+  pthread_barrier_t *barrier;
+  bench_thread_t thread;
+  uint64_t elapsed_ns;
+  uint64_t allocs;
+} bench_run_t;
+
+static uint64_t now_ns(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * (uint64_t)1000000000 + time.tv_nsec;
+}
+
+static void *run_bench_thread(void *arg) {
+  bench_run_t *run = (bench_run_t *)arg;
+  bench_thread_t *t = &run->thread;
+
+  snprintf(t->label, sizeof(t->label), "bench-%d", t->id);
+  t->parent = otterTaskInitialise(NULL, 0, otter_no_add_to_pool, false,
+                                  BENCH_SRC, "bench-parent-%d", t->id);
+  otterTaskStart(t->parent, BENCH_SRC);
+  if (run->bench->setup != NULL) {
+    run->bench->setup(t);
+  }
+
+  pthread_barrier_wait(run->barrier);
+  uint64_t allocs = thread_allocs;
+  uint64_t start = now_ns();
+  run->bench->timed(t);
+  run->elapsed_ns = now_ns() - start;
+  run->allocs = thread_allocs - allocs;
+  pthread_barrier_wait(run->barrier);
+
+  if (run->bench->teardown != NULL) {
+    run->bench->teardown(t);
+  }
+  otterTaskEnd(t->parent, BENCH_SRC);
+  return NULL;
+}
+
+static void run_bench(const bench_t *bench, int threads, size_t iterations) {
+  pthread_t *handles = calloc(threads, sizeof(*handles));
+  bench_run_t *runs = calloc(threads, sizeof(*runs));
+  pthread_barrier_t barrier;
+  pthread_barrier_init(&barrier, NULL, threads);
+
+  for (int k = 0; k < threads; k++) {
+    runs[k].bench = bench;
+    runs[k].barrier = &barrier;
+    runs[k].thread.id = k;
+    runs[k].thread.iterations = iterations;
+    runs[k].thread.tasks = calloc(iterations, sizeof(otter_task_context *));
+    pthread_create(&handles[k], NULL, run_bench_thread, &runs[k]);
+  }
+
+  uint64_t elapsed_ns = 0;
+  uint64_t allocs = 0;
+  for (int k = 0; k < threads; k++) {
+    pthread_join(handles[k], NULL);
+    elapsed_ns += runs[k].elapsed_ns;
+    allocs += runs[k].allocs;
+    free(runs[k].thread.tasks);
+  }
+
+  double calls = (double)iterations * threads;
+  printf("%s,%d,%zu,%.1f,", bench->name, threads, iterations,
+         (double)elapsed_ns / calls);
+  if (BENCH_COUNT_ALLOCS) {
+    printf("%.2f\n", (double)allocs / calls);
+  } else {
+    printf("-1\n");
+  }
+  fflush(stdout);
+
+  pthread_barrier_destroy(&barrier);
+  free(runs);
+  free(handles);
+}
+
+int main(int argc, char *argv[]) {
+  size_t iterations = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000;
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int max_threads = argc > 2 ? atoi(argv[2]) : (int)(cores > 0 ? cores : 1);
+
+  if (iterations == 0 || max_threads < 1) {
+    fprintf(stderr, "usage: %s [iterations] [max_threads]\n", argv[0]);
+    return 1;
+  }
+
+  otterTraceInitialise(BENCH_SRC);
+
+  printf("benchmark,threads,iterations,ns_per_call,allocs_per_call\n");
+  for (size_t b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); b++) {
+    const bench_t *bench = &benchmarks[b];
+    /* sweep powers of 2, always including max_threads */
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+      run_bench(bench, threads, iterations);
+      if (bench->single_threaded)
+        break;
+      if (threads < max_threads && threads * 2 > max_threads)
+        run_bench(bench, max_threads, iterations);
+    }
+  }
+
+  otterTraceFinalise(BENCH_SRC);
+  return 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * Record C++20 coroutines as tasks with otter::TaskPromise. Each call to a
+ * coroutine creates a task which is a child of the coroutine awaiting it, and
+ * each time a coroutine yields to the scheduler below its task is suspended
+ * and later resumed.
+ */
+
+#include <coroutine>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+
+#include "api/otter-task-graph/otter-task-graph-wrapper.hpp"
+
+// coroutines ready to be resumed, in the order they became ready
+static std::deque<std::coroutine_handle<>> ready;
+
+/* Suspend the awaiting coroutine until the scheduler resumes it */
+struct yield_to_scheduler {
+  bool await_ready() noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> handle) {
+    ready.push_back(handle);
+  }
+  void await_resume() noexcept {}
+};
+
+/* A lazy coroutine returning an int, which resumes the coroutine awaiting it
+   when it finishes */
+class Job {
+public:
+  struct promise_type : otter::TaskPromise {
+    promise_type() : otter::TaskPromise("job") {}
+
+    Job get_return_object() {
+      return Job{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+
+    struct resume_continuation {
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<>
+      await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+        std::coroutine_handle<> next = handle.promise().continuation;
+        return next ? next : std::noop_coroutine();
+      }
+      void await_resume() noexcept {}
+    };
+
+    // record the end of the task before resuming the awaiting coroutine
+    auto final_suspend() noexcept {
+      return traced_final(resume_continuation{});
+    }
+
+    void return_value(int value) { result = value; }
+    void unhandled_exception() { std::terminate(); }
+
+    std::coroutine_handle<> continuation;
+    int result = 0;
+  };
+
+  Job(Job &&other) : m_handle{other.m_handle} { other.m_handle = nullptr; }
+  Job(const Job &) = delete;
+  Job &operator=(const Job &) = delete;
+  Job &operator=(Job &&) = delete;
+
+  ~Job() {
+    if (m_handle) {
+      m_handle.destroy();
+    }
+  }
+
+  /* Start the job from outside any coroutine */
+  void start() { ready.push_back(m_handle); }
+  bool done() const { return m_handle.done(); }
+  int result() const { return m_handle.promise().result; }
+
+  bool await_ready() noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+    m_handle.promise().continuation = awaiting;
+    return m_handle;
+  }
+  int await_resume() { return m_handle.promise().result; }
+
+private:
+  explicit Job(std::coroutine_handle<promise_type> handle)
+      : m_handle{handle} {}
+
+  std::coroutine_handle<promise_type> m_handle;
+};
+
+/* Sum 1..n, yielding to the scheduler after every step */
+Job sum(int n) {
+  int total = 0;
+  for (int k = 1; k <= n; k++) {
+    total += k;
+    co_await yield_to_scheduler{};
+  }
+  co_return total;
+}
+
+/* Await two child jobs one after the other */
+Job pair(int n) {
+  int first = co_await sum(n);
+  int second = co_await sum(2 * n);
+  co_return first + second;
+}
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? std::atoi(argv[1]) : 4;
+
+  otter::Otter &otter = otter::Otter::get_otter();
+
+  Job a = pair(n);
+  Job b = pair(n + 1);
+  a.start();
+  b.start();
+  while (!ready.empty()) {
+    std::coroutine_handle<> next = ready.front();
+    ready.pop_front();
+    next.resume();
+  }
+
+  std::printf("pair(%d) = %d, pair(%d) = %d\n", n, a.result(), n + 1,
+              b.result());
+  int status = a.done() && b.done() ? 0 : 1;
+
+  otter.close();
+  return status;
+}
@@ -0,0 +1,313 @@
+/**
+ * @file task-graph-generator.c
+ * @brief Generate a synthetic, parameterised task graph for stress-testing
+ * Otter. In each phase a root task spawns a number of subtrees which are
+ * handed to a pool of pthreads. Each subtree is a tree of the given depth and
+ * fan-out whose leaves execute a chain of dependent tasks. Every task spins for
+ * a duration drawn from the given granularity distribution.
+ *
+ * The total number of tasks is
+ *   phases * (1 + subtrees * (sum_{d<depth} fanout^d + fanout^(depth-1) * chain))
+ * so tens of millions of tasks are easily generated e.g. with -d 7 -f 10.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "api/otter-task-graph/otter-task-graph-user.h"
+
+/* Labels used for tasks at each depth. With -p, the subtree and depth labels
+   are also used to hand tasks off through the task pool */
+static const char *subtree_label = "subtree %d";
+static const char *depth_label = "thread %d depth %d";
+static const char *chain_label = "chain";
+
+typedef enum { dist_fixed, dist_uniform, dist_exp } distribution_t;
+
+typedef struct options_t {
+  int threads;
+  int depth;
+  int fanout;
+  int chain;
+  int subtrees;
+  int phases;
+  bool use_pool;
+  distribution_t dist;
+  double dist_a; // fixed/mean/min duration (ns)
+  double dist_b; // max duration (ns) for the uniform distribution
+  unsigned seed;
+} options_t;
+
+static options_t opt = {
+    .threads = 1,
+    .depth = 4,
+    .fanout = 4,
+    .chain = 0,
+    .subtrees = 0, // default: 4 per thread
+    .phases = 1,
+    .use_pool = false,
+    .dist = dist_fixed,
+    .dist_a = 0.0,
+    .dist_b = 0.0,
+    .seed = 1,
+};
+
+/* Shared state for the subtrees of the present phase */
+static otter_task_context **subtree_tasks = NULL; // not used with -p
+static int next_subtree = 0;
+
+typedef struct worker_t {
+  int id;
+  uint64_t rng;
+  uint64_t tasks;
+} worker_t;
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*   TASK GRANULARITY                                                        */
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static uint64_t now_ns(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * (uint64_t)1000000000 + time.tv_nsec;
+}
+
+/* xorshift64*, returns a uniform double in [0,1) */
+static double next_uniform(worker_t *worker) {
+  worker->rng ^= worker->rng >> 12;
+  worker->rng ^= worker->rng << 25;
+  worker->rng ^= worker->rng >> 27;
+  return (double)((worker->rng * 2685821657736338717ull) >> 11) /
+         (double)(1ull << 53);
+}
+
+static uint64_t task_duration(worker_t *worker) {
+  switch (opt.dist) {
+  case dist_uniform:
+    return opt.dist_a + (opt.dist_b - opt.dist_a) * next_uniform(worker);
+  case dist_exp:
+    return -opt.dist_a * __builtin_log(1.0 - next_uniform(worker));
+  case dist_fixed:
+  default:
+    return opt.dist_a;
+  }
+}
+
+static void do_work(worker_t *worker) {
+  uint64_t duration = task_duration(worker);
+  if (duration == 0) {
+    return;
+  }
+  uint64_t end = now_ns() + duration;
+  while (now_ns() < end)
+    ;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*   GRAPH GENERATION                                                        */
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* A chain of tasks, each of which must wait for the previous one */
+static void run_chain(worker_t *worker, otter_task_context *leaf) {
+  for (int k = 0; k < opt.chain; k++) {
+    OTTER_DEFINE_TASK(link, leaf, otter_no_add_to_pool, chain_label);
+    OTTER_TASK_START(link);
+    do_work(worker);
+    OTTER_TASK_END(link);
+    OTTER_TASK_WAIT_FOR(leaf, children);
+    worker->tasks++;
+  }
+}
+
+/* Run a task at the given depth, then recursively generate and run its
+   children. With -p each child is handed off through the task pool */
+static void run_tree(worker_t *worker, otter_task_context *task, int depth) {
+  OTTER_TASK_START(task);
+  do_work(worker);
+  worker->tasks++;
+
+  if (depth + 1 < opt.depth) {
+    for (int k = 0; k < opt.fanout; k++) {
+      OTTER_DEFINE_TASK(child, task, otter_no_add_to_pool, depth_label,
+                        worker->id, depth + 1);
+      if (opt.use_pool) {
+        OTTER_POOL_ADD(child, depth_label, worker->id, depth + 1);
+        OTTER_POOL_POP(child, depth_label, worker->id, depth + 1);
+      }
+      run_tree(worker, child, depth + 1);
+    }
+    OTTER_TASK_WAIT_FOR(task, children);
+  } else {
+    run_chain(worker, task);
+  }
+
+  OTTER_TASK_END(task);
+}
+
+/* Run subtrees created by the main thread until none remain */
+static void *run_worker(void *arg) {
+  worker_t *worker = (worker_t *)arg;
+  int subtree = 0;
+  while ((subtree = __atomic_fetch_add(&next_subtree, 1, __ATOMIC_RELAXED)) <
+         opt.subtrees) {
+    OTTER_DECLARE_HANDLE(task);
+    if (opt.use_pool) {
+      OTTER_POOL_POP(task, subtree_label, subtree);
+    } else {
+      task = subtree_tasks[subtree];
+    }
+    run_tree(worker, task, 0);
+  }
+  return NULL;
+}
+
+static void run_phase(int phase, worker_t *workers, pthread_t *threads) {
+  char phase_name[64] = {0};
+  snprintf(phase_name, sizeof(phase_name), "phase %d", phase);
+  OTTER_PHASE_BEGIN(phase_name);
+
+  OTTER_DEFINE_TASK(root, OTTER_NULL_TASK, otter_no_add_to_pool, "root");
+  OTTER_TASK_START(root);
+  for (int k = 0; k < opt.subtrees; k++) {
+    OTTER_DEFINE_TASK(subtree, root, otter_no_add_to_pool, subtree_label, k);
+    if (opt.use_pool) {
+      OTTER_POOL_ADD(subtree, subtree_label, k);
+    } else {
+      subtree_tasks[k] = subtree;
+    }
+  }
+
+  next_subtree = 0;
+  for (int k = 0; k < opt.threads; k++) {
+    pthread_create(&threads[k], NULL, run_worker, &workers[k]);
+  }
+  for (int k = 0; k < opt.threads; k++) {
+    pthread_join(threads[k], NULL);
+  }
+
+  OTTER_TASK_WAIT_FOR(root, descendants);
+  OTTER_TASK_END(root);
+  OTTER_PHASE_END();
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*   OPTIONS                                                                 */
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  -t threads    number of pthreads (default 1)\n"
+          "  -d depth      depth of each subtree (default 4)\n"
+          "  -f fanout     children of each non-leaf task (default 4)\n"
+          "  -c chain      length of the chain of tasks run by each leaf "
+          "(default 0)\n"
+          "  -s subtrees   subtrees per phase (default 4 per thread)\n"
+          "  -n phases     number of phases (default 1)\n"
+          "  -g dist       task granularity in ns, one of fixed:NS (default "
+          "fixed:0),\n"
+          "                uniform:MIN:MAX or exp:MEAN\n"
+          "  -p            hand tasks off through the task pool\n"
+          "  -S seed       random seed (default 1)\n",
+          prog);
+}
+
+static bool parse_distribution(const char *arg) {
+  if (sscanf(arg, "fixed:%lf", &opt.dist_a) == 1) {
+    opt.dist = dist_fixed;
+  } else if (sscanf(arg, "uniform:%lf:%lf", &opt.dist_a, &opt.dist_b) == 2 &&
+             opt.dist_b >= opt.dist_a) {
+    opt.dist = dist_uniform;
+  } else if (sscanf(arg, "exp:%lf", &opt.dist_a) == 1) {
+    opt.dist = dist_exp;
+  } else {
+    return false;
+  }
+  return opt.dist_a >= 0.0;
+}
+
+int main(int argc, char *argv[]) {
+  int c = 0;
+  while ((c = getopt(argc, argv, "t:d:f:c:s:n:g:pS:h")) != -1) {
+    switch (c) {
+    case 't':
+      opt.threads = atoi(optarg);
+      break;
+    case 'd':
+      opt.depth = atoi(optarg);
+      break;
+    case 'f':
+      opt.fanout = atoi(optarg);
+      break;
+    case 'c':
+      opt.chain = atoi(optarg);
+      break;
+    case 's':
+      opt.subtrees = atoi(optarg);
+      break;
+    case 'n':
+      opt.phases = atoi(optarg);
+      break;
+    case 'g':
+      if (!parse_distribution(optarg)) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'p':
+      opt.use_pool = true;
+      break;
+    case 'S':
+      opt.seed = (unsigned)atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (opt.subtrees == 0) {
+    opt.subtrees = 4 * opt.threads;
+  }
+  if (opt.threads < 1 || opt.depth < 1 || opt.fanout < 0 || opt.chain < 0 ||
+      opt.subtrees < 1 || opt.phases < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  subtree_tasks = calloc(opt.subtrees, sizeof(otter_task_context *));
+  pthread_t *threads = calloc(opt.threads, sizeof(pthread_t));
+  worker_t *workers = calloc(opt.threads, sizeof(worker_t));
+  for (int k = 0; k < opt.threads; k++) {
+    workers[k].id = k;
+    workers[k].rng = 0x9e3779b97f4a7c15ull * (opt.seed + k + 1);
+  }
+
+  OTTER_INITIALISE();
+
+  uint64_t start = now_ns();
+  for (int phase = 0; phase < opt.phases; phase++) {
+    run_phase(phase, workers, threads);
+  }
+  uint64_t elapsed = now_ns() - start;
+
+  OTTER_FINALISE();
+
+  uint64_t tasks = opt.phases; // one root task per phase
+  for (int k = 0; k < opt.threads; k++) {
+    tasks += workers[k].tasks;
+  }
+  printf("threads=%d tasks=%lu elapsed=%.3fs rate=%.0f tasks/s\n", opt.threads,
+         (unsigned long)tasks, elapsed / 1e9, tasks / (elapsed / 1e9));
+
+  free(workers);
+  free(threads);
+  free(subtree_tasks);
+  return 0;
+}
@@ -0,0 +1,121 @@
+/**
+ * Select what the C++ wrapper records with tracing policies. Kernel tasks are
+ * recorded in full, setup tasks only in the profile summary and helper tasks
+ * not at all. When built as C++20, coroutines are traced with each policy too.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <type_traits>
+
+#include "api/otter-task-graph/otter-task-graph-wrapper.hpp"
+
+#if defined(OTTER_HAVE_COROUTINES)
+#include <exception>
+#endif
+
+constexpr bool trace_helpers = false;
+
+using Kernel = otter::BasicTask<otter::policy::full>;
+using Setup = otter::BasicTask<otter::policy::profile>;
+using Helper = otter::BasicTask<otter::policy::select<trace_helpers>>;
+
+static_assert(
+    std::is_same<Helper, otter::BasicTask<otter::policy::disabled>>::value,
+    "helpers should be disabled");
+static_assert(std::is_empty<Helper>::value, "a disabled task holds no state");
+
+static double kernel(Kernel &parent, int k) {
+  Kernel task = parent.make_child(0, "kernel %d", k);
+  double x = 0.0;
+  for (int j = 1; j <= 1000; j++) {
+    x += 1.0 / (j + k);
+  }
+  // a helper records nothing, even as a child of a fully recorded task
+  Helper helper =
+      task.make_child<otter::policy::select<trace_helpers>>(0, "helper %d", k);
+  helper.end_task();
+  return x;
+}
+
+#if defined(OTTER_HAVE_COROUTINES)
+
+/* A coroutine returning nothing, traced with the given policy */
+template <typename Policy> class Job {
+public:
+  struct promise_type : otter::BasicTaskPromise<Policy> {
+    promise_type() : otter::BasicTaskPromise<Policy>("job") {}
+
+    Job get_return_object() {
+      return Job{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  Job(Job &&other) : m_handle{other.m_handle} { other.m_handle = nullptr; }
+  Job(const Job &) = delete;
+  Job &operator=(const Job &) = delete;
+  Job &operator=(Job &&) = delete;
+
+  ~Job() {
+    if (m_handle) {
+      m_handle.destroy();
+    }
+  }
+
+  /* Resume the coroutine until it finishes */
+  void run() {
+    while (!m_handle.done()) {
+      m_handle.resume();
+    }
+  }
+
+private:
+  explicit Job(std::coroutine_handle<promise_type> handle)
+      : m_handle{handle} {}
+
+  std::coroutine_handle<promise_type> m_handle;
+};
+
+template <typename Policy> Job<Policy> job(int k) {
+  co_await std::suspend_always{};
+  std::printf("job %d resumed\n", k);
+}
+
+static void run_jobs(void) {
+  job<otter::policy::full>(0).run();
+  job<otter::policy::profile>(1).run();
+  job<otter::policy::disabled>(2).run();
+}
+
+#else
+
+static void run_jobs(void) {}
+
+#endif // OTTER_HAVE_COROUTINES
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? std::atoi(argv[1]) : 4;
+
+  otter::Otter &otter = otter::Otter::get_otter();
+
+  {
+    Setup setup(0, "setup");
+    setup.end_task();
+  }
+
+  Kernel step(0, "step");
+  double total = 0.0;
+  for (int k = 0; k < n; k++) {
+    total += kernel(step, k);
+  }
+  step.synchronise_tasks(otter_sync_children);
+  step.end_task();
+
+  run_jobs();
+
+  std::printf("total = %f\n", total);
+  otter.close();
+  return 0;
+}
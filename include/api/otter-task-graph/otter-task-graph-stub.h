@@ -44,6 +44,7 @@
 #define OTTER_DECLARE_HANDLE(...)
 #define OTTER_INIT_TASK(...)
 #define OTTER_DEFINE_TASK(...)
+#define OTTER_INIT_TASK_RANGE(...)
 #define OTTER_POOL_ADD(...)
 #define OTTER_POOL_POP(...)
 #define OTTER_POOL_BORROW(...)
@@ -51,9 +52,19 @@
 #define OTTER_POOL_DECL_BORROW(...)
 #define OTTER_TASK_START(...)
 #define OTTER_TASK_END(...)
+#define OTTER_TASK_SUSPEND(...)
+#define OTTER_TASK_RESUME(...)
+#define OTTER_TASK_CURRENT(...)
+#define OTTER_DEFINE_METRIC(...)
+#define OTTER_TASK_ADD_METRIC(...)
+#define OTTER_DEFINE_COUNTER(...)
+#define OTTER_COUNTER_SET(...)
+#define OTTER_COUNTER_ADD(...)
 #define OTTER_TASK_WAIT_FOR(...)
 #define OTTER_TASK_WAIT_START(...)
 #define OTTER_TASK_WAIT_END(...)
+#define OTTER_TASK_DEPENDS_ON(...)
+#define OTTER_TASK_ACCESS(...)
 #define OTTER_PHASE_BEGIN(...)
 #define OTTER_PHASE_END(...)
 #define OTTER_PHASE_SWITCH(...)
@@ -14,11 +14,14 @@
 
 #if defined(OTTER_TASK_GRAPH_DISABLE_USER)
 
+#include <stdint.h>
+
 #define OTTER_INITIALISE()
 #define OTTER_FINALISE()
 #define OTTER_DECLARE_HANDLE(...)
 #define OTTER_INIT_TASK(...)
 #define OTTER_DEFINE_TASK(...)
+#define OTTER_INIT_TASK_RANGE(...)
 #define OTTER_POOL_ADD(...)
 #define OTTER_POOL_POP(...)
 #define OTTER_POOL_DECL_POP(...)
@@ -26,9 +29,21 @@
 #define OTTER_POOL_DECL_BORROW(...)
 #define OTTER_TASK_START(...)
 #define OTTER_TASK_END(...)
+#define OTTER_TASK_SUSPEND(...)
+#define OTTER_TASK_RESUME(...)
+#define OTTER_TASK_CURRENT(...)
+#define OTTER_DEFINE_METRIC(...)
+#define OTTER_TASK_ADD_METRIC(...)
+#define OTTER_DEFINE_COUNTER(...)
+#define OTTER_COUNTER_SET(...)
+#define OTTER_COUNTER_ADD(...)
 #define OTTER_TASK_WAIT_FOR(...)
 #define OTTER_TASK_WAIT_START(...)
 #define OTTER_TASK_WAIT_END(...)
+#define OTTER_TASK_DEPENDS_ON(...)
+#define OTTER_TASK_GET_ID(...) UINT64_MAX
+#define OTTER_TASK_DEPENDS_ON_ID(...)
+#define OTTER_TASK_ACCESS(...)
 #define OTTER_PHASE_BEGIN(...)
 #define OTTER_PHASE_END(...)
 #define OTTER_PHASE_SWITCH(...)
@@ -146,6 +161,38 @@
   OTTER_INIT_TASK(task, parent, add_to_pool,                                   \
                   label OTTER_IMPL_PASS_ARGS(__VA_ARGS__))
 
+/**
+ * @brief Initialise \p n sibling tasks, storing their handles in the array
+ * \p tasks. Equivalent to calling `OTTER_INIT_TASK()` for each task, but the
+ * label is formatted once and their creation is recorded as a single event.
+ *
+ * ## Usage
+ *
+ * Use to annotate a loop whose iterations could be tasks, like `taskloop`:
+ *
+ *     otter_task_context *tasks[N];
+ *     OTTER_INIT_TASK_RANGE(tasks, parent, N, otter_no_add_to_pool, "iter");
+ *     for (int i = 0; i < N; i++) {
+ *       OTTER_TASK_START(tasks[i]);
+ *       // ...
+ *       OTTER_TASK_END(tasks[i]);
+ *     }
+ *
+ * @param tasks: An array of at least \p n task handles.
+ * @param parent: The handle of the parent task, or #OTTER_NULL_TASK if there
+ * is no parent task.
+ * @param n: The number of tasks.
+ * @param add_to_pool: Whether to add each task to the task pool with the given
+ * label. Must be either otter_add_to_pool or otter_no_add_to_pool.
+ * @param label: A `printf`-like format string for the tasks' label
+ * @param ...: Variadic arguments for use with \p label.
+ *
+ */
+#define OTTER_INIT_TASK_RANGE(tasks, parent, n, add_to_pool, label, ...)       \
+  otterTaskInitialiseRange(parent, n, tasks, -1, add_to_pool,                  \
+                           OTTER_SOURCE_LOCATION(),                            \
+                           label OTTER_IMPL_PASS_ARGS(__VA_ARGS__))
+
 /**
  * @brief Add a task handle to the task pool with the given label.
  *
@@ -287,6 +334,96 @@
  */
 #define OTTER_TASK_END(task) otterTaskEnd(task, OTTER_SOURCE_LOCATION())
 
+/**
+ * @brief Record that the given task stopped executing without completing e.g.
+ * because it yielded or is blocked waiting for I/O or a future. Must be
+ * matched by `OTTER_TASK_RESUME()` before the task ends.
+ *
+ * @param task: The task which was suspended.
+ *
+ * @see #OTTER_TASK_RESUME
+ */
+#define OTTER_TASK_SUSPEND(task)                                               \
+  otterTaskSuspend(task, OTTER_SOURCE_LOCATION())
+
+/**
+ * @brief Record that a task suspended with `OTTER_TASK_SUSPEND()` resumed
+ * executing on the calling thread.
+ *
+ * @param task: The task which was resumed.
+ *
+ * @see #OTTER_TASK_SUSPEND
+ */
+#define OTTER_TASK_RESUME(task) otterTaskResume(task, OTTER_SOURCE_LOCATION())
+
+/**
+ * @brief Get the innermost task started and not yet ended by the calling
+ * thread, or `OTTER_NULL_TASK` if there is none. Tasks given a null parent
+ * default to this task, so a task pool is only needed to hand a parent task
+ * from one thread to another.
+ *
+ * @param task: The handle for the current task.
+ *
+ */
+#define OTTER_TASK_CURRENT(task) task = otterTaskCurrent()
+
+/**
+ * @brief Define a per-task metric with the given name and unit, declaring
+ * \p metric in the current scope to hold its ID.
+ *
+ * @param metric: The variable to hold the metric's ID.
+ * @param name: The name of the metric e.g. "flops".
+ * @param unit: The unit of the metric's values e.g. "flop".
+ *
+ * @see #OTTER_TASK_ADD_METRIC
+ */
+#define OTTER_DEFINE_METRIC(metric, name, unit)                                \
+  int metric = otterTaskDefineMetric(name, unit)
+
+/**
+ * @brief Add \p value to the total of \p metric for the given task. The
+ * totals are recorded when the task ends.
+ *
+ * @param task: The task to which the value is attributed.
+ * @param metric: A metric defined with #OTTER_DEFINE_METRIC.
+ * @param value: The amount to add.
+ *
+ */
+#define OTTER_TASK_ADD_METRIC(task, metric, value)                             \
+  otterTaskAddMetric(task, metric, value)
+
+/**
+ * @brief Define a counter with the given name and unit, declaring \p counter
+ * in the current scope to hold its ID.
+ *
+ * @param counter: The variable to hold the counter's ID.
+ * @param name: The name of the counter e.g. "ready tasks".
+ * @param unit: The unit of the counter's values e.g. "tasks".
+ *
+ * @see #OTTER_COUNTER_SET
+ * @see #OTTER_COUNTER_ADD
+ */
+#define OTTER_DEFINE_COUNTER(counter, name, unit)                              \
+  int counter = otterCounterDefine(name, unit)
+
+/**
+ * @brief Set the calling thread's value of \p counter.
+ *
+ * @param counter: A counter defined with #OTTER_DEFINE_COUNTER.
+ * @param value: The counter's new value.
+ *
+ */
+#define OTTER_COUNTER_SET(counter, value) otterCounterSet(counter, value)
+
+/**
+ * @brief Add \p delta to the calling thread's value of \p counter.
+ *
+ * @param counter: A counter defined with #OTTER_DEFINE_COUNTER.
+ * @param delta: The amount to add, which may be negative.
+ *
+ */
+#define OTTER_COUNTER_ADD(counter, delta) otterCounterAdd(counter, delta)
+
 /**
  * @brief Records a barrier where the given task must wait until all prior child
  * or descendant tasks are complete.
@@ -337,6 +474,66 @@
 #define OTTER_TASK_WAIT_END(task, mode)                                        \
   otterSynchroniseTasks(task, otter_sync_##mode, otter_endpoint_leave)
 
+/**
+ * @brief Record that \p task may not start until \p pred has completed.
+ *
+ * @note This constraint is not enforced but is simply recorded in the trace.
+ *
+ * @param task: The task which depends on \p pred.
+ * @param pred: The task which must complete first. Must not have ended - use
+ * #OTTER_TASK_DEPENDS_ON_ID if it may have.
+ *
+ */
+#define OTTER_TASK_DEPENDS_ON(task, pred) otterTaskDependsOn(task, pred)
+
+/**
+ * @brief Get the ID of \p task, with which later tasks may depend on it after
+ * it has ended. The task is then never coalesced.
+ *
+ * @param task: The task, which must not have ended.
+ *
+ */
+#define OTTER_TASK_GET_ID(task) otterTaskGetId(task)
+
+/**
+ * @brief Record that \p task may not start until the task with ID \p pred_id
+ * has completed, for example when annotating a serial code:
+ *
+ *     uint64_t produced = OTTER_TASK_GET_ID(producer);
+ *     OTTER_TASK_END(producer);
+ *     ...
+ *     OTTER_TASK_DEPENDS_ON_ID(consumer, produced);
+ *
+ * @param task: The task which depends on the predecessor.
+ * @param pred_id: The ID of the task which must complete first, from
+ * #OTTER_TASK_GET_ID. The task may have ended.
+ *
+ */
+#define OTTER_TASK_DEPENDS_ON_ID(task, pred_id)                                \
+  otterTaskDependsOnId(task, pred_id)
+
+/**
+ * @brief Record that \p task reads, writes or reads and writes \p bytes bytes
+ * from \p ptr. Otter records a dependence on each earlier task whose
+ * accesses conflict with this one, as for an OpenMP `depend` clause.
+ *
+ * ## Usage
+ *
+ * Annotate the accesses of each task before it starts, for example:
+ *
+ *     OTTER_TASK_ACCESS(task, &x[0], n * sizeof(x[0]), in);
+ *     OTTER_TASK_ACCESS(task, &y[0], n * sizeof(y[0]), inout);
+ *
+ * @param task: The task making the access.
+ * @param ptr: The start of the range of memory accessed.
+ * @param bytes: The size of the range of memory accessed.
+ * @param mode: Whether the task reads (`in`), writes (`out`) or reads and
+ * writes (`inout`) the range.
+ *
+ */
+#define OTTER_TASK_ACCESS(task, ptr, bytes, mode)                              \
+  otterTaskAccess(task, ptr, bytes, otter_access_##mode)
+
 /**
  * @brief Start a new algorithmic phase.
  *
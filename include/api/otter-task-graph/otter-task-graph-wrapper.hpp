@@ -1,5 +1,16 @@
 #pragma once
+
+#include <type_traits>
+#include <utility>
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#include <coroutine>
+#define OTTER_HAVE_COROUTINES 1
+#endif
+
+#define OTTER_USE_PRIVATE_HEADER
 #include "otter-task-graph.h"
+#undef OTTER_USE_PRIVATE_HEADER
 
 /**
  * @brief Provides classes which wrap the otter-task-graph API.
@@ -7,9 +18,93 @@
  */
 namespace otter {
 
+/**
+ * @brief Tracing policies which select at compile time what the wrapper
+ * records for a task.
+ *
+ */
+namespace policy {
+
+/**
+ * @brief Record every event of the task in the trace.
+ */
+struct full {
+  static constexpr bool enabled = true;
+  static constexpr bool profile_only = false;
+};
+
+/**
+ * @brief Record no events for the task, only its statistics in the profile
+ * summary (see `otterTaskSetProfileOnly`).
+ */
+struct profile {
+  static constexpr bool enabled = true;
+  static constexpr bool profile_only = true;
+};
+
+/**
+ * @brief Record nothing. Tasks are empty and their member functions compile
+ * to nothing, and labels are never formatted.
+ */
+struct disabled {
+  static constexpr bool enabled = false;
+  static constexpr bool profile_only = false;
+};
+
+/**
+ * @brief Select `Policy` if `Enabled` is true, otherwise `disabled`, so that a
+ * category of tasks can be switched by a compile-time constant e.g.
+ *
+ *     constexpr bool trace_kernels = false;
+ *     using Kernel = otter::BasicTask<otter::policy::select<trace_kernels>>;
+ */
+template <bool Enabled, typename Policy = full>
+using select = typename std::conditional<Enabled, Policy, disabled>::type;
+
+} // namespace policy
+
+/**
+ * @brief The policy of `otter::Task` (and `otter::TaskPromise`). Define before
+ * including this header to change the policy for a translation unit. The
+ * default is `otter::policy::full`, or `otter::policy::disabled` when
+ * `OTTER_TASK_GRAPH_DISABLE_USER` is defined.
+ */
+#if !defined(OTTER_WRAPPER_POLICY)
+#if defined(OTTER_TASK_GRAPH_DISABLE_USER)
+#define OTTER_WRAPPER_POLICY otter::policy::disabled
+#else
+#define OTTER_WRAPPER_POLICY otter::policy::full
+#endif
+#endif
+
+// @cond DOXYGEN_IGNORE
+namespace detail {
+
+/* Initialise a task and record its creation according to the policy. A
+   profile-only task must be marked before it is created. */
+template <typename Policy, typename... Args>
+otter_task_context *initialise_task(otter_task_context *parent, int flavour,
+                                    const char *file, const char *func,
+                                    int line, const char *format,
+                                    Args... args) {
+  if (!Policy::profile_only) {
+    return otterTaskInitialise(parent, flavour, otter_no_add_to_pool, true,
+                               file, func, line, format, args...);
+  }
+  otter_task_context *task =
+      otterTaskInitialise(parent, flavour, otter_no_add_to_pool, false, file,
+                          func, line, format, args...);
+  otterTaskSetProfileOnly(task);
+  otterTaskCreate(task, parent, file, func, line);
+  return task;
+}
+
+} // namespace detail
+// @endcond
+
 /**
  * @brief Represents an Otter task context. The default constructor records
- * an `otterTaskBegin` event for a task with no parent i.e. a root task.
+ * an `otterTaskStart` event for a child of the current task.
  * Calling `task.make_child()` constructs a child of `task` and records
  * this in the trace.
  *
@@ -19,32 +114,51 @@ namespace otter {
  * Move-assignment is disabled as it doesn't make sense to overwrite one
  * task's context with the moved context of another task.
  *
+ * @tparam Policy: what to record for the task, one of `otter::policy`.
  */
-class Task {
+template <typename Policy = OTTER_WRAPPER_POLICY> class BasicTask {
 
 public:
   /**
-   * @brief Construct a root Task object i.e. a task with no parent,
-   * recording `otterTaskBegin` in the trace.
+   * @brief Construct a child of the current task (see `otterTaskCurrent`),
+   * recording `otterTaskStart` in the trace.
    *
    */
-  Task(void);
-  Task(int flavour);
+  BasicTask(void) : BasicTask(nullptr, 0, "") {}
+  explicit BasicTask(int flavour) : BasicTask(nullptr, flavour, "") {}
+
+  /**
+   * @brief As `BasicTask(int flavour)`, with a label formatted from `format`
+   * and subsequent arguments.
+   */
+  template <typename... Args>
+  BasicTask(int flavour, const char *format, Args... args)
+      : BasicTask(nullptr, flavour, format, args...) {}
 
   /**
    * @brief Construct a child task from its parent, recording
-   * `otterTaskBegin` in the trace.
+   * `otterTaskStart` in the trace.
    *
-   * @return Task: the new child task.
+   * @tparam ChildPolicy: the policy of the child, by default that of its
+   * parent.
+   * @return the new child task.
    */
-  Task make_child(void);
+  template <typename ChildPolicy = Policy>
+  BasicTask<ChildPolicy> make_child(int flavour = 0) {
+    return BasicTask<ChildPolicy>(m_task_context, flavour, "");
+  }
 
   /**
-   * @brief As `make_child`, but associates a flavour with the task.
+   * @brief As `make_child(int flavour)`, with a label formatted from `format`
+   * and subsequent arguments.
    *
-   * @return Task: the new child task.
+   * @return the new child task.
    */
-  Task make_child(int flavour);
+  template <typename ChildPolicy = Policy, typename... Args>
+  BasicTask<ChildPolicy> make_child(int flavour, const char *format,
+                                    Args... args) {
+    return BasicTask<ChildPolicy>(m_task_context, flavour, format, args...);
+  }
 
   /**
    * @brief Move-construct a new task by adopting the context from another
@@ -52,12 +166,14 @@ public:
    *
    * @param other: the task whose context is moved into the new task.
    */
-  Task(Task &&other);
+  BasicTask(BasicTask &&other) : m_task_context{other.m_task_context} {
+    other.m_task_context = nullptr;
+  }
 
   // Doesn't make sense to copy or move-assign a task:
-  Task(const Task &other) = delete;            // copy-constructor
-  Task &operator=(const Task &other) = delete; // copy-assignment
-  Task &operator=(Task &&other) = delete;      // move-assignment
+  BasicTask(const BasicTask &other) = delete;            // copy-constructor
+  BasicTask &operator=(const BasicTask &other) = delete; // copy-assignment
+  BasicTask &operator=(BasicTask &&other) = delete;      // move-assignment
 
   /**
    * @brief Record a synchronisation constraint on the descendants of a
@@ -66,23 +182,64 @@ public:
    * @param mode: whether the synchronisation constraint applies to child
    * tasks only or all descendant tasks.
    */
-  void synchronise_tasks(otter_task_sync_t mode);
+  void synchronise_tasks(otter_task_sync_t mode) {
+    otterSynchroniseTasks(m_task_context, mode, otter_endpoint_discrete);
+  }
+
+  /**
+   * @brief Record that the task stopped executing without completing e.g.
+   * while it waits for I/O or a future, recording `otterTaskSuspend` in the
+   * trace.
+   *
+   */
+  void suspend(const char *file = __builtin_FILE(),
+               const char *func = __builtin_FUNCTION(),
+               int line = __builtin_LINE()) {
+    otterTaskSuspend(m_task_context, file, func, line);
+  }
+
+  /**
+   * @brief Record that a suspended task resumed executing on the calling
+   * thread, recording `otterTaskResume` in the trace.
+   *
+   */
+  void resume(const char *file = __builtin_FILE(),
+              const char *func = __builtin_FUNCTION(),
+              int line = __builtin_LINE()) {
+    otterTaskResume(m_task_context, file, func, line);
+  }
+
+  /**
+   * @brief Add to the task's total for a metric defined with
+   * `otterTaskDefineMetric`, recorded when the task ends.
+   *
+   */
+  void add_metric(int metric_id, uint64_t value) {
+    otterTaskAddMetric(m_task_context, metric_id, value);
+  }
 
   /**
    * @brief Explicitly end the task, recording `otterTaskEnd` in the
    * trace. No effect if the task was already ended.
    *
    */
-  void end_task(void);
+  void end_task(void) {
+    if (m_task_context != nullptr) {
+      otterTaskEnd(m_task_context, __FILE__, __func__, __LINE__);
+      m_task_context = nullptr;
+    }
+  }
 
   /**
    * @brief Destroy the Task object, calling `task.end_task()` if the task
    * wasn't already ended.
    *
    */
-  ~Task(void);
+  ~BasicTask(void) { end_task(); }
 
 private:
+  template <typename> friend class BasicTask;
+
   /**
    * @brief The underlying Otter task context handle.
    *
@@ -91,18 +248,75 @@ private:
 
   /**
    * @brief Construct a new Task object from its parent's context,
-   * recording `otterTaskBegin` in the trace.
+   * recording `otterTaskStart` in the trace.
    *
-   * @param parent
    */
-  Task(otter_task_context *parent, int flavour = 0);
+  template <typename... Args>
+  BasicTask(otter_task_context *parent, int flavour, const char *format,
+            Args... args)
+      : m_task_context{otterTaskStart(
+            detail::initialise_task<Policy>(parent, flavour, __FILE__,
+                                            __func__, __LINE__, format,
+                                            args...),
+            __FILE__, __func__, __LINE__)} {}
+};
+
+/**
+ * @brief A task which records nothing. It holds no state and all of its member
+ * functions are empty, so it compiles to nothing.
+ */
+template <> class BasicTask<policy::disabled> {
+
+public:
+  BasicTask(void) noexcept {}
+  explicit BasicTask(int) noexcept {}
+  template <typename... Args>
+  BasicTask(int, const char *, Args &&...) noexcept {}
+
+  template <typename ChildPolicy = policy::disabled>
+  BasicTask<ChildPolicy> make_child(int flavour = 0) {
+    return BasicTask<ChildPolicy>(nullptr, flavour, "");
+  }
+
+  template <typename ChildPolicy = policy::disabled, typename... Args>
+  BasicTask<ChildPolicy> make_child(int flavour, const char *format,
+                                    Args... args) {
+    return BasicTask<ChildPolicy>(nullptr, flavour, format, args...);
+  }
+
+  BasicTask(BasicTask &&) noexcept {}
+  BasicTask(const BasicTask &other) = delete;
+  BasicTask &operator=(const BasicTask &other) = delete;
+  BasicTask &operator=(BasicTask &&other) = delete;
+
+  void synchronise_tasks(otter_task_sync_t) noexcept {}
+  void suspend(const char * = nullptr, const char * = nullptr,
+               int = 0) noexcept {}
+  void resume(const char * = nullptr, const char * = nullptr,
+              int = 0) noexcept {}
+  void add_metric(int, uint64_t) noexcept {}
+  void end_task(void) noexcept {}
+
+private:
+  template <typename> friend class BasicTask;
+
+  template <typename... Args>
+  BasicTask(otter_task_context *, int, const char *, Args &&...) noexcept {}
 };
 
+/**
+ * @brief A task with the policy selected for this translation unit.
+ *
+ * @see OTTER_WRAPPER_POLICY
+ */
+using Task = BasicTask<>;
+
 /**
  * @brief A singleton class representing the global context for Otter. Must
  * be declared before any other Otter functions or classes are used. Stores
  * a handle to a root task which may be used as the ancestor of all tasks
- * in the trace.
+ * in the trace. The root task is always fully recorded, whatever the policy
+ * of the translation unit.
  *
  */
 class Otter {
@@ -114,21 +328,30 @@ public:
    *
    * @return Otter&
    */
-  static Otter &get_otter(void);
+  static Otter &get_otter(void) {
+    static Otter _handle;
+    return _handle;
+  }
 
   /**
    * @brief Delete the root task and finalise the Otter trace with
    * `otterTraceFinalise`.
    *
    */
-  void close(void);
+  void close(void) {
+    if (!m_finalised) {
+      delete m_root_task;
+      otterTraceFinalise(__FILE__, __func__, __LINE__);
+      m_finalised = true;
+    }
+  }
 
   /**
    * @brief Delete the root task and finalise the Otter trace with
    * `otterTraceFinalise`.
    *
    */
-  ~Otter(void);
+  ~Otter(void) { close(); }
 
   Otter(const Otter &) = delete;
   Otter(Otter &&) = delete;
@@ -138,9 +361,9 @@ public:
   /**
    * @brief Get the root task context.
    *
-   * @return Task&
+   * @return BasicTask<policy::full>&
    */
-  Task &get_root_task(void);
+  BasicTask<policy::full> &get_root_task(void) { return *m_root_task; }
 
 private:
   /**
@@ -148,14 +371,296 @@ private:
    * initialisation other than in the static `get` method.
    *
    */
-  Otter(void);
+  Otter(void) : m_finalised{false} {
+    otterTraceInitialise(__FILE__, __func__, __LINE__);
+    m_root_task = new BasicTask<policy::full>();
+  }
 
   /**
    * @brief The handle to the trace's root task.
    *
    */
-  Task *m_root_task;
+  BasicTask<policy::full> *m_root_task;
   bool m_finalised;
 };
 
+#if defined(OTTER_HAVE_COROUTINES)
+
+// @cond DOXYGEN_IGNORE
+namespace detail {
+
+/* Get the awaiter for an operand of co_await, as the compiler would. An
+   awaitable with no operator co_await is its own awaiter, and is referred to
+   rather than copied as it lives until the end of the co_await expression. */
+template <typename A> decltype(auto) get_awaiter(A &&awaitable) {
+  if constexpr (requires { std::forward<A>(awaitable).operator co_await(); }) {
+    return std::forward<A>(awaitable).operator co_await();
+  } else if constexpr (requires {
+                         operator co_await(std::forward<A>(awaitable));
+                       }) {
+    return operator co_await(std::forward<A>(awaitable));
+  } else {
+    return std::forward<A>(awaitable);
+  }
+}
+
+template <typename A>
+using awaiter_t = decltype(get_awaiter(std::declval<A>()));
+
+} // namespace detail
+// @endcond
+
+/**
+ * @brief Wraps an awaiter, recording `otterTaskSuspend` when the awaiting
+ * coroutine suspends and `otterTaskResume` when it resumes. Nothing is
+ * recorded if the awaiter is ready and the coroutine does not suspend.
+ *
+ * @tparam Awaiter: the wrapped awaiter, which may be a reference.
+ */
+template <typename Awaiter> class TracedAwaiter {
+public:
+  TracedAwaiter(otter_task_context *task, Awaiter &&awaiter)
+      : m_task{task}, m_awaiter(std::forward<Awaiter>(awaiter)) {}
+
+  bool await_ready() { return m_awaiter.await_ready(); }
+
+  /**
+   * @brief Record the suspension before handing over to the wrapped awaiter,
+   * which may resume the coroutine on another thread before it returns.
+   */
+  template <typename Promise>
+  decltype(auto) await_suspend(std::coroutine_handle<Promise> handle) {
+    m_suspended = true;
+    otterTaskSuspend(m_task, __FILE__, __func__, __LINE__);
+    return m_awaiter.await_suspend(handle);
+  }
+
+  decltype(auto) await_resume() {
+    if (m_suspended) {
+      otterTaskResume(m_task, __FILE__, __func__, __LINE__);
+    }
+    return m_awaiter.await_resume();
+  }
+
+private:
+  otter_task_context *m_task;
+  bool m_suspended = false;
+  Awaiter m_awaiter;
+};
+
+/**
+ * @brief Wraps a coroutine's initial awaiter, recording `otterTaskStart` when
+ * the coroutine body begins to execute.
+ */
+template <typename Awaiter> class StartTaskAwaiter {
+public:
+  StartTaskAwaiter(otter_task_context *task, bool *started, Awaiter awaiter)
+      : m_task{task}, m_started{started}, m_awaiter(std::move(awaiter)) {}
+
+  bool await_ready() noexcept { return m_awaiter.await_ready(); }
+
+  template <typename Promise>
+  decltype(auto) await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+    return m_awaiter.await_suspend(handle);
+  }
+
+  void await_resume() noexcept {
+    m_awaiter.await_resume();
+    *m_started = true;
+    otterTaskStart(m_task, __FILE__, __func__, __LINE__);
+  }
+
+private:
+  otter_task_context *m_task;
+  bool *m_started;
+  Awaiter m_awaiter;
+};
+
+/**
+ * @brief Wraps a coroutine's final awaiter, recording `otterTaskEnd` when the
+ * coroutine body has finished, before the coroutine suspends or is destroyed.
+ */
+template <typename Awaiter> class EndTaskAwaiter {
+public:
+  EndTaskAwaiter(otter_task_context **task, Awaiter awaiter)
+      : m_task{task}, m_awaiter(std::move(awaiter)) {}
+
+  bool await_ready() noexcept {
+    if (*m_task != nullptr) {
+      otterTaskEnd(*m_task, __FILE__, __func__, __LINE__);
+      *m_task = nullptr;
+    }
+    return m_awaiter.await_ready();
+  }
+
+  template <typename Promise>
+  decltype(auto) await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+    return m_awaiter.await_suspend(handle);
+  }
+
+  void await_resume() noexcept { m_awaiter.await_resume(); }
+
+private:
+  otter_task_context **m_task;
+  Awaiter m_awaiter;
+};
+
+/**
+ * @brief A mixin for the promise type of a coroutine which records each
+ * coroutine frame as an Otter task.
+ *
+ * The task is initialised when the coroutine is called, as a child of the
+ * task running on the calling thread (see `otterTaskCurrent`). If the caller
+ * is itself a traced coroutine, this is the awaiting coroutine. The task is
+ * started when the coroutine body begins, suspended and resumed at each
+ * `co_await` in the body, and ended when the body finishes. No memory is
+ * allocated beyond the coroutine frame, except for the task context allocated
+ * by `otterTaskInitialise`.
+ *
+ * ## Usage
+ *
+ * Derive the coroutine's promise type from `TaskPromise`:
+ *
+ *     struct promise_type : otter::TaskPromise {
+ *       promise_type() : otter::TaskPromise("my_coroutine") {}
+ *       // get_return_object(), return_void(), unhandled_exception() ...
+ *     };
+ *
+ * By default the coroutine is lazy, suspending initially and finally. A
+ * promise which defines its own `initial_suspend()`, `final_suspend()` or
+ * `await_transform()` should wrap its awaiters with `traced_initial()`,
+ * `traced_final()` or `traced()` respectively to keep recording the task.
+ *
+ * @warning A coroutine destroyed before it finishes is recorded as ending
+ * when it is destroyed.
+ *
+ * @tparam Policy: what to record for the task, one of `otter::policy`.
+ */
+template <typename Policy = OTTER_WRAPPER_POLICY> class BasicTaskPromise {
+public:
+  /**
+   * @brief Initialise the task for the coroutine frame, recording
+   * `otterTaskCreate` in the trace.
+   *
+   * @param label: the task's label, by default the function calling this
+   * constructor.
+   * @param flavour: the task's flavour.
+   */
+  explicit BasicTaskPromise(const char *label = __builtin_FUNCTION(),
+                            int flavour = 0,
+                            const char *file = __builtin_FILE(),
+                            int line = __builtin_LINE())
+      : m_task{detail::initialise_task<Policy>(otterTaskCurrent(), flavour,
+                                               file, label, line, "%s",
+                                               label)} {}
+
+  BasicTaskPromise(const BasicTaskPromise &) = delete;
+  BasicTaskPromise &operator=(const BasicTaskPromise &) = delete;
+
+  /**
+   * @brief End the task if the coroutine did not finish.
+   */
+  ~BasicTaskPromise() {
+    if (m_task != nullptr) {
+      if (!m_started) {
+        otterTaskStart(m_task, __FILE__, __func__, __LINE__);
+      }
+      otterTaskEnd(m_task, __FILE__, __func__, __LINE__);
+    }
+  }
+
+  /**
+   * @brief The task representing this coroutine frame, or `nullptr` once the
+   * coroutine has finished.
+   */
+  otter_task_context *get_otter_task() const noexcept { return m_task; }
+
+  StartTaskAwaiter<std::suspend_always> initial_suspend() noexcept {
+    return traced_initial(std::suspend_always{});
+  }
+
+  EndTaskAwaiter<std::suspend_always> final_suspend() noexcept {
+    return traced_final(std::suspend_always{});
+  }
+
+  template <typename A>
+  TracedAwaiter<detail::awaiter_t<A &&>> await_transform(A &&awaitable) {
+    return traced(std::forward<A>(awaitable));
+  }
+
+  /**
+   * @brief Wrap the operand of a `co_await` in the coroutine body to record
+   * the coroutine's suspension and resumption.
+   */
+  template <typename A>
+  TracedAwaiter<detail::awaiter_t<A &&>> traced(A &&awaitable) {
+    return TracedAwaiter<detail::awaiter_t<A &&>>(
+        m_task, detail::get_awaiter(std::forward<A>(awaitable)));
+  }
+
+  /**
+   * @brief Wrap the awaiter returned by `initial_suspend()` to record the
+   * start of the task.
+   */
+  template <typename Awaiter>
+  StartTaskAwaiter<Awaiter> traced_initial(Awaiter awaiter) noexcept {
+    return StartTaskAwaiter<Awaiter>(m_task, &m_started, std::move(awaiter));
+  }
+
+  /**
+   * @brief Wrap the awaiter returned by `final_suspend()` to record the end
+   * of the task.
+   */
+  template <typename Awaiter>
+  EndTaskAwaiter<Awaiter> traced_final(Awaiter awaiter) noexcept {
+    return EndTaskAwaiter<Awaiter>(&m_task, std::move(awaiter));
+  }
+
+private:
+  otter_task_context *m_task;
+  bool m_started = false;
+};
+
+/**
+ * @brief A promise mixin which records nothing. The coroutine is lazy, and
+ * the operands of `co_await` and the awaiters passed to `traced()`,
+ * `traced_initial()` and `traced_final()` are used unchanged.
+ */
+template <> class BasicTaskPromise<policy::disabled> {
+public:
+  explicit BasicTaskPromise(const char * = nullptr, int = 0,
+                            const char * = nullptr, int = 0) noexcept {}
+
+  BasicTaskPromise(const BasicTaskPromise &) = delete;
+  BasicTaskPromise &operator=(const BasicTaskPromise &) = delete;
+
+  otter_task_context *get_otter_task() const noexcept { return nullptr; }
+
+  std::suspend_always initial_suspend() noexcept { return {}; }
+
+  std::suspend_always final_suspend() noexcept { return {}; }
+
+  template <typename A> A &&traced(A &&awaitable) noexcept {
+    return std::forward<A>(awaitable);
+  }
+
+  template <typename Awaiter>
+  Awaiter traced_initial(Awaiter awaiter) noexcept {
+    return awaiter;
+  }
+
+  template <typename Awaiter> Awaiter traced_final(Awaiter awaiter) noexcept {
+    return awaiter;
+  }
+};
+
+/**
+ * @brief A promise mixin with the policy selected for this translation unit.
+ *
+ * @see OTTER_WRAPPER_POLICY
+ */
+using TaskPromise = BasicTaskPromise<>;
+
+#endif // OTTER_HAVE_COROUTINES
+
 } // namespace otter
@@ -13,6 +13,8 @@
 #define OTTER_TASK_GRAPH_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #if !defined(OTTER_USE_PRIVATE_HEADER)
 #warning                                                                       \
@@ -59,6 +61,19 @@ typedef enum otter_add_to_pool_t {
   otter_add_to_pool = 1
 } otter_add_to_pool_t;
 
+/**
+ * @brief Indicates whether a task reads, writes or both reads and writes a
+ * range of memory.
+ *
+ * @see otterTaskAccess
+ *
+ */
+typedef enum otter_task_access_t {
+  otter_access_in = 1,
+  otter_access_out = 2,
+  otter_access_inout = 3
+} otter_task_access_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -141,7 +156,8 @@ void otterTraceStop(void);
  *
  * @note Does not record any events in the trace.
  *
- * @param parent_task: The handle of the parent of the new task.
+ * @param parent_task: The handle of the parent of the new task. If NULL, the
+ * parent is the current task (see `otterTaskCurrent()`).
  * @param flavour: The user-defined flavour of the new task.
  * @param push_task: Whether to associate the task with the given label.
  * @param file: The file where the task was initialised.
@@ -157,6 +173,44 @@ otter_task_context *otterTaskInitialise(otter_task_context *parent_task,
                                         const char *file, const char *func,
                                         int line, const char *format, ...);
 
+/**
+ * @brief Initialise `n` sibling task handles with the given flavour as
+ * children of parent, storing them in `tasks`, and record their creation. This
+ * is equivalent to calling `otterTaskInitialise()` `n` times with the same
+ * label, but formats the label and looks up its source location only once and
+ * records a single task-create event for all the tasks.
+ *
+ * ## Usage
+ *
+ * - Use where a loop would otherwise initialise and create one task per
+ *   iteration, in the same way as `taskloop`.
+ * - Each task is then started and ended with `otterTaskStart()` and
+ *   `otterTaskEnd()` as usual.
+ *
+ * ## Semantics
+ *
+ * The tasks are given consecutive IDs. Their creation is recorded as one
+ * `task_create_range` event giving the ID of the first task and the number of
+ * tasks. If Otter may coalesce the tasks, their creation is instead recorded
+ * per task, as with `otterTaskCreate()`.
+ *
+ * @param parent_task: The handle of the parent of the new tasks.
+ * @param n: The number of tasks to initialise.
+ * @param tasks: An array of at least `n` handles, which receives the tasks.
+ * @param flavour: The user-defined flavour of the new tasks.
+ * @param add_to_pool: Whether to add each task to the pool with the label.
+ * @param file: The file where the tasks were initialised.
+ * @param func: The function where the tasks were initialised.
+ * @param line: The line where the tasks were initialised.
+ * @param format: the format of the label, using subsequent arguments.
+ *
+ */
+void otterTaskInitialiseRange(otter_task_context *parent_task, int n,
+                              otter_task_context **tasks, int flavour,
+                              otter_add_to_pool_t add_to_pool,
+                              const char *file, const char *func, int line,
+                              const char *format, ...);
+
 /******
  * Annotating Task Create, Start & End
  ******/
@@ -228,6 +282,158 @@ otter_task_context *otterTaskStart(otter_task_context *task, const char *file,
 void otterTaskEnd(otter_task_context *task, const char *file, const char *func,
                   int line);
 
+/**
+ * @brief Record that a started task stopped executing without completing, for
+ * example because it yielded, blocked on I/O or is waiting for a future. The
+ * time until the matching `otterTaskResume()` is recorded as waiting time
+ * rather than execution time.
+ *
+ * ## Usage
+ *
+ * - Must follow `otterTaskStart()` or `otterTaskResume()` for the same task,
+ *   and be matched by `otterTaskResume()` before the task ends.
+ * - The task may be resumed on a different thread.
+ *
+ * @param task The task being suspended.
+ * @param file: The file where the task was suspended.
+ * @param func: The function where the task was suspended.
+ * @param line: The line where the task was suspended.
+ *
+ * @see `otterTaskResume()`
+ */
+void otterTaskSuspend(otter_task_context *task, const char *file,
+                      const char *func, int line);
+
+/**
+ * @brief Counterpart to `otterTaskSuspend()`, indicating that a suspended task
+ * resumed executing on the calling thread.
+ *
+ * @param task The task being resumed.
+ * @param file: The file where the task was resumed.
+ * @param func: The function where the task was resumed.
+ * @param line: The line where the task was resumed.
+ *
+ * @see `otterTaskSuspend()`
+ */
+void otterTaskResume(otter_task_context *task, const char *file,
+                     const char *func, int line);
+
+/**
+ * @brief Record no events for the given task. Instead, accumulate its
+ * execution time and latency into the profile summary `profile.csv`, as in
+ * profile mode (see `OTTER_MODE`).
+ *
+ * ## Usage
+ *
+ * - Must be called before the task is created or started, so the task should
+ *   be initialised without recording a task-create event and then created
+ *   with `otterTaskCreate()`.
+ *
+ * @param task The task to profile.
+ */
+void otterTaskSetProfileOnly(otter_task_context *task);
+
+/**
+ * @brief Get the task currently running on the calling thread i.e. the
+ * innermost task started by this thread with `otterTaskStart()` and not yet
+ * ended. Tasks initialised or created with a NULL parent default to this task,
+ * or to the current phase (or root) task if there is none.
+ *
+ * @note A task ended or suspended out of order is removed from the thread's
+ * current tasks. A task ended or suspended on a thread other than the one
+ * which started or resumed it stops being that thread's current task, but its
+ * context is only deleted once that thread next calls `otterTaskCurrent()` or
+ * initialises a task with a NULL parent, or when Otter is finalised.
+ *
+ * @returns The current task, or NULL if no task is running on this thread.
+ */
+otter_task_context *otterTaskCurrent(void);
+
+/**
+ * @brief Define a per-task metric such as bytes moved or floating-point
+ * operations, which tasks accumulate with `otterTaskAddMetric()`. The metric
+ * is written once to the global definitions as an OTF2 metric member named
+ * `OTTER::TASK_METRIC::<name>`. Defining the same name again returns the same
+ * ID.
+ *
+ * ## Usage
+ *
+ * - Must be called after `otterTraceInitialise()`.
+ * - At most 8 metrics may be defined.
+ *
+ * @param name The name of the metric.
+ * @param unit The unit of the metric's values e.g. "bytes" or "flop".
+ *
+ * @returns The metric's ID, or -1 if it could not be defined.
+ */
+int otterTaskDefineMetric(const char *name, const char *unit);
+
+/**
+ * @brief Add `value` to the given task's total for a metric defined with
+ * `otterTaskDefineMetric()`. When the task ends, its totals are written as a
+ * single OTF2 metric record before its task-end event, or added to the
+ * profile summary in profile mode. A task with metrics is never coalesced.
+ *
+ * @note Cheap enough to call in a hot loop. May be called by any thread,
+ * before the task ends.
+ *
+ * @param task The task to which the value is attributed.
+ * @param metric_id The ID returned by `otterTaskDefineMetric()`.
+ * @param value The amount to add.
+ */
+void otterTaskAddMetric(otter_task_context *task, int metric_id,
+                        uint64_t value);
+
+/******
+ * User Counters
+ ******/
+
+/**
+ * @brief Define a counter such as the length of a ready queue or the number of
+ * requests in flight, recorded as a time series of OTF2 metric events named
+ * `OTTER::COUNTER::<name>`. Defining the same name again returns the same ID.
+ *
+ * ## Usage
+ *
+ * - Must be called after `otterTraceInitialise()`.
+ * - At most 16 counters may be defined.
+ *
+ * @param name The name of the counter.
+ * @param unit The unit of the counter's values e.g. "requests" or "bytes".
+ *
+ * @returns The counter's ID, or -1 if it could not be defined.
+ */
+int otterCounterDefine(const char *name, const char *unit);
+
+/**
+ * @brief Set the calling thread's value of a counter. Only the calling
+ * thread's value is updated, and it is sampled on the calling thread's
+ * location: by default when it changes but at most once per
+ * `OTTER_COUNTER_INTERVAL_US`, or every `OTTER_COUNTER_INTERVAL_US` if
+ * `OTTER_COUNTER_MODE=periodic`.
+ *
+ * @note Takes no locks and records no event unless a sample is due. Ignored
+ * in profile mode.
+ *
+ * @param counter_id The ID returned by `otterCounterDefine()`.
+ * @param value The counter's new value.
+ */
+void otterCounterSet(int counter_id, int64_t value);
+
+/**
+ * @brief Add `delta` to the calling thread's value of a counter. As each
+ * thread's value is recorded separately, the value of a counter updated by
+ * several threads is the sum over their locations.
+ *
+ * @note Takes no locks and records no event unless a sample is due.
+ *
+ * @param counter_id The ID returned by `otterCounterDefine()`.
+ * @param delta The amount to add, which may be negative.
+ *
+ * @see `otterCounterSet()`
+ */
+void otterCounterAdd(int counter_id, int64_t delta);
+
 /******
  * Registering & Retrieving Tasks
  ******/
@@ -301,6 +507,101 @@ otter_task_context *otterTaskBorrowLabel(const char *format, ...);
 void otterSynchroniseTasks(otter_task_context *task, otter_task_sync_t mode,
                            otter_endpoint_t endpoint);
 
+/******
+ * Annotating Task Dependences
+ ******/
+
+/**
+ * @brief Record that a task may not start until another task has completed.
+ *
+ *
+ * ## Usage
+ *
+ * - Both tasks must have been initialised and neither may have ended, as a
+ *   task's context is deleted when it ends. Where `pred` may already have
+ *   ended, use `otterTaskDependsOnId()` instead.
+ * - Use this where the dependence is known directly. Where it arises from the
+ *   data the tasks use, see `otterTaskAccess()`.
+ *
+ *
+ * ## Semantics
+ *
+ * Records an edge from `pred` to `task` in the task dependency graph. Tasks
+ * with dependences are never coalesced.
+ *
+ * @param task The task which depends on `pred`.
+ * @param pred The task which must complete before `task` may start.
+ *
+ */
+void otterTaskDependsOn(otter_task_context *task, otter_task_context *pred);
+
+/**
+ * @brief Get the unique ID of a task, with which later tasks may depend on it
+ * through `otterTaskDependsOnId()` after it has ended.
+ *
+ * Getting a task's ID prevents the task from being coalesced, so that its
+ * events are recorded for any dependence on it.
+ *
+ * @param task The task, which must not have ended.
+ * @returns The task's ID, or `UINT64_MAX` (an undefined ID which
+ * `otterTaskDependsOnId()` ignores) if `task` is NULL.
+ */
+uint64_t otterTaskGetId(otter_task_context *task);
+
+/**
+ * @brief Record that a task may not start until the task with the given ID has
+ * completed, as `otterTaskDependsOn()`.
+ *
+ *
+ * ## Usage
+ *
+ * - `task` must have been initialised and must not have ended.
+ * - The predecessor may have ended, as is usual when annotating a serial code.
+ *   Get its ID with `otterTaskGetId()` before it ends.
+ *
+ * @param task The task which depends on the predecessor.
+ * @param pred_id The ID of the task which must complete before `task` may
+ * start.
+ *
+ */
+void otterTaskDependsOnId(otter_task_context *task, uint64_t pred_id);
+
+/**
+ * @brief Record that a task reads, writes or both reads and writes the given
+ * range of memory.
+ *
+ *
+ * ## Usage
+ *
+ * - Annotate the accesses of each task in the order the tasks would be created
+ *   by a sequential program, before the task starts.
+ * - A task may annotate any number of ranges, which may overlap the ranges
+ *   annotated by other tasks in any way.
+ *
+ *
+ * ## Semantics
+ *
+ * Otter keeps an interval map of the last task to write and the tasks which
+ * have since read each address annotated, and records an edge in the task
+ * dependency graph for each dependence this access creates, with the same
+ * semantics as OpenMP `in`, `out` and `inout` dependences:
+ *
+ * - a read depends on the last task to write any of the range.
+ * - a write depends on the tasks which read any of the range since its last
+ *   write, or on the last task to write it if it was not read since.
+ *
+ * Tasks with dependences are never coalesced.
+ *
+ * @param task The task making the access.
+ * @param ptr The start of the range of memory accessed.
+ * @param bytes The size of the range of memory accessed.
+ * @param mode Whether the task reads (`otter_access_in`), writes
+ * (`otter_access_out`) or reads and writes (`otter_access_inout`) the range.
+ *
+ */
+void otterTaskAccess(otter_task_context *task, const void *ptr, size_t bytes,
+                     otter_task_access_t mode);
+
 /******
  * Managing Phases
  ******/
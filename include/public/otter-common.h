@@ -26,6 +26,50 @@ typedef enum {
   otter_event_model_task_graph
 } otter_event_model_t;
 
+typedef enum {
+  otter_mode_trace,  // record a full trace of events
+  otter_mode_profile // record only aggregate statistics, no trace events
+} otter_mode_t;
+
+/* Optional categories of OMPT callbacks which otter-ompt may request from the
+   runtime. The thread, parallel and implicit-task callbacks are always
+   requested as they define the structure of the trace */
+#define FOREACH_OTTER_OMPT_CATEGORY(macro)                                     \
+  macro(task, 0)        /* task-create, task-schedule */                       \
+  macro(work, 1)        /* workshare regions */                                \
+  macro(sync, 2)        /* barrier, taskwait and taskgroup regions */          \
+  macro(master, 3)      /* master/masked regions */                            \
+  macro(dispatch, 4)    /* loop chunks and sections */                         \
+  macro(sync_wait, 5)   /* waiting in barrier, taskwait and taskgroup */       \
+  macro(mutex, 6)       /* locks, critical, atomic and ordered */              \
+  macro(dependences, 7) /* task dependences */
+
+#define OTTER_OMPT_CATEGORY_ENUM(name, bit) otter_ompt_category_##name = 1 << bit,
+#define OTTER_OMPT_CATEGORY_MASK(name, bit) | (1 << bit)
+typedef enum {
+  FOREACH_OTTER_OMPT_CATEGORY(OTTER_OMPT_CATEGORY_ENUM)
+  otter_ompt_category_all =
+      0 FOREACH_OTTER_OMPT_CATEGORY(OTTER_OMPT_CATEGORY_MASK)
+} otter_ompt_category_t;
+#undef OTTER_OMPT_CATEGORY_ENUM
+#undef OTTER_OMPT_CATEGORY_MASK
+
+typedef enum {
+  otter_dispatch_events,   // record every chunk dispatched to a thread
+  otter_dispatch_histogram // record per-thread histograms at workshare end
+} otter_dispatch_mode_t;
+
+typedef enum {
+  otter_sync_wait_events, // record each wait as a region in the sync region
+  otter_sync_wait_fold,   // add the wait time to the sync region's leave event
+  otter_sync_wait_total   // record per-thread totals for each construct
+} otter_sync_wait_mode_t;
+
+typedef enum {
+  otter_counter_change,  // sample counters when they change, limited by rate
+  otter_counter_periodic // sample all updated counters at a fixed rate
+} otter_counter_mode_t;
+
 typedef struct otter_opt_t {
   char *hostname;
   char *tracename;
@@ -33,6 +77,22 @@ typedef struct otter_opt_t {
   char *archive_name;
   bool append_hostname;
   otter_event_model_t event_model;
+  otter_mode_t mode;
+  uint64_t coalesce_threshold; // ns, 0 to disable
+  double overhead_target;      // % of runtime, 0 to disable
+  bool self_profile;           // measure Otter's own internal stages
+  uint64_t memory_sample_ms;   // period of memory metric samples, 0 to disable
+  unsigned ompt_categories;    // otter_ompt_category_t mask of OMPT callbacks
+  uint64_t cpu_sample_events;  // events between reads of the cpu without rseq
+  bool compact_tasks;          // single event for undeferred & merged tasks
+  otter_dispatch_mode_t dispatch_mode;   // how dispatch callbacks are recorded
+  otter_sync_wait_mode_t sync_wait_mode; // how sync-region waits are recorded
+  uint64_t mutex_event_threshold;        // ns, 0 to record no mutex events
+  bool dependence_addresses;             // record the address of dependences
+  bool structured_labels;                // label templates & args, not strings
+  uint64_t string_cache_size;            // strings kept for dedup, 0 for all
+  otter_counter_mode_t counter_mode;     // when user counters are sampled
+  uint64_t counter_interval_us;          // min time between counter samples
 } otter_opt_t;
 
 #endif // OTTER_COMMON_H
@@ -7,9 +7,49 @@
 #define ENV_VAR_TRACE_OUTPUT "OTTER_TRACE_NAME"
 #define ENV_VAR_TRACE_PATH "OTTER_TRACE_PATH"
 #define ENV_VAR_REPORT_CBK "OTTER_REPORT_CALLBACKS"
+#define ENV_VAR_MODE "OTTER_MODE"
+#define ENV_VAR_COALESCE_THRESHOLD "OTTER_COALESCE_THRESHOLD_NS"
+#define ENV_VAR_OVERHEAD_TARGET "OTTER_OVERHEAD_TARGET"
+#define ENV_VAR_SELF_PROFILE "OTTER_SELF_PROFILE"
+#define ENV_VAR_MEMORY_SAMPLE_MS "OTTER_MEMORY_SAMPLE_MS"
+#define ENV_VAR_OMPT_CATEGORIES "OTTER_OMPT_CATEGORIES"
+#define ENV_VAR_CPU_SAMPLE_EVENTS "OTTER_CPU_SAMPLE_EVENTS"
+#define ENV_VAR_COMPACT_TASKS "OTTER_COMPACT_TASKS"
+#define ENV_VAR_DISPATCH_MODE "OTTER_DISPATCH_MODE"
+#define ENV_VAR_SYNC_WAIT_MODE "OTTER_SYNC_WAIT_MODE"
+#define ENV_VAR_MUTEX_EVENT_THRESHOLD "OTTER_MUTEX_EVENT_THRESHOLD_NS"
+#define ENV_VAR_DEPENDENCE_ADDRESSES "OTTER_DEPENDENCE_ADDRESSES"
+#define ENV_VAR_STRUCTURED_LABELS "OTTER_STRUCTURED_LABELS"
+#define ENV_VAR_STRING_CACHE_SIZE "OTTER_STRING_CACHE_SIZE"
+#define ENV_VAR_COUNTER_MODE "OTTER_COUNTER_MODE"
+#define ENV_VAR_COUNTER_INTERVAL_US "OTTER_COUNTER_INTERVAL_US"
+
+/* Recognised values of ENV_VAR_MODE */
+#define MODE_NAME_TRACE "trace"
+#define MODE_NAME_PROFILE "profile"
+
+/* Recognised values of ENV_VAR_DISPATCH_MODE */
+#define DISPATCH_MODE_NAME_EVENTS "events"
+#define DISPATCH_MODE_NAME_HISTOGRAM "histogram"
+
+/* Recognised values of ENV_VAR_SYNC_WAIT_MODE */
+#define SYNC_WAIT_MODE_NAME_EVENTS "events"
+#define SYNC_WAIT_MODE_NAME_FOLD "fold"
+#define SYNC_WAIT_MODE_NAME_TOTAL "total"
+
+/* Recognised values of ENV_VAR_COUNTER_MODE */
+#define COUNTER_MODE_NAME_CHANGE "change"
+#define COUNTER_MODE_NAME_PERIODIC "periodic"
 
 /* Default values */
 #define DEFAULT_OTF2_TRACE_OUTPUT "otter_trace"
 #define DEFAULT_OTF2_TRACE_PATH "trace"
+#define DEFAULT_MODE MODE_NAME_TRACE
+#define DEFAULT_OMPT_CATEGORIES "task,work,sync,master"
+#define DEFAULT_CPU_SAMPLE_EVENTS 16
+#define DEFAULT_DISPATCH_MODE DISPATCH_MODE_NAME_EVENTS
+#define DEFAULT_SYNC_WAIT_MODE SYNC_WAIT_MODE_NAME_EVENTS
+#define DEFAULT_COUNTER_MODE COUNTER_MODE_NAME_CHANGE
+#define DEFAULT_COUNTER_INTERVAL_US 100
 
 #endif // OTTER_ENV_H
@@ -0,0 +1,73 @@
+/**
+ * @file trace-counter.h
+ * @brief User-defined counters, such as the length of a ready queue or the
+ * number of requests in flight, recorded as time series of OTF2 metric events
+ * aligned with the rest of the trace. Updating a counter only changes the
+ * calling thread's value, which is written on the thread's own location
+ * either whenever it changes, limited to one sample per interval, or
+ * periodically.
+ * @version 0.1
+ * @date 2023-05-24
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#if !defined(OTTER_TRACE_COUNTER_H)
+#define OTTER_TRACE_COUNTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "public/otter-common.h"
+#include "public/otter-trace/trace-location.h"
+
+/* The most counters which may be defined */
+#define OTTER_MAX_COUNTERS 16
+
+/**
+ * @brief Set the sampling mode and interval from `opt`. In profile mode
+ * counters are ignored, as no events are recorded. Called by
+ * trace_initialise().
+ */
+void trace_counter_configure(const otter_opt_t *opt);
+
+/**
+ * @brief Define a counter with the given name and unit, writing its metric
+ * member and metric class to the global definitions. Defining a name again
+ * returns the ID it was first given. Thread-safe.
+ *
+ * @return The counter's ID, or -1 if OTTER_MAX_COUNTERS counters are already
+ * defined.
+ */
+int trace_counter_define(const char *name, const char *unit);
+
+/**
+ * @brief Set the calling thread's value of a counter, writing a sample on the
+ * given location if one is due.
+ */
+void trace_counter_set(trace_location_def_t *location, int counter_id,
+                       int64_t value);
+
+/**
+ * @brief Add `delta` to the calling thread's value of a counter, writing a
+ * sample on the given location if one is due.
+ */
+void trace_counter_add(trace_location_def_t *location, int counter_id,
+                       int64_t delta);
+
+/**
+ * @brief Write a sample on the given location if the calling thread has
+ * updated any counter and a sample is due. Cheap enough to call on every
+ * event.
+ */
+void trace_counter_sample(trace_location_def_t *location);
+
+/**
+ * @brief Write any changes not yet sampled on every thread to that thread's
+ * location. Must be called after all threads have stopped updating counters
+ * and before thread locations are destroyed.
+ */
+void trace_counter_finalise(void);
+
+#endif // OTTER_TRACE_COUNTER_H
@@ -0,0 +1,35 @@
+/**
+ * @file trace-cpu.h
+ * @brief Provides the CPU on which the calling thread is running for the `cpu`
+ * event attribute without a call to sched_getcpu() for every event. Where the
+ * C library registers a restartable sequence (rseq) for each thread, the CPU is
+ * read directly from the thread's rseq area. Otherwise sched_getcpu() is called
+ * once every N events per thread and the result reused in between.
+ * @version 0.1
+ * @date 2023-05-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#if !defined(OTTER_TRACE_CPU_H)
+#define OTTER_TRACE_CPU_H
+
+#include <stdint.h>
+
+#include "public/otter-common.h"
+
+/**
+ * @brief Choose how the CPU is read according to `opt` and the C library's
+ * support for rseq, and record the choice in the archive. Called by
+ * trace_initialise().
+ */
+void trace_cpu_configure(const otter_opt_t *opt);
+
+/**
+ * @brief The CPU on which the calling thread is (or, if sampled, recently was)
+ * running.
+ */
+int32_t trace_cpu_current(void);
+
+#endif // OTTER_TRACE_CPU_H
@@ -0,0 +1,45 @@
+/**
+ * @file trace-dependence.h
+ * @brief Records the dependences of tasks, as reported by the OMPT dependences
+ * and task-dependence callbacks or annotated with the task-graph API. Each edge between a predecessor
+ * and a successor task and each dependence declared by a task is written as a
+ * compact metric event, so that post-processing can reconstruct the task
+ * dependency graph.
+ * @version 0.1
+ * @date 2023-05-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#if !defined(OTTER_TRACE_DEPENDENCE_H)
+#define OTTER_TRACE_DEPENDENCE_H
+
+#include "public/otter-common.h"
+#include "public/otter-trace/trace-location.h"
+#include "public/otter-trace/trace-types.h"
+
+/**
+ * @brief Define the metrics used to record dependences for the task-graph
+ * event model, or if the dependences category is selected in `opt`. Called by
+ * trace_initialise().
+ */
+void trace_dependence_configure(const otter_opt_t *opt);
+
+/**
+ * @brief Record that the task with the given ID declared a dependence of the
+ * given type on `address`. For doacross dependences `address` is the value of
+ * the dependence vector rather than an address.
+ */
+void trace_dependence_declare(trace_location_def_t *location,
+                              unique_id_t task_id, otter_dependence_t type,
+                              const void *address);
+
+/**
+ * @brief Record that the task with ID `succ_id` may not start until the task
+ * with ID `pred_id` has completed.
+ */
+void trace_dependence_edge(trace_location_def_t *location, unique_id_t pred_id,
+                           unique_id_t succ_id);
+
+#endif // OTTER_TRACE_DEPENDENCE_H
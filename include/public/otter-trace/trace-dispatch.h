@@ -0,0 +1,44 @@
+/**
+ * @file trace-dispatch.h
+ * @brief Records the chunks of loop iterations and the sections dispatched to
+ * each thread in a worksharing construct, as reported by the OMPT dispatch
+ * callback. Either each chunk is recorded as an OTF2 metric event giving its
+ * first iteration, number of iterations and duration, or each thread records
+ * histograms of the chunks it executed when the workshare ends.
+ * @version 0.1
+ * @date 2023-05-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#if !defined(OTTER_TRACE_DISPATCH_H)
+#define OTTER_TRACE_DISPATCH_H
+
+#include <stdint.h>
+
+#include "public/otter-common.h"
+#include "public/otter-trace/trace-location.h"
+
+/**
+ * @brief Define the dispatch metrics if the dispatch category is selected in
+ * `opt`. Called by trace_initialise().
+ */
+void trace_dispatch_configure(const otter_opt_t *opt);
+
+/**
+ * @brief Record that a chunk of `iterations` iterations starting at iteration
+ * `start` was dispatched to the calling thread. This ends the thread's previous
+ * chunk, if any. A section is a chunk of one iteration.
+ */
+void trace_dispatch_chunk(trace_location_def_t *location, uint64_t start,
+                          uint64_t iterations);
+
+/**
+ * @brief End the calling thread's last chunk in the present workshare. In
+ * histogram mode, record the thread's histograms for the workshare if any
+ * chunks were dispatched to it.
+ */
+void trace_dispatch_work_end(trace_location_def_t *location);
+
+#endif // OTTER_TRACE_DISPATCH_H
@@ -0,0 +1,94 @@
+/**
+ * @file trace-governor.h
+ * @author Adam Tuft
+ * @brief Measures the time each thread spends inside Otter and throttles
+ * tracing to keep this within a target fraction of runtime. Throttling raises
+ * a per-thread sampling stride and, at higher strides, disables lower-priority
+ * categories of events.
+ * @version 0.1
+ * @date 2023-05-09
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#if !defined(OTTER_TRACE_GOVERNOR_H)
+#define OTTER_TRACE_GOVERNOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "public/otter-common.h"
+#include "public/otter-trace/trace-location.h"
+
+/**
+ * @brief Categories of events which the governor may disable.
+ *
+ */
+typedef enum {
+  trace_governor_master,    // master/masked regions
+  trace_governor_workshare, // workshare regions
+  trace_governor_n_categories
+} trace_governor_category_t;
+
+/**
+ * @brief Configure the governor from `opt` and record the configuration in
+ * the archive. Called by trace_initialise().
+ */
+void trace_governor_configure(const otter_opt_t *opt);
+
+/**
+ * @brief Record the largest sampling stride chosen by any thread in the
+ * archive. Called by trace_finalise().
+ */
+void trace_governor_finalise(void);
+
+/**
+ * @brief Whether the governor is measuring and throttling this run.
+ */
+bool trace_governor_enabled(void);
+
+/**
+ * @brief Mark the start of time spent inside Otter on this thread. Calls may be
+ * nested, in which case only the outermost call is measured.
+ *
+ * @return An opaque value to pass to the matching trace_governor_leave().
+ */
+uint64_t trace_governor_enter(void);
+
+/**
+ * @brief Mark the end of time spent inside Otter on this thread and adjust this
+ * thread's sampling stride if the measured overhead has left the target range.
+ *
+ * @return The new sampling stride if it changed, otherwise 0. The caller should
+ * record any change with trace_governor_write_stride().
+ */
+unsigned trace_governor_leave(uint64_t enter);
+
+/**
+ * @brief Decide whether the next sampled item on this thread should be
+ * recorded. With a sampling stride of N, 1 in N items is recorded.
+ */
+bool trace_governor_sample(void);
+
+/**
+ * @brief Decide whether a scope of the given category which begins now should
+ * be recorded. Each call must be matched by a call to
+ * trace_governor_end_scope() for the same category on the same thread, which
+ * returns the same decision.
+ */
+bool trace_governor_begin_scope(trace_governor_category_t category);
+
+/**
+ * @brief Return whether the innermost scope of the given category on this
+ * thread was recorded, and forget the decision.
+ */
+bool trace_governor_end_scope(trace_governor_category_t category);
+
+/**
+ * @brief Record a change to the sampling stride of the given location.
+ */
+void trace_governor_write_stride(trace_location_def_t *location,
+                                 unsigned stride);
+
+#endif // OTTER_TRACE_GOVERNOR_H
@@ -0,0 +1,76 @@
+/**
+ * @file trace-label.h
+ * @brief Structured task labels. Rather than formatting each label and
+ * interning the result, a label whose arguments are all integers or floats is
+ * recorded as its format string (the template) plus the raw argument values,
+ * so only one string is defined per template. The number of distinct labels
+ * made from each template is estimated and reported at finalisation.
+ * @version 0.1
+ * @date 2023-05-22
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#if !defined(OTTER_TRACE_LABEL_H)
+#define OTTER_TRACE_LABEL_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "public/otter-common.h"
+
+/* The most arguments a structured label may have */
+#define OTTER_LABEL_MAX_ARGS 4
+
+/**
+ * @brief The raw arguments of a structured label. Integers are stored
+ * sign-extended to 64 bits and floats as the bit pattern of a double, in the
+ * order of the conversions in the label's template.
+ */
+typedef struct otter_label_args_t {
+  uint8_t count;
+  uint64_t values[OTTER_LABEL_MAX_ARGS];
+} otter_label_args_t;
+
+/**
+ * @brief Enable structured labels if requested in `opt`. Called by
+ * trace_initialise().
+ */
+void trace_label_configure(const otter_opt_t *opt);
+
+/**
+ * @brief Whether labels should be recorded as a template plus arguments.
+ */
+bool trace_label_structured(void);
+
+/**
+ * @brief Store the arguments given by `args` for the conversions in `format`.
+ *
+ * @return false if any conversion takes a string or pointer, uses a `*` width
+ * or precision, or there are more than OTTER_LABEL_MAX_ARGS arguments, in which
+ * case the label must be formatted instead. `args` is consumed either way.
+ */
+bool trace_label_parse(const char *format, va_list args,
+                       otter_label_args_t *out);
+
+/**
+ * @brief Count a label made from the given template and its string ref. Pass
+ * the arguments of a structured label, or the formatted label otherwise. Does
+ * not take any locks after the first call on each thread.
+ */
+void trace_label_count(otter_string_ref_t template_ref,
+                       const char *template_str,
+                       const otter_label_args_t *args, const char *label);
+
+/**
+ * @brief Merge the counts gathered by all threads and write to `labels.csv`
+ * within the trace directory given by `opt` the number of labels made from
+ * each template and an estimate of how many were distinct.
+ *
+ * @return true if the summary was written, false otherwise.
+ */
+bool trace_label_write_summary(const otter_opt_t *opt);
+
+#endif // OTTER_TRACE_LABEL_H
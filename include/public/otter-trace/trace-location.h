@@ -50,6 +50,7 @@ void trace_location_enter_region(trace_location_def_t *loc,
                                  trace_region_def_t *rgn);
 void trace_location_leave_region(trace_location_def_t *loc,
                                  trace_region_def_t **rgn);
+trace_region_def_t *trace_location_get_active_region(trace_location_def_t *loc);
 void trace_location_get_active_regions_from_task(trace_location_def_t *loc,
                                                  trace_region_def_t *task);
 void trace_location_store_active_regions_in_task(trace_location_def_t *loc,
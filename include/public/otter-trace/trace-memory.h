@@ -0,0 +1,48 @@
+/**
+ * @file trace-memory.h
+ * @author Adam Tuft
+ * @brief Reports the memory held by Otter's internal data structures, as
+ * tracked by the memory accounting in otter-dtype. A summary is reported at
+ * finalisation and, optionally, samples are recorded periodically as OTF2
+ * metric events.
+ * @version 0.1
+ * @date 2023-05-11
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#if !defined(OTTER_TRACE_MEMORY_H)
+#define OTTER_TRACE_MEMORY_H
+
+#include <stdbool.h>
+
+#include "public/otter-common.h"
+#include "public/otter-trace/trace-location.h"
+
+/**
+ * @brief Define the memory metrics if periodic sampling is requested in `opt`.
+ * Called by trace_initialise().
+ */
+void trace_memory_configure(const otter_opt_t *opt);
+
+/**
+ * @brief Decide whether a memory sample is due. At most one thread is told
+ * that each sample is due, and it should then call trace_memory_write_sample().
+ */
+bool trace_memory_sample_due(void);
+
+/**
+ * @brief Record the memory currently held in each category as a metric event
+ * on the given location.
+ */
+void trace_memory_write_sample(trace_location_def_t *location);
+
+/**
+ * @brief Store the current and high-water memory of each category as archive
+ * properties and print them to stderr. Must be called before the archive is
+ * closed.
+ */
+void trace_memory_finalise(void);
+
+#endif // OTTER_TRACE_MEMORY_H
@@ -0,0 +1,79 @@
+/**
+ * @file trace-mutex.h
+ * @brief Aggregates the time threads spend waiting for and holding locks,
+ * critical sections, atomics and ordered regions, as reported by the OMPT
+ * mutex callbacks. Statistics are keyed by the kind of mutex and the address
+ * of the code which acquired it, and written at finalisation ranked by total
+ * wait time. Optionally, each acquisition which waited or held the mutex for
+ * at least a threshold duration is also recorded as an event.
+ * @version 0.1
+ * @date 2023-05-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#if !defined(OTTER_TRACE_MUTEX_H)
+#define OTTER_TRACE_MUTEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "public/otter-common.h"
+#include "public/otter-trace/trace-location.h"
+#include "public/otter-trace/trace-types.h"
+
+/**
+ * @brief Set the event threshold from `opt` if the mutex category is selected.
+ * Called by trace_initialise().
+ */
+void trace_mutex_configure(const otter_opt_t *opt);
+
+/**
+ * @brief Record that the calling thread began to wait for the mutex with the
+ * given wait ID.
+ */
+void trace_mutex_acquire(otter_mutex_t kind, uint64_t wait_id,
+                         const void *codeptr_ra);
+
+/**
+ * @brief Record that the calling thread acquired the mutex with the given wait
+ * ID. If it waited for at least the event threshold, also record a
+ * `mutex_acquired` event on the given location.
+ */
+void trace_mutex_acquired(trace_location_def_t *location, uint64_t wait_id);
+
+/**
+ * @brief Record that the calling thread acquired (`begin`) or released a nest
+ * lock it already holds. A nested acquisition follows trace_mutex_acquire()
+ * rather than trace_mutex_acquired(), so its wait is discarded.
+ */
+void trace_mutex_nest_lock(uint64_t wait_id, bool begin);
+
+/**
+ * @brief Record that the calling thread released the mutex with the given wait
+ * ID, accumulating its wait and hold times. If its acquisition was recorded as
+ * an event, also record a `mutex_released` event on the given location.
+ */
+void trace_mutex_released(trace_location_def_t *location, uint64_t wait_id);
+
+/**
+ * @brief Count the initialisation of a lock at the given address.
+ */
+void trace_mutex_lock_init(otter_mutex_t kind, const void *codeptr_ra);
+
+/**
+ * @brief Count the destruction of a lock at the given address.
+ */
+void trace_mutex_lock_destroy(otter_mutex_t kind, const void *codeptr_ra);
+
+/**
+ * @brief Merge the statistics gathered by all threads and write them to
+ * `mutex.csv` within the trace directory given by `opt`, ordered by total wait
+ * time. The most contended mutexes are also printed to stderr.
+ *
+ * @return true if the summary was written, false otherwise.
+ */
+bool trace_mutex_write_summary(const otter_opt_t *opt);
+
+#endif // OTTER_TRACE_MUTEX_H
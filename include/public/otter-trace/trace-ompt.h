@@ -19,6 +19,24 @@
 #include "public/otter-trace/trace-region-def.h"
 #include "public/otter-trace/trace-types.h"
 
+/**
+ * @brief Configure the OMPT event writers from `opt` and record the
+ * configuration in the archive. Called by trace_initialise().
+ */
+void trace_ompt_configure(const otter_opt_t *opt);
+
+/**
+ * @brief Whether the given task is recorded compactly. When enabled, an
+ * undeferred or merged explicit task records no task-create or task-switch
+ * events and no region definition. Instead, a single `task_compact` event is
+ * recorded when it completes, giving its create and start times. The caller
+ * should not store the region definition of a compact task with its location,
+ * and should destroy its region once it completes. A compact task switched out
+ * before it completes (e.g. if it yields) falls back to full recording, after
+ * which it is no longer compact.
+ */
+bool trace_task_is_compact(trace_region_def_t *task);
+
 void trace_event_thread_begin(trace_location_def_t *self);
 void trace_event_thread_end(trace_location_def_t *self);
 void trace_event_enter(trace_location_def_t *self, trace_region_def_t *region);
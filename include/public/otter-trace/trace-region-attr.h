@@ -47,6 +47,7 @@ typedef struct {
   otter_sync_region_t type;
   bool sync_descendant_tasks;
   unique_id_t encountering_task_id;
+  uint64_t wait_time; // see trace-sync-wait.h, 0 unless folded into region
 } trace_sync_region_attr_t;
 
 /* Attributes of a task region */
@@ -65,6 +66,9 @@ typedef struct {
   int source_line_number;
   const void *task_create_ra;
   int flavour;
+  uint64_t create_time; // compact tasks only, see trace_task_is_compact()
+  uint64_t start_time;  // compact tasks only, 0 until the task starts
+  bool expanded;        // compact task which fell back to full recording
 } trace_task_region_attr_t;
 
 /* Attributes of a phase region */
@@ -83,6 +83,13 @@ unsigned int trace_region_get_shared_ref_count(trace_region_def_t *region);
 
 void trace_region_set_task_status(trace_region_def_t *region,
                                   otter_task_status_t status);
+void trace_region_set_task_create_time(trace_region_def_t *region,
+                                       uint64_t time);
+void trace_region_set_task_start_time(trace_region_def_t *region,
+                                      uint64_t time);
+void trace_region_set_task_expanded(trace_region_def_t *region);
+void trace_region_add_sync_wait_time(trace_region_def_t *region,
+                                     uint64_t time);
 
 // Lock and unlock shared regions
 
@@ -0,0 +1,73 @@
+/**
+ * @file trace-self-profile.h
+ * @author Adam Tuft
+ * @brief Per-thread counters and time accumulators for Otter's own internal
+ * stages, used to show where tracing overhead is spent. Enabled by
+ * otter_opt_t.self_profile, otherwise each measurement costs one branch.
+ * @version 0.1
+ * @date 2023-05-10
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#if !defined(OTTER_TRACE_SELF_PROFILE_H)
+#define OTTER_TRACE_SELF_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "public/otter-common.h"
+
+/**
+ * @brief The internal stages which are measured.
+ *
+ */
+typedef enum {
+  trace_self_source_location_ref, // get_source_location_ref()
+  trace_self_string_ref,          // get_string_ref()
+  trace_self_task_manager_wait,   // waiting for the task manager lock
+  trace_self_event_write,         // OTF2_EvtWriter_* calls
+  trace_self_flush,               // OTF2 buffer flushes
+  trace_self_def_write,           // OTF2 definition writes
+  trace_self_n_stages
+} trace_self_stage_t;
+
+/**
+ * @brief Measure the time taken by the statement(s) given as the remaining
+ * arguments and attribute it to `stage`.
+ */
+#define TRACE_SELF_PROFILE(stage, ...)                                         \
+  do {                                                                         \
+    uint64_t self_profile_begin_ = trace_self_profile_begin();                 \
+    __VA_ARGS__;                                                               \
+    trace_self_profile_end(stage, self_profile_begin_);                        \
+  } while (0)
+
+/**
+ * @brief Enable self-profiling if requested in `opt`. Called by
+ * trace_initialise().
+ */
+void trace_self_profile_configure(const otter_opt_t *opt);
+
+/**
+ * @brief Begin measuring a stage on this thread.
+ *
+ * @return An opaque value to pass to the matching trace_self_profile_end(), or
+ * 0 if self-profiling is disabled.
+ */
+uint64_t trace_self_profile_begin(void);
+
+/**
+ * @brief Finish measuring a stage on this thread.
+ */
+void trace_self_profile_end(trace_self_stage_t stage, uint64_t begin);
+
+/**
+ * @brief Sum the counters of all threads, store the totals as archive
+ * properties and print them to stderr. Must be called before the archive is
+ * closed.
+ */
+void trace_self_profile_finalise(void);
+
+#endif // OTTER_TRACE_SELF_PROFILE_H
@@ -0,0 +1,58 @@
+/**
+ * @file trace-sync-wait.h
+ * @brief Records the time each thread spends waiting in barrier, taskwait and
+ * taskgroup regions, as reported by the OMPT sync-region-wait callback, apart
+ * from the time it spends executing tasks while it waits. The wait is either
+ * recorded as a region nested in the enclosing sync region, folded into the
+ * record of the enclosing sync region, or totalled per construct for each
+ * thread.
+ * @version 0.1
+ * @date 2023-05-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#if !defined(OTTER_TRACE_SYNC_WAIT_H)
+#define OTTER_TRACE_SYNC_WAIT_H
+
+#include "public/otter-common.h"
+#include "public/otter-trace/trace-location.h"
+#include "public/otter-trace/trace-types.h"
+
+/**
+ * @brief Define the wait regions or metrics if the sync_wait category is
+ * selected in `opt`. Called by trace_initialise().
+ */
+void trace_sync_wait_configure(const otter_opt_t *opt);
+
+/**
+ * @brief Record that the calling thread began to wait in a sync region of the
+ * given type, encountered by the task with the given ID. The wait may be nested
+ * in another wait of the same thread, if the runtime executes a task which
+ * waits while the thread waits.
+ */
+void trace_sync_wait_begin(trace_location_def_t *location,
+                           otter_sync_region_t type, unique_id_t task_id);
+
+/**
+ * @brief Record that the calling thread stopped its innermost wait. In fold
+ * mode the time spent waiting is added to the location's active region, which
+ * should be the enclosing sync region.
+ */
+void trace_sync_wait_end(trace_location_def_t *location);
+
+/**
+ * @brief Exclude the time spent executing other tasks from each of the calling
+ * thread's active waits. Call when the thread switches between tasks.
+ */
+void trace_sync_wait_task_switch(unique_id_t prior_task_id,
+                                 unique_id_t next_task_id);
+
+/**
+ * @brief In total mode, record the calling thread's total wait time in each
+ * type of sync region as a metric event. Call before the thread ends.
+ */
+void trace_sync_wait_thread_end(trace_location_def_t *location);
+
+#endif // OTTER_TRACE_SYNC_WAIT_H
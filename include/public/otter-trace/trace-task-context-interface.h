@@ -17,6 +17,21 @@
 
 #include "api/otter-task-graph/otter-task-graph.h" // for otter_task_context typedef and otter_endpoint_t
 #include "public/otter-common.h"
+#include "public/otter-trace/trace-label.h"
+#include "public/otter-trace/trace-task-metric.h"
+
+/**
+ * @brief Flags indicating which of a task's events have been deferred rather
+ * than recorded immediately. `otter_deferred_keep` marks a task which may not
+ * be coalesced, so its deferred events must eventually be recorded.
+ *
+ */
+typedef enum {
+  otter_deferred_none = 0,
+  otter_deferred_create = 1 << 0,
+  otter_deferred_start = 1 << 1,
+  otter_deferred_keep = 1 << 2
+} otter_deferred_event_t;
 
 /**
  * @brief Allocate an uninitialised otter_task_context.
@@ -36,6 +51,18 @@ otter_task_context *otterTaskContext_alloc(void);
 void otterTaskContext_init(otter_task_context *task, otter_task_context *parent,
                            int flavour, otter_src_ref_t init_location);
 
+/**
+ * @brief Initialise `n` tasks as children of parent, with consecutive IDs.
+ *
+ * @param tasks The tasks to initialise. None may be NULL.
+ * @param n The number of tasks.
+ * @param parent The parent of the tasks, or NULL if they have no parent.
+ * @param flavour The flavour of the new tasks.
+ */
+void otterTaskContext_init_range(otter_task_context **tasks, int n,
+                                 otter_task_context *parent, int flavour,
+                                 otter_src_ref_t init_location);
+
 /**
  * @brief Delete a task context.
  *
@@ -43,6 +70,30 @@ void otterTaskContext_init(otter_task_context *task, otter_task_context *parent,
  */
 void otterTaskContext_delete(otter_task_context *task);
 
+/**
+ * @brief Take a reference to a task context, which keeps it alive until the
+ * reference is released. A context starts with one reference, released when
+ * the task ends.
+ */
+void otterTaskContext_retain(otter_task_context *task);
+
+/**
+ * @brief Release a reference to a task context, deleting it if this was the
+ * last reference.
+ *
+ * @return true if the context was deleted.
+ */
+bool otterTaskContext_release(otter_task_context *task);
+
+/**
+ * @brief Set the thread's stack of current tasks which holds a task, or NULL
+ * if the task is not current on any thread.
+ *
+ * @return The stack which previously held the task.
+ */
+void *otterTaskContext_exchange_current_stack(otter_task_context *task,
+                                              void *stack);
+
 // Getters
 
 /**
@@ -85,8 +136,184 @@ otterTaskContext_get_init_location_ref(const otter_task_context *task);
 otter_string_ref_t
 otterTaskContext_get_task_label_ref(const otter_task_context *task);
 
+/**
+ * @brief Get the arguments of a task's structured label, or NULL if it has
+ * none.
+ *
+ */
+const otter_label_args_t *
+otterTaskContext_get_task_label_args(const otter_task_context *task);
+
+/**
+ * @brief Get the metrics accumulated by a task, or NULL if none were added.
+ *
+ */
+const otter_task_metrics_t *
+otterTaskContext_get_metrics(const otter_task_context *task);
+
+/**
+ * @brief Get the time at which a task was created, or 0 if not recorded.
+ *
+ */
+uint64_t otterTaskContext_get_task_create_time(const otter_task_context *task);
+
+/**
+ * @brief Get the time at which a task was started, or 0 if not recorded.
+ *
+ */
+uint64_t otterTaskContext_get_task_start_time(const otter_task_context *task);
+
+/**
+ * @brief Get the time at which a task ended, or 0 if not recorded.
+ *
+ */
+uint64_t otterTaskContext_get_task_end_time(const otter_task_context *task);
+
+/**
+ * @brief Get the total time a task has spent suspended, not counting any
+ * suspension it has not yet resumed from.
+ *
+ */
+uint64_t otterTaskContext_get_task_wait_time(const otter_task_context *task);
+
+/**
+ * @brief Whether a task is currently suspended.
+ *
+ */
+bool otterTaskContext_is_suspended(const otter_task_context *task);
+
+/**
+ * @brief Get the thread's stack of current tasks which holds a task, or NULL
+ * if the task is not current on any thread.
+ */
+void *otterTaskContext_get_current_stack(const otter_task_context *task);
+
+/**
+ * @brief Whether a task records only profile statistics and no events.
+ *
+ */
+bool otterTaskContext_is_profile_only(const otter_task_context *task);
+
+/**
+ * @brief Get the source location where a task was created, if stored.
+ *
+ */
+otter_src_ref_t
+otterTaskContext_get_create_location_ref(const otter_task_context *task);
+
+/**
+ * @brief Get the source location where a task was started, if stored.
+ *
+ */
+otter_src_ref_t
+otterTaskContext_get_start_location_ref(const otter_task_context *task);
+
+/**
+ * @brief Get the number of tasks initialised as children of this task.
+ *
+ */
+uint64_t otterTaskContext_get_num_children(const otter_task_context *task);
+
+/**
+ * @brief Get the events deferred for a task.
+ *
+ * @return A combination of otter_deferred_event_t flags.
+ */
+int otterTaskContext_get_deferred_events(const otter_task_context *task);
+
+/**
+ * @brief Atomically clear the given deferred events of a task and return those
+ * which were set. The caller becomes responsible for recording them.
+ *
+ * @param events A combination of otter_deferred_event_t flags.
+ * @return The flags in `events` which were set.
+ */
+int otterTaskContext_take_deferred_events(otter_task_context *task,
+                                          int events);
+
+/**
+ * @brief Atomically discard all of a task's deferred events, only if they are
+ * exactly `events`, so that the task may be coalesced.
+ *
+ * @return Whether the events were discarded.
+ */
+bool otterTaskContext_discard_deferred_events(otter_task_context *task,
+                                              int events);
+
+// Setters
+
 /**
  * @brief Set the label a task was associated with.
  */
 void otterTaskContext_set_task_label_ref(otter_task_context *task,
                                          otter_string_ref_t label);
+
+/**
+ * @brief Set the arguments of a task's structured label.
+ */
+void otterTaskContext_set_task_label_args(otter_task_context *task,
+                                          const otter_label_args_t *args);
+
+/**
+ * @brief Add `value` to the task's total for the metric with the given ID,
+ * which must be valid. May be called concurrently from several threads.
+ */
+void otterTaskContext_add_metric(otter_task_context *task, int metric_id,
+                                 uint64_t value);
+
+/**
+ * @brief Set the time at which a task was created.
+ */
+void otterTaskContext_set_task_create_time(otter_task_context *task,
+                                           uint64_t time);
+
+/**
+ * @brief Set the time at which a task was started.
+ */
+void otterTaskContext_set_task_start_time(otter_task_context *task,
+                                          uint64_t time);
+
+/**
+ * @brief Set the time at which a task ended.
+ */
+void otterTaskContext_set_task_end_time(otter_task_context *task,
+                                        uint64_t time);
+
+/**
+ * @brief Record that a task was suspended at the given time.
+ *
+ * @return false if the task was already suspended, true otherwise.
+ */
+bool otterTaskContext_suspend(otter_task_context *task, uint64_t time);
+
+/**
+ * @brief Record that a task was resumed at the given time, adding the time
+ * since it was suspended to its wait time.
+ *
+ * @return false if the task was not suspended, true otherwise.
+ */
+bool otterTaskContext_resume(otter_task_context *task, uint64_t time);
+
+/**
+ * @brief Store the source location where a task was created.
+ */
+void otterTaskContext_set_create_location_ref(otter_task_context *task,
+                                             otter_src_ref_t location);
+
+/**
+ * @brief Store the source location where a task was started.
+ */
+void otterTaskContext_set_start_location_ref(otter_task_context *task,
+                                            otter_src_ref_t location);
+
+/**
+ * @brief Mark a task as recording only profile statistics and no events.
+ */
+void otterTaskContext_set_profile_only(otter_task_context *task);
+
+/**
+ * @brief Indicate that some of a task's events have not yet been recorded.
+ *
+ * @param events A combination of otter_deferred_event_t flags.
+ */
+void otterTaskContext_defer_events(otter_task_context *task, int events);
@@ -16,6 +16,10 @@ task_data_t *new_task_data(trace_location_def_t *loc,
 
 void task_destroy(task_data_t *task_data);
 
+/* Destroy a task's region, which must not be stored with any location, and
+   clear the task's reference to it */
+void trace_task_destroy_region(task_data_t *task_data);
+
 unique_id_t trace_task_get_id(task_data_t *task);
 trace_region_def_t *trace_task_get_region_def(task_data_t *task);
 otter_task_flag_t trace_task_get_flags(task_data_t *task);
@@ -0,0 +1,51 @@
+/**
+ * @file trace-task-graph-profile.h
+ * @author Adam Tuft
+ * @brief Aggregate per-label task statistics instead of recording trace events.
+ * Used by otter-task-graph when OTTER_MODE=profile.
+ * @version 0.1
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#if !defined(OTTER_TRACE_TASK_GRAPH_PROFILE_H)
+#define OTTER_TRACE_TASK_GRAPH_PROFILE_H
+
+#include <stdbool.h>
+
+#include "public/config.h"
+
+#include "api/otter-task-graph/otter-task-graph.h" // for otter_task_context typedef
+#include "public/otter-common.h"
+
+/**
+ * @brief Stamp the create time of a task.
+ */
+void trace_profile_task_create(otter_task_context *task);
+
+/**
+ * @brief Stamp the start time of a task.
+ */
+void trace_profile_task_start(otter_task_context *task);
+
+/**
+ * @brief Stamp the end time of a task and accumulate its execution time and
+ * create-to-start latency into the calling thread's statistics, keyed by the
+ * task's label and flavour. Does not take any locks after the first call on
+ * each thread.
+ */
+void trace_profile_task_end(otter_task_context *task);
+
+/**
+ * @brief Merge the statistics gathered by all threads and write a summary to
+ * `profile.csv` within the trace directory given by `opt`. Must be called
+ * before trace_finalise() as task labels are resolved from the string
+ * registry.
+ *
+ * @return true if the summary was written, false otherwise.
+ */
+bool trace_profile_write_summary(const otter_opt_t *opt);
+
+#endif // OTTER_TRACE_TASK_GRAPH_PROFILE_H
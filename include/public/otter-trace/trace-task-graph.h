@@ -17,29 +17,91 @@
 
 #include "api/otter-task-graph/otter-task-graph.h" // only needed for otter_task_context typedef
 #include "public/otter-common.h"
+#include "public/otter-trace/trace-label.h"
 #include "public/otter-trace/trace-location.h"
 #include "public/otter-trace/trace-region-attr.h"
+#include "public/otter-trace/trace-task-context-interface.h"
+#include "public/otter-trace/trace-task-metric.h"
 #include "public/otter-trace/trace-types.h"
 
+/**
+ * @brief Get the current time from the clock used to timestamp events.
+ */
+uint64_t trace_graph_get_timestamp(void);
+
 void trace_graph_event_task_create(trace_location_def_t *location,
                                    unique_id_t encountering_task_id,
                                    unique_id_t new_task_id,
                                    otter_string_ref_t task_label,
-                                   otter_src_ref_t create_ref);
+                                   const otter_label_args_t *label_args,
+                                   otter_src_ref_t create_ref, uint64_t time);
+
+void trace_graph_event_task_create_range(trace_location_def_t *location,
+                                         unique_id_t encountering_task_id,
+                                         unique_id_t first_task_id,
+                                         uint64_t count,
+                                         otter_string_ref_t task_label,
+                                         const otter_label_args_t *label_args,
+                                         otter_src_ref_t create_ref,
+                                         uint64_t time);
 
 void trace_graph_event_task_begin(trace_location_def_t *location,
                                   unique_id_t encountering_task_id,
-                                  otter_src_ref_t start_ref);
+                                  otter_src_ref_t start_ref, uint64_t time);
 
 void trace_graph_event_task_end(trace_location_def_t *location,
                                 unique_id_t encountering_task_id,
-                                otter_src_ref_t end_ref);
+                                otter_src_ref_t end_ref, uint64_t time);
+
+void trace_graph_event_task_suspend(trace_location_def_t *location,
+                                    unique_id_t encountering_task_id,
+                                    otter_src_ref_t suspend_ref, uint64_t time);
+
+void trace_graph_event_task_resume(trace_location_def_t *location,
+                                   unique_id_t encountering_task_id,
+                                   otter_src_ref_t resume_ref, uint64_t time);
+
+void trace_graph_event_task_coalesced(trace_location_def_t *location,
+                                      unique_id_t parent_task_id,
+                                      uint64_t duration, uint64_t end_time);
+
+void trace_graph_defer_task_event(trace_location_def_t *location,
+                                  otter_task_context *task,
+                                  otter_deferred_event_t event,
+                                  uint64_t time);
+
+/**
+ * @brief Write any events still pending on this thread, i.e. its deferred
+ * task events and run of coalesced tasks. Called before another component
+ * writes an event on this thread's location.
+ */
+void trace_graph_flush_pending_events(void);
+
+/**
+ * @brief Write this thread's oldest deferred task events whose outcome is
+ * already known, releasing their tasks. Called as the thread leaves Otter.
+ */
+void trace_graph_flush_settled_events(void);
+
+void trace_graph_event_task_dependence(trace_location_def_t *location,
+                                       unique_id_t pred_task_id,
+                                       unique_id_t succ_task_id);
 
 void trace_graph_synchronise_tasks(trace_location_def_t *location,
                                    unique_id_t encountering_task_id,
                                    trace_sync_region_attr_t sync_attr,
                                    otter_endpoint_t endpoint);
 
+void trace_graph_event_sampling_stride(trace_location_def_t *location,
+                                       unsigned stride);
+
+void trace_graph_event_memory_sample(trace_location_def_t *location);
+
+void trace_graph_event_task_metrics(trace_location_def_t *location,
+                                    unique_id_t task_id,
+                                    const otter_task_metrics_t *metrics,
+                                    uint64_t time);
+
 void trace_task_graph_finalise(void);
 
 #endif // OTTER_TRACE_TASK_GRAPH_H
@@ -0,0 +1,68 @@
+/**
+ * @file trace-task-metric.h
+ * @brief User-defined per-task metrics such as bytes moved or floating-point
+ * operations. Each metric is defined once as an OTF2 metric member. The values
+ * added to a task are accumulated in its context and written as one metric
+ * record when the task ends, so that throughput and arithmetic intensity can
+ * be computed per task or per label.
+ * @version 0.1
+ * @date 2023-05-23
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#if !defined(OTTER_TRACE_TASK_METRIC_H)
+#define OTTER_TRACE_TASK_METRIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "public/otter-common.h"
+#include "public/otter-trace/trace-location.h"
+
+/* The most metrics which may be defined */
+#define OTTER_TASK_MAX_METRICS 8
+
+/**
+ * @brief The metric values accumulated by a task. Bit `k` of `set` is set once
+ * a value has been added for the metric with ID `k`.
+ */
+typedef struct otter_task_metrics_t {
+  uint32_t set;
+  uint64_t values[OTTER_TASK_MAX_METRICS];
+} otter_task_metrics_t;
+
+/**
+ * @brief Define a metric with the given name and unit, writing its metric
+ * member to the global definitions. Defining a name again returns the ID it
+ * was first given. Thread-safe.
+ *
+ * @return The metric's ID, or -1 if OTTER_TASK_MAX_METRICS metrics are already
+ * defined.
+ */
+int trace_task_metric_define(const char *name, const char *unit);
+
+/**
+ * @brief Whether `metric_id` was returned by trace_task_metric_define().
+ */
+bool trace_task_metric_valid(int metric_id);
+
+/**
+ * @brief Get the name of the metric with the given ID, or NULL if there is no
+ * such metric.
+ */
+const char *trace_task_metric_name(int metric_id);
+
+/**
+ * @brief Write the metrics accumulated by a task as one metric record on the
+ * given location, with an attribute giving the task's ID. The record's metric
+ * class has one member per metric set, and is defined the first time each
+ * combination of metrics is written.
+ */
+void trace_task_metric_write(trace_location_def_t *location,
+                             unique_id_t task_id,
+                             const otter_task_metrics_t *metrics,
+                             uint64_t time);
+
+#endif // OTTER_TRACE_TASK_METRIC_H
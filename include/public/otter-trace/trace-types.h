@@ -55,6 +55,26 @@ typedef enum {
   otter_sync_region_barrier_teams = 10
 } otter_sync_region_t;
 
+typedef enum {
+  otter_mutex_lock = 1,
+  otter_mutex_test_lock = 2,
+  otter_mutex_nest_lock = 3,
+  otter_mutex_test_nest_lock = 4,
+  otter_mutex_critical = 5,
+  otter_mutex_atomic = 6,
+  otter_mutex_ordered = 7
+} otter_mutex_t;
+
+typedef enum {
+  otter_dependence_in = 1,
+  otter_dependence_out = 2,
+  otter_dependence_inout = 3,
+  otter_dependence_mutexinoutset = 4,
+  otter_dependence_source = 5,
+  otter_dependence_sink = 6,
+  otter_dependence_inoutset = 7
+} otter_dependence_t;
+
 /**
  * @brief Defines whether a task synchronisation construct should apply a
  * synchronisation constraint to immediate child tasks or all descendant tasks.
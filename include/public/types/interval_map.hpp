@@ -0,0 +1,55 @@
+#if !defined(OTTER_INTERVAL_MAP_PUBLIC_H)
+#define OTTER_INTERVAL_MAP_PUBLIC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct interval_map interval_map;
+typedef void(interval_map_edge_callback)(uint64_t, uint64_t, void *);
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * @brief Create an `interval_map` which tracks, for each range of addresses
+ * accessed, the last task to write it and the tasks which have read it since.
+ *
+ * @return interval_map*
+ */
+interval_map *interval_map_make();
+
+/**
+ * @brief Delete an `interval_map`.
+ *
+ */
+void interval_map_delete(interval_map *);
+
+/**
+ * @brief Record that the task with the given ID reads (`write` is false) or
+ * writes (`write` is true) `bytes` bytes from `start`, in program order.
+ *
+ * The callback is passed the ID of each earlier task the access depends on, the
+ * ID of the accessing task and `data`. A read depends on the last writer of
+ * each address. A write depends on the readers of each address since its last
+ * write or, if there were none, on its last writer. Each edge is reported at
+ * most once for consecutive accesses by the same task.
+ *
+ */
+void interval_map_access(interval_map *, uintptr_t start, size_t bytes,
+                         uint64_t task, bool write,
+                         interval_map_edge_callback *, void *data);
+
+/**
+ * @brief Get the number of disjoint intervals with distinct accesses.
+ *
+ * @return size_t
+ */
+size_t interval_map_size(interval_map *);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // OTTER_INTERVAL_MAP_PUBLIC_H
@@ -0,0 +1,57 @@
+#if !defined(OTTER_MEMORY_ACCOUNTING_H)
+#define OTTER_MEMORY_ACCOUNTING_H
+
+// Public
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/* Categories of memory held by Otter's internal data structures */
+typedef enum {
+  otter_mem_string_registry,
+  otter_mem_task_manager,
+  otter_mem_task_context,
+  otter_mem_region_def,
+  otter_mem_queue_stack,
+  otter_mem_otf2_chunks,
+  otter_mem_dependences,
+  otter_mem_n_categories
+} otter_mem_category_t;
+
+/* record that bytes were allocated to or freed from a category (thread-safe) */
+void otter_mem_alloc(otter_mem_category_t category, size_t bytes);
+void otter_mem_free(otter_mem_category_t category, size_t bytes);
+
+/* bytes currently held by a category, and the most it has held at once */
+size_t otter_mem_current(otter_mem_category_t category);
+size_t otter_mem_high_water(otter_mem_category_t category);
+
+/* a short name for a category, for use in reports */
+const char *otter_mem_category_name(otter_mem_category_t category);
+
+#ifdef __cplusplus
+}
+
+#include <string>
+
+/* Estimate the heap memory held by one node of a std::unordered_map with
+   std::string keys, including the key's own buffer if it is not stored
+   inline */
+inline size_t otter_mem_map_node_bytes(const std::string &key,
+                                       size_t value_size) {
+  size_t bytes = sizeof(void *) + sizeof(size_t) + sizeof(key) + value_size;
+  if (key.capacity() > std::string().capacity())
+    bytes += key.capacity() + 1;
+  return bytes;
+}
+
+/* Estimate the heap memory held by the buckets of a std::unordered_map */
+template <typename Map> inline size_t otter_mem_map_bucket_bytes(const Map &m) {
+  return m.bucket_count() * sizeof(void *);
+}
+#endif
+
+#endif // OTTER_MEMORY_ACCOUNTING_H
@@ -1,3 +1,5 @@
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct string_registry string_registry;
@@ -10,11 +12,23 @@ typedef uint32_t(labeller_fn)(void);
 typedef void(string_registry_callback)(const char *, uint32_t, void *);
 
 string_registry *string_registry_make(labeller_fn *);
+
+/* Make a registry which keeps at most `capacity` strings, evicting the least
+   recently inserted or looked-up string when full. A string inserted again
+   after it was evicted gets a new label. A capacity of 0 is unbounded */
+string_registry *string_registry_make_bounded(labeller_fn *, size_t capacity);
 void string_registry_apply(string_registry *, string_registry_callback *,
                            void *);
 void string_registry_delete(string_registry *);
 uint32_t string_registry_insert(string_registry *, const char *);
 
+/* As string_registry_insert, also setting `inserted` if the string was newly
+   labelled */
+uint32_t string_registry_try_insert(string_registry *, const char *,
+                                    bool *inserted);
+size_t string_registry_size(const string_registry *);
+uint64_t string_registry_evictions(const string_registry *);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -122,6 +122,12 @@ static void on_ompt_callback_work(ompt_work_t wstype,
                                   uint64_t count, const void *codeptr_ra);
 #endif
 
+#if defined(implements_callback_dispatch)
+static void on_ompt_callback_dispatch(ompt_data_t *parallel, ompt_data_t *task,
+                                      ompt_dispatch_t kind,
+                                      ompt_data_t instance);
+#endif
+
 #if defined(implements_callback_master)
 #if defined(USE_OMPT_MASKED)
 static void on_ompt_callback_masked(ompt_scope_endpoint_t endpoint,
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #if !defined(__USE_POSIX)
 #define __USE_POSIX // for HOST_NAME_MAX
 #endif
@@ -10,8 +11,13 @@
 #include "public/debug.h"
 #include "public/otter-common.h"
 #include "public/otter-environment-variables.h"
+#include "public/otter-trace/trace-dependence.h"
+#include "public/otter-trace/trace-dispatch.h"
+#include "public/otter-trace/trace-governor.h"
+#include "public/otter-trace/trace-mutex.h"
 #include "public/otter-trace/trace-ompt.h"
 #include "public/otter-trace/trace-parallel-data.h"
+#include "public/otter-trace/trace-sync-wait.h"
 #include "public/otter-trace/trace-task-data.h"
 #include "public/otter-trace/trace-thread-data.h"
 #include <limits.h>
@@ -22,6 +28,14 @@
 
 /* Static function prototypes */
 static void print_resource_usage(void);
+static unsigned parse_ompt_categories(const char *categories);
+static otter_sync_region_t convert_sync_region_type(ompt_sync_region_t kind);
+static otter_mutex_t convert_mutex_kind(ompt_mutex_t kind);
+static otter_dependence_t convert_dependence_type(ompt_dependence_type_t type);
+
+/* Categories of callbacks requested, as the dispatch category also requires the
+   work callback */
+static unsigned requested_categories = 0;
 
 /* OMPT entrypoint signatures */
 ompt_get_thread_data_t get_thread_data;
@@ -30,21 +44,6 @@ ompt_get_parallel_info_t get_parallel_info;
 /* Register the tool's callbacks with otter-entry.c */
 otter_opt_t *tool_setup(tool_callbacks_t *callbacks,
                         ompt_function_lookup_t lookup) {
-  include_callback(callbacks, ompt_callback_parallel_begin);
-  include_callback(callbacks, ompt_callback_parallel_end);
-  include_callback(callbacks, ompt_callback_thread_begin);
-  include_callback(callbacks, ompt_callback_thread_end);
-  include_callback(callbacks, ompt_callback_task_create);
-  include_callback(callbacks, ompt_callback_task_schedule);
-  include_callback(callbacks, ompt_callback_implicit_task);
-  include_callback(callbacks, ompt_callback_work);
-  include_callback(callbacks, ompt_callback_sync_region);
-#if defined(USE_OMPT_MASKED)
-  include_callback(callbacks, ompt_callback_masked);
-#else
-  include_callback(callbacks, ompt_callback_master);
-#endif
-
   get_thread_data = (ompt_get_thread_data_t)lookup("ompt_get_thread_data");
   get_parallel_info =
       (ompt_get_parallel_info_t)lookup("ompt_get_parallel_info");
@@ -57,13 +56,65 @@ otter_opt_t *tool_setup(tool_callbacks_t *callbacks,
                             .tracename = NULL,
                             .tracepath = NULL,
                             .archive_name = NULL,
-                            .append_hostname = false};
+                            .append_hostname = false,
+                            .overhead_target = 0.0,
+                            .self_profile = false,
+                            .memory_sample_ms = 0,
+                            .ompt_categories = otter_ompt_category_all,
+                            .cpu_sample_events = DEFAULT_CPU_SAMPLE_EVENTS,
+                            .compact_tasks = false,
+                            .dispatch_mode = otter_dispatch_events,
+                            .sync_wait_mode = otter_sync_wait_events,
+                            .mutex_event_threshold = 0,
+                            .dependence_addresses = false};
 
   opt.hostname = host;
   opt.tracename = getenv(ENV_VAR_TRACE_OUTPUT);
   opt.tracepath = getenv(ENV_VAR_TRACE_PATH);
   opt.append_hostname = getenv(ENV_VAR_APPEND_HOST) == NULL ? false : true;
+  opt.self_profile = getenv(ENV_VAR_SELF_PROFILE) == NULL ? false : true;
+  opt.compact_tasks = getenv(ENV_VAR_COMPACT_TASKS) == NULL ? false : true;
+  opt.dependence_addresses =
+      getenv(ENV_VAR_DEPENDENCE_ADDRESSES) == NULL ? false : true;
   opt.event_model = otter_event_model_omp;
+  const char *overhead_target = getenv(ENV_VAR_OVERHEAD_TARGET);
+  if (overhead_target != NULL)
+    opt.overhead_target = strtod(overhead_target, NULL);
+  const char *memory_sample_ms = getenv(ENV_VAR_MEMORY_SAMPLE_MS);
+  if (memory_sample_ms != NULL)
+    opt.memory_sample_ms = strtoull(memory_sample_ms, NULL, 10);
+  const char *ompt_categories = getenv(ENV_VAR_OMPT_CATEGORIES);
+  if (ompt_categories == NULL)
+    ompt_categories = DEFAULT_OMPT_CATEGORIES;
+  opt.ompt_categories = parse_ompt_categories(ompt_categories);
+  const char *cpu_sample_events = getenv(ENV_VAR_CPU_SAMPLE_EVENTS);
+  if (cpu_sample_events != NULL)
+    opt.cpu_sample_events = strtoull(cpu_sample_events, NULL, 10);
+  const char *mutex_event_threshold = getenv(ENV_VAR_MUTEX_EVENT_THRESHOLD);
+  if (mutex_event_threshold != NULL)
+    opt.mutex_event_threshold = strtoull(mutex_event_threshold, NULL, 10);
+  const char *dispatch_mode = getenv(ENV_VAR_DISPATCH_MODE);
+  if (dispatch_mode == NULL)
+    dispatch_mode = DEFAULT_DISPATCH_MODE;
+  if (STR_EQUAL(dispatch_mode, DISPATCH_MODE_NAME_HISTOGRAM)) {
+    opt.dispatch_mode = otter_dispatch_histogram;
+  } else if (!STR_EQUAL(dispatch_mode, DISPATCH_MODE_NAME_EVENTS)) {
+    fprintf(stderr, "Ignoring unrecognised %s: %s\n", ENV_VAR_DISPATCH_MODE,
+            dispatch_mode);
+    dispatch_mode = DISPATCH_MODE_NAME_EVENTS;
+  }
+  const char *sync_wait_mode = getenv(ENV_VAR_SYNC_WAIT_MODE);
+  if (sync_wait_mode == NULL)
+    sync_wait_mode = DEFAULT_SYNC_WAIT_MODE;
+  if (STR_EQUAL(sync_wait_mode, SYNC_WAIT_MODE_NAME_FOLD)) {
+    opt.sync_wait_mode = otter_sync_wait_fold;
+  } else if (STR_EQUAL(sync_wait_mode, SYNC_WAIT_MODE_NAME_TOTAL)) {
+    opt.sync_wait_mode = otter_sync_wait_total;
+  } else if (!STR_EQUAL(sync_wait_mode, SYNC_WAIT_MODE_NAME_EVENTS)) {
+    fprintf(stderr, "Ignoring unrecognised %s: %s\n", ENV_VAR_SYNC_WAIT_MODE,
+            sync_wait_mode);
+    sync_wait_mode = SYNC_WAIT_MODE_NAME_EVENTS;
+  }
 
   /* Apply defaults if variables not provided */
   if (opt.tracename == NULL)
@@ -76,6 +127,65 @@ otter_opt_t *tool_setup(tool_callbacks_t *callbacks,
   LOG_INFO("%-30s %s", ENV_VAR_TRACE_PATH, opt.tracepath);
   LOG_INFO("%-30s %s", ENV_VAR_TRACE_OUTPUT, opt.tracename);
   LOG_INFO("%-30s %s", ENV_VAR_APPEND_HOST, opt.append_hostname ? "Yes" : "No");
+  LOG_INFO("%-30s %g%%", ENV_VAR_OVERHEAD_TARGET, opt.overhead_target);
+  LOG_INFO("%-30s %s", ENV_VAR_SELF_PROFILE, opt.self_profile ? "Yes" : "No");
+  LOG_INFO("%-30s %lu", ENV_VAR_MEMORY_SAMPLE_MS, opt.memory_sample_ms);
+  LOG_INFO("%-30s %s (0x%x)", ENV_VAR_OMPT_CATEGORIES, ompt_categories,
+           opt.ompt_categories);
+  LOG_INFO("%-30s %lu", ENV_VAR_CPU_SAMPLE_EVENTS, opt.cpu_sample_events);
+  LOG_INFO("%-30s %s", ENV_VAR_COMPACT_TASKS, opt.compact_tasks ? "Yes" : "No");
+  LOG_INFO("%-30s %s", ENV_VAR_DISPATCH_MODE, dispatch_mode);
+  LOG_INFO("%-30s %s", ENV_VAR_SYNC_WAIT_MODE, sync_wait_mode);
+  LOG_INFO("%-30s %lu", ENV_VAR_MUTEX_EVENT_THRESHOLD,
+           opt.mutex_event_threshold);
+  LOG_INFO("%-30s %s", ENV_VAR_DEPENDENCE_ADDRESSES,
+           opt.dependence_addresses ? "Yes" : "No");
+
+  /* Callbacks which define the structure of the trace are always requested.
+     Request the others only for the selected categories, so that unwanted
+     events cost nothing. */
+  include_callback(callbacks, ompt_callback_parallel_begin);
+  include_callback(callbacks, ompt_callback_parallel_end);
+  include_callback(callbacks, ompt_callback_thread_begin);
+  include_callback(callbacks, ompt_callback_thread_end);
+  include_callback(callbacks, ompt_callback_implicit_task);
+  if (opt.ompt_categories & otter_ompt_category_task) {
+    include_callback(callbacks, ompt_callback_task_create);
+    include_callback(callbacks, ompt_callback_task_schedule);
+  }
+  requested_categories = opt.ompt_categories;
+  if (opt.ompt_categories &
+      (otter_ompt_category_work | otter_ompt_category_dispatch)) {
+    include_callback(callbacks, ompt_callback_work);
+  }
+  if (opt.ompt_categories & otter_ompt_category_dispatch) {
+    include_callback(callbacks, ompt_callback_dispatch);
+  }
+  if (opt.ompt_categories & otter_ompt_category_sync_wait) {
+    include_callback(callbacks, ompt_callback_sync_region_wait);
+  }
+  if (opt.ompt_categories & otter_ompt_category_mutex) {
+    include_callback(callbacks, ompt_callback_mutex_acquire);
+    include_callback(callbacks, ompt_callback_mutex_acquired);
+    include_callback(callbacks, ompt_callback_mutex_released);
+    include_callback(callbacks, ompt_callback_nest_lock);
+    include_callback(callbacks, ompt_callback_lock_init);
+    include_callback(callbacks, ompt_callback_lock_destroy);
+  }
+  if (opt.ompt_categories & otter_ompt_category_dependences) {
+    include_callback(callbacks, ompt_callback_dependences);
+    include_callback(callbacks, ompt_callback_task_dependence);
+  }
+  if (opt.ompt_categories & otter_ompt_category_sync) {
+    include_callback(callbacks, ompt_callback_sync_region);
+  }
+  if (opt.ompt_categories & otter_ompt_category_master) {
+#if defined(USE_OMPT_MASKED)
+    include_callback(callbacks, ompt_callback_masked);
+#else
+    include_callback(callbacks, ompt_callback_master);
+#endif
+  }
 
   trace_initialise(&opt);
 
@@ -83,11 +193,12 @@ otter_opt_t *tool_setup(tool_callbacks_t *callbacks,
 }
 
 void tool_finalise(ompt_data_t *tool_data) {
+  otter_opt_t *opt = tool_data->ptr;
+
+  trace_mutex_write_summary(opt);
   trace_finalise();
   print_resource_usage();
 
-  otter_opt_t *opt = tool_data->ptr;
-
   char trace_folder[PATH_MAX] = {0};
 
   realpath(opt->tracepath, &trace_folder[0]);
@@ -98,6 +209,117 @@ void tool_finalise(ompt_data_t *tool_data) {
   return;
 }
 
+/* Parse a comma-separated list of category names, or "all". If the first
+   category is prefixed with '-', start from the default categories and remove
+   each category prefixed with '-' e.g. "-work,-sync" */
+static unsigned parse_ompt_categories(const char *categories) {
+  static const struct {
+    const char *name;
+    unsigned mask;
+  } names[] = {
+#define CATEGORY_NAME(cat, bit) {#cat, otter_ompt_category_##cat},
+      FOREACH_OTTER_OMPT_CATEGORY(CATEGORY_NAME)
+#undef CATEGORY_NAME
+      {"all", otter_ompt_category_all}};
+
+  char buffer[256] = {0};
+  strncpy(buffer, categories, sizeof(buffer) - 1);
+  unsigned mask =
+      buffer[0] == '-' ? parse_ompt_categories(DEFAULT_OMPT_CATEGORIES) : 0;
+  char *save = NULL;
+  for (char *name = strtok_r(buffer, ",", &save); name != NULL;
+       name = strtok_r(NULL, ",", &save)) {
+    bool exclude = name[0] == '-';
+    if (exclude)
+      name++;
+    size_t k = 0;
+    while (k < sizeof(names) / sizeof(names[0]) &&
+           strcmp(name, names[k].name) != 0)
+      k++;
+    if (k == sizeof(names) / sizeof(names[0])) {
+      fprintf(stderr, "Ignoring unrecognised %s category: %s\n",
+              ENV_VAR_OMPT_CATEGORIES, name);
+      continue;
+    }
+    mask = exclude ? (mask & ~names[k].mask) : (mask | names[k].mask);
+  }
+  return mask;
+}
+
+/* Convert the OMPT enum type to a generic Otter enum type. The generic barrier
+   kinds are deprecated in 5.1 but still dispatched by older runtimes, so are
+   matched by value */
+static otter_sync_region_t convert_sync_region_type(ompt_sync_region_t kind) {
+  switch ((int)kind) {
+  case 1: // ompt_sync_region_barrier
+    return otter_sync_region_barrier;
+  case 2: // ompt_sync_region_barrier_implicit
+    return otter_sync_region_barrier_implicit;
+  case ompt_sync_region_barrier_explicit:
+    return otter_sync_region_barrier_explicit;
+  case ompt_sync_region_barrier_implementation:
+    return otter_sync_region_barrier_implementation;
+  case ompt_sync_region_taskwait:
+    return otter_sync_region_taskwait;
+  case ompt_sync_region_taskgroup:
+    return otter_sync_region_taskgroup;
+  case ompt_sync_region_reduction:
+    return otter_sync_region_reduction;
+  case ompt_sync_region_barrier_implicit_workshare:
+    return otter_sync_region_barrier_implicit_workshare;
+  case ompt_sync_region_barrier_implicit_parallel:
+    return otter_sync_region_barrier_implicit_parallel;
+  case ompt_sync_region_barrier_teams:
+    return otter_sync_region_barrier_teams;
+  default:
+    return otter_sync_region_barrier;
+  }
+}
+
+/* Convert the OMPT enum type to a generic Otter enum type */
+static otter_mutex_t convert_mutex_kind(ompt_mutex_t kind) {
+  switch (kind) {
+  case ompt_mutex_lock:
+    return otter_mutex_lock;
+  case ompt_mutex_test_lock:
+    return otter_mutex_test_lock;
+  case ompt_mutex_nest_lock:
+    return otter_mutex_nest_lock;
+  case ompt_mutex_test_nest_lock:
+    return otter_mutex_test_nest_lock;
+  case ompt_mutex_critical:
+    return otter_mutex_critical;
+  case ompt_mutex_atomic:
+    return otter_mutex_atomic;
+  case ompt_mutex_ordered:
+    return otter_mutex_ordered;
+  default:
+    return otter_mutex_lock;
+  }
+}
+
+/* Convert the OMPT enum type to a generic Otter enum type */
+static otter_dependence_t convert_dependence_type(ompt_dependence_type_t type) {
+  switch (type) {
+  case ompt_dependence_type_in:
+    return otter_dependence_in;
+  case ompt_dependence_type_out:
+    return otter_dependence_out;
+  case ompt_dependence_type_inout:
+    return otter_dependence_inout;
+  case ompt_dependence_type_mutexinoutset:
+    return otter_dependence_mutexinoutset;
+  case ompt_dependence_type_source:
+    return otter_dependence_source;
+  case ompt_dependence_type_sink:
+    return otter_dependence_sink;
+  case ompt_dependence_type_inoutset:
+    return otter_dependence_inoutset;
+  default:
+    return otter_dependence_inout;
+  }
+}
+
 static void print_resource_usage(void) {
   struct rusage usage;
   getrusage(RUSAGE_SELF, &usage);
@@ -155,6 +377,9 @@ static void on_ompt_callback_thread_end(ompt_data_t *thread) {
   LOG_DEBUG_IF((thread_data->type == ompt_thread_initial), "final clean-up...");
 
   /* Record thread-end event */
+  if (requested_categories & otter_ompt_category_sync_wait) {
+    trace_sync_wait_thread_end(thread_data->location);
+  }
   trace_event_thread_end(thread_data->location);
 
   /* Destroy thread data (also destroys thread_data->location) */
@@ -284,7 +509,10 @@ on_ompt_callback_task_create(ompt_data_t *encountering_task,
                     has_dependences, NULL, codeptr_ra);
 
   trace_region_def_t *task_region = trace_task_get_region_def(task_data);
-  trace_location_store_region_def(thread_data->location, task_region);
+  /* Compact tasks write no region definition */
+  if (!trace_task_is_compact(task_region)) {
+    trace_location_store_region_def(thread_data->location, task_region);
+  }
   trace_event_task_create(thread_data->location, task_region);
 
   new_task->ptr = task_data;
@@ -382,6 +610,21 @@ static void on_ompt_callback_task_schedule(ompt_data_t *prior_task,
       otter_prior_task_status, trace_task_get_region_def(next_task_data));
 #endif
 
+  /* Time spent executing tasks while waiting in a sync region isn't waiting */
+  if (requested_categories & otter_ompt_category_sync_wait) {
+    trace_sync_wait_task_switch(trace_task_get_id(prior_task_data),
+                                trace_task_get_id(next_task_data));
+  }
+
+  /* Compact tasks write no region definition, so a compact task's region is
+     destroyed as soon as it completes */
+  trace_region_def_t *prior_task_region =
+      trace_task_get_region_def(prior_task_data);
+  if (prior_task_status == ompt_task_complete &&
+      trace_task_is_compact(prior_task_region)) {
+    trace_task_destroy_region(prior_task_data);
+  }
+
   return;
 }
 
@@ -485,8 +728,21 @@ static void on_ompt_callback_work(ompt_work_t wstype,
   LOG_DEBUG_WORK_TYPE(thread_data->id, wstype, count,
                       endpoint == ompt_scope_begin ? "begin" : "end");
 
+  /* The last chunk dispatched to this thread ends with the workshare */
+  if (endpoint == ompt_scope_end &&
+      (requested_categories & otter_ompt_category_dispatch)) {
+    trace_dispatch_work_end(thread_data->location);
+  }
+
+  if (!(requested_categories & otter_ompt_category_work)) {
+    return;
+  }
+
   if (wstype != ompt_work_workshare && wstype != ompt_work_distribute) {
     if (endpoint == ompt_scope_begin) {
+      /* Workshare regions may be dropped by the overhead governor */
+      if (!trace_governor_begin_scope(trace_governor_workshare))
+        return;
       trace_region_def_t *wshare_rgn = trace_new_workshare_region(
           /* Convert the OMPT enum type to a generic Otter enum type */
           wstype == ompt_work_loop              ? otter_work_loop
@@ -497,7 +753,7 @@ static void on_ompt_callback_work(ompt_work_t wstype,
           count, trace_task_get_id(task_data));
       trace_location_store_region_def(thread_data->location, wshare_rgn);
       trace_event_enter(thread_data->location, wshare_rgn);
-    } else {
+    } else if (trace_governor_end_scope(trace_governor_workshare)) {
       trace_event_leave(thread_data->location);
     }
   }
@@ -505,6 +761,55 @@ static void on_ompt_callback_work(ompt_work_t wstype,
   return;
 }
 
+/* The fields of ompt_dispatch_chunk_t (OpenMP 5.2), which is passed by pointer
+   in the instance argument of the dispatch callback for the chunk kinds below.
+   Not yet defined by every omp-tools.h */
+typedef struct otter_dispatch_chunk_t {
+  uint64_t start;
+  uint64_t iterations;
+} otter_dispatch_chunk_t;
+
+enum {
+  otter_dispatch_ws_loop_chunk = 3,
+  otter_dispatch_taskloop_chunk = 4,
+  otter_dispatch_distribute_chunk = 5
+};
+
+/* Used for callbacks that are dispatched when a thread begins to execute a
+   section or a chunk of loop iterations in a worksharing construct.
+
+   In OpenMP 5.1 a callback is dispatched for each iteration or section, with
+   the iteration or section number in instance.value. From OpenMP 5.2 a callback
+   may instead be dispatched for each chunk, with instance.ptr pointing to the
+   first iteration and number of iterations in the chunk.
+ */
+static void on_ompt_callback_dispatch(ompt_data_t *parallel, ompt_data_t *task,
+                                      ompt_dispatch_t kind,
+                                      ompt_data_t instance) {
+  thread_data_t *thread_data = (thread_data_t *)get_thread_data()->ptr;
+
+  switch ((int)kind) {
+  case ompt_dispatch_iteration:
+  case ompt_dispatch_section:
+    trace_dispatch_chunk(thread_data->location, instance.value, 1);
+    break;
+  case otter_dispatch_ws_loop_chunk:
+  case otter_dispatch_taskloop_chunk:
+  case otter_dispatch_distribute_chunk: {
+    const otter_dispatch_chunk_t *chunk =
+        (const otter_dispatch_chunk_t *)instance.ptr;
+    trace_dispatch_chunk(thread_data->location, chunk->start,
+                         chunk->iterations);
+    break;
+  }
+  default:
+    LOG_DEBUG("[t=%lu] ignoring dispatch of kind %d", thread_data->id,
+              (int)kind);
+  }
+
+  return;
+}
+
 /* Used for callbacks that are dispatched when master regions start and end.
 
     NOTE: deprecated in 5.1 and replaced with ompt_callback_masked
@@ -527,11 +832,14 @@ on_ompt_callback_master(
             endpoint == ompt_scope_begin ? "begin" : "end");
 
   if (endpoint == ompt_scope_begin) {
+    /* Master regions may be dropped by the overhead governor */
+    if (!trace_governor_begin_scope(trace_governor_master))
+      return;
     trace_region_def_t *master_rgn =
         trace_new_master_region(location_id, task_id);
     trace_location_store_region_def(location, master_rgn);
     trace_event_enter(location, master_rgn);
-  } else {
+  } else if (trace_governor_end_scope(trace_governor_master)) {
     trace_event_leave(location);
   }
   return;
@@ -558,41 +866,7 @@ static void on_ompt_callback_sync_region(ompt_sync_region_t kind,
                                                  : "unknown");
 
   if (endpoint == ompt_scope_begin) {
-    otter_sync_region_t sync_type = otter_sync_region_barrier;
-    switch (kind) {
-    ompt_sync_region_barrier:
-      sync_type = otter_sync_region_barrier;
-      break;
-    ompt_sync_region_barrier_implicit:
-      sync_type = otter_sync_region_barrier_implicit;
-      break;
-    ompt_sync_region_barrier_explicit:
-      sync_type = otter_sync_region_barrier_explicit;
-      break;
-    ompt_sync_region_barrier_implementation:
-      sync_type = otter_sync_region_barrier_implementation;
-      break;
-    ompt_sync_region_taskwait:
-      sync_type = otter_sync_region_taskwait;
-      break;
-    ompt_sync_region_taskgroup:
-      sync_type = otter_sync_region_taskgroup;
-      break;
-    ompt_sync_region_reduction:
-      sync_type = otter_sync_region_reduction;
-      break;
-    ompt_sync_region_barrier_implicit_workshare:
-      sync_type = otter_sync_region_barrier_implicit_workshare;
-      break;
-    ompt_sync_region_barrier_implicit_parallel:
-      sync_type = otter_sync_region_barrier_implicit_parallel;
-      break;
-    ompt_sync_region_barrier_teams:
-      sync_type = otter_sync_region_barrier_teams;
-      break;
-    default:
-      sync_type = otter_sync_region_barrier;
-    }
+    otter_sync_region_t sync_type = convert_sync_region_type(kind);
 
     trace_region_def_t *sync_rgn = trace_new_sync_region(
         sync_type,
@@ -606,3 +880,125 @@ static void on_ompt_callback_sync_region(ompt_sync_region_t kind,
   }
   return;
 }
+
+/* Used for callbacks that are dispatched when a thread begins and ends waiting
+   in a barrier, taskwait or taskgroup region. This is nested within the
+   enclosing sync-region-begin/end and may contain task-schedule events where
+   the thread executes tasks while it waits.
+ */
+static void on_ompt_callback_sync_region_wait(ompt_sync_region_t kind,
+                                              ompt_scope_endpoint_t endpoint,
+                                              ompt_data_t *parallel,
+                                              ompt_data_t *task,
+                                              const void *codeptr_ra) {
+  thread_data_t *thread_data = (thread_data_t *)get_thread_data()->ptr;
+  task_data_t *task_data = task == NULL ? NULL : (task_data_t *)task->ptr;
+
+  LOG_DEBUG("[t=%lu] (event) sync-region-wait-%s", thread_data->id,
+            endpoint == ompt_scope_begin ? "begin" : "end");
+
+  if (endpoint == ompt_scope_begin) {
+    trace_sync_wait_begin(thread_data->location, convert_sync_region_type(kind),
+                          trace_task_get_id(task_data));
+  } else {
+    trace_sync_wait_end(thread_data->location);
+  }
+  return;
+}
+
+/* Used for callbacks that are dispatched when a thread begins to wait for,
+   acquires and releases a lock, critical section, atomic or ordered region.
+   Statistics are aggregated by the kind of mutex and the code which acquired
+   it. The wait_id identifies the mutex between the callbacks.
+ */
+static void on_ompt_callback_mutex_acquire(ompt_mutex_t kind, unsigned int hint,
+                                           unsigned int impl,
+                                           ompt_wait_id_t wait_id,
+                                           const void *codeptr_ra) {
+  trace_mutex_acquire(convert_mutex_kind(kind), wait_id, codeptr_ra);
+  return;
+}
+
+static void on_ompt_callback_mutex_acquired(ompt_mutex_t kind,
+                                            ompt_wait_id_t wait_id,
+                                            const void *codeptr_ra) {
+  thread_data_t *thread_data = (thread_data_t *)get_thread_data()->ptr;
+  trace_mutex_acquired(thread_data->location, wait_id);
+  return;
+}
+
+/* Dispatched instead of mutex-acquired and mutex-released when a thread
+   acquires or releases a nest lock it already holds */
+static void on_ompt_callback_nest_lock(ompt_scope_endpoint_t endpoint,
+                                       ompt_wait_id_t wait_id,
+                                       const void *codeptr_ra) {
+  trace_mutex_nest_lock(wait_id, endpoint == ompt_scope_begin);
+  return;
+}
+
+static void on_ompt_callback_mutex_released(ompt_mutex_t kind,
+                                            ompt_wait_id_t wait_id,
+                                            const void *codeptr_ra) {
+  thread_data_t *thread_data = (thread_data_t *)get_thread_data()->ptr;
+  trace_mutex_released(thread_data->location, wait_id);
+  return;
+}
+
+/* Used for callbacks that are dispatched when a lock is initialised and
+   destroyed. Counted against the code which initialised or destroyed it.
+ */
+static void on_ompt_callback_lock_init(ompt_mutex_t kind, unsigned int hint,
+                                       unsigned int impl,
+                                       ompt_wait_id_t wait_id,
+                                       const void *codeptr_ra) {
+  trace_mutex_lock_init(convert_mutex_kind(kind), codeptr_ra);
+  return;
+}
+
+static void on_ompt_callback_lock_destroy(ompt_mutex_t kind,
+                                          ompt_wait_id_t wait_id,
+                                          const void *codeptr_ra) {
+  trace_mutex_lock_destroy(convert_mutex_kind(kind), codeptr_ra);
+  return;
+}
+
+/* Used for callbacks that are dispatched when a task with dependences is
+   created, after its task-create event. Records each dependence the task
+   declares.
+ */
+static void on_ompt_callback_dependences(ompt_data_t *task,
+                                         const ompt_dependence_t *deps,
+                                         int ndeps) {
+  thread_data_t *thread_data = (thread_data_t *)get_thread_data()->ptr;
+  task_data_t *task_data = (task_data_t *)task->ptr;
+  if (task_data == NULL) {
+    LOG_DEBUG("ignored dependences of unknown task");
+    return;
+  }
+  unique_id_t task_id = trace_task_get_id(task_data);
+  for (int k = 0; k < ndeps; k++) {
+    trace_dependence_declare(thread_data->location, task_id,
+                             convert_dependence_type(deps[k].dependence_type),
+                             deps[k].variable.ptr);
+  }
+  return;
+}
+
+/* Used for callbacks that are dispatched when the runtime finds that a new
+   task (the sink) must wait for an earlier sibling (the source) to complete.
+   These are the edges of the task dependency graph.
+ */
+static void on_ompt_callback_task_dependence(ompt_data_t *src_task,
+                                             ompt_data_t *sink_task) {
+  thread_data_t *thread_data = (thread_data_t *)get_thread_data()->ptr;
+  task_data_t *src_task_data = (task_data_t *)src_task->ptr;
+  task_data_t *sink_task_data = (task_data_t *)sink_task->ptr;
+  if (src_task_data == NULL || sink_task_data == NULL) {
+    LOG_DEBUG("ignored dependence between unknown tasks");
+    return;
+  }
+  trace_dependence_edge(thread_data->location,
+                        trace_task_get_id(src_task_data),
+                        trace_task_get_id(sink_task_data));
+  return;
+}
@@ -36,6 +36,16 @@
 #define implements_callback_work
 #define implements_callback_sync_region
 #define implements_callback_master
+#define implements_callback_dispatch
+#define implements_callback_sync_region_wait
+#define implements_callback_mutex_acquire
+#define implements_callback_mutex_acquired
+#define implements_callback_mutex_released
+#define implements_callback_nest_lock
+#define implements_callback_lock_init
+#define implements_callback_lock_destroy
+#define implements_callback_dependences
+#define implements_callback_task_dependence
 #include "ompt-callback-prototypes.h"
 
 #endif // OTTER_H
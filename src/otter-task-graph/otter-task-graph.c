@@ -19,6 +19,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "public/config.h"
@@ -29,15 +30,25 @@
 #include "public/otter-environment-variables.h"
 #include "public/otter-trace/source-location.h"
 #include "public/otter-trace/strings.h"
+#include "public/otter-trace/trace-counter.h"
+#include "public/otter-trace/trace-governor.h"
 #include "public/otter-trace/trace-initialise.h"
+#include "public/otter-trace/trace-label.h"
+#include "public/otter-trace/trace-memory.h"
+#include "public/otter-trace/trace-self-profile.h"
 #include "public/otter-trace/trace-task-context-interface.h"
+#include "public/otter-trace/trace-task-graph-profile.h"
 #include "public/otter-trace/trace-task-graph.h"
 #include "public/otter-trace/trace-task-manager.h"
+#include "public/otter-trace/trace-task-metric.h"
 #include "public/otter-trace/trace-thread-data.h"
 #include "public/otter-version.h"
+#include "public/types/interval_map.hpp"
 #include "public/types/queue.h"
+#include "public/types/stack.h"
 
 #define LABEL_BUFFER_MAX_CHARS 256
+#define FINALISE_MAX_THREADS 8
 
 struct thread_data_queue {
   otter_queue_t *instance;
@@ -52,18 +63,36 @@ static otter_opt_t opt = {.hostname = NULL,
                           .tracename = NULL,
                           .tracepath = NULL,
                           .archive_name = NULL,
-                          .append_hostname = false};
+                          .append_hostname = false,
+                          .mode = otter_mode_trace,
+                          .coalesce_threshold = 0,
+                          .overhead_target = 0.0,
+                          .self_profile = false,
+                          .memory_sample_ms = 0,
+                          .structured_labels = false,
+                          .string_cache_size = 0,
+                          .counter_mode = otter_counter_change,
+                          .counter_interval_us = DEFAULT_COUNTER_INTERVAL_US};
 
 // The implicit root task
 static otter_task_context *root_task = NULL;
 static otter_task_context *phase_task = NULL;
 
+// whether any task has been set to record only profile statistics
+static bool profile_only_tasks = false;
+
 // TODO: move into trace_state_t
 static pthread_mutex_t task_manager_mutex = PTHREAD_MUTEX_INITIALIZER;
 static trace_task_manager_t *task_manager = NULL;
-#define TASK_MANAGER_LOCK() pthread_mutex_lock(&task_manager_mutex)
+#define TASK_MANAGER_LOCK()                                                    \
+  TRACE_SELF_PROFILE(trace_self_task_manager_wait,                             \
+                     pthread_mutex_lock(&task_manager_mutex))
 #define TASK_MANAGER_UNLOCK() pthread_mutex_unlock(&task_manager_mutex)
 
+// resolves the data accesses annotated by otterTaskAccess to dependences
+static pthread_mutex_t access_map_mutex = PTHREAD_MUTEX_INITIALIZER;
+static interval_map *access_map = NULL;
+
 // per-thread state
 static thread_local thread_data_t *thread_data = NULL;
 
@@ -71,6 +100,13 @@ static thread_local thread_data_t *thread_data = NULL;
 static struct thread_data_queue thread_queue = {
     .instance = NULL, .lock = PTHREAD_MUTEX_INITIALIZER};
 
+// the tasks started and not yet ended by this thread, innermost on top
+static thread_local otter_stack_t *current_tasks = NULL;
+
+// store per-thread stacks of current tasks for clean-up at finalisation
+static struct thread_data_queue current_tasks_queue = {
+    .instance = NULL, .lock = PTHREAD_MUTEX_INITIALIZER};
+
 static inline thread_data_t *get_thread_data(void) {
   if (thread_data == NULL) {
     thread_data = new_thread_data(otter_thread_worker);
@@ -88,25 +124,223 @@ static inline thread_data_t *get_thread_data(void) {
   return thread_data;
 }
 
-static void otter_register_task_label_va_list(otter_task_context *task,
-                                              bool add_to_task_manager,
-                                              const char *format,
-                                              va_list args) {
-  char label_buffer[LABEL_BUFFER_MAX_CHARS] = {0};
+/* Format a label into a buffer of LABEL_BUFFER_MAX_CHARS chars */
+static void otter_format_label_va_list(char *label_buffer, const char *format,
+                                       va_list args) {
   int chars_required =
-      vsnprintf(&label_buffer[0], LABEL_BUFFER_MAX_CHARS, format, args);
+      vsnprintf(label_buffer, LABEL_BUFFER_MAX_CHARS, format, args);
   if (chars_required >= LABEL_BUFFER_MAX_CHARS) {
     LOG_WARN("label truncated (%d/%d chars written): %s",
              LABEL_BUFFER_MAX_CHARS, chars_required, label_buffer);
   }
+}
+
+static inline otter_stack_t *get_current_tasks(void) {
+  if (current_tasks == NULL) {
+    current_tasks = stack_create();
+    pthread_mutex_lock(&current_tasks_queue.lock);
+    if (current_tasks_queue.instance == NULL) {
+      current_tasks_queue.instance = queue_create();
+    }
+    queue_push(current_tasks_queue.instance,
+               (data_item_t){.ptr = current_tasks});
+    pthread_mutex_unlock(&current_tasks_queue.lock);
+  }
+  return current_tasks;
+}
+
+/* Make a task current on this thread. Each entry in a thread's stack of
+   current tasks holds a reference to its task, so that a task ended by another
+   thread is only deleted once the owning thread has dropped its entry */
+static inline void push_current_task(otter_task_context *task) {
+  otter_stack_t *stack = get_current_tasks();
+  otterTaskContext_retain(task);
+  stack_push(stack, (data_item_t){.ptr = task});
+  otterTaskContext_exchange_current_stack(task, stack);
+}
+
+/* Stop a task being current. A task ended or suspended by the thread which
+   made it current is removed from wherever it sits in that thread's stack.
+   Only the owning thread may change its stack, so a task ended or suspended by
+   any other thread is left in place, no longer marked as held by that stack,
+   and the owning thread drops it lazily in otterTaskCurrent() */
+static inline void pop_current_task(otter_task_context *task) {
+  otter_stack_t *stack = get_current_tasks();
+  otter_stack_t *owner = otterTaskContext_exchange_current_stack(task, NULL);
+  if (owner == stack) {
+    if (stack_remove(stack, (data_item_t){.ptr = task})) {
+      otterTaskContext_release(task);
+    }
+  } else if (owner != NULL) {
+    LOG_DEBUG("task %p left current on another thread", task);
+  }
+}
+
+/* Whether a task only accumulates profile statistics rather than recording
+   events, as do all tasks in profile mode */
+static inline bool is_profiled(const otter_task_context *task) {
+  return opt.mode == otter_mode_profile ||
+         otterTaskContext_is_profile_only(task);
+}
+
+/* The default parent of a task: the innermost task running on this thread, or
+   otherwise the current phase (or root) task. Only the implicit root task may
+   have a NULL parent */
+static inline otter_task_context *get_default_parent(void) {
+  otter_task_context *task = otterTaskCurrent();
+  if (task == NULL) {
+    task = phase_task != NULL ? phase_task : root_task;
+  }
+  return task;
+}
+
+/* Intern a label and return its string ref. With structured labels, a label
+   whose arguments are all numbers is interned as its format string and its
+   arguments are stored in label_args, so it is only formatted into
+   label_buffer if format_label is true (e.g. to add a task to a pool). Any
+   other label is always formatted into label_buffer and interned */
+static otter_string_ref_t otter_intern_label_va_list(
+    otter_label_args_t *label_args, char *label_buffer, bool format_label,
+    const char *format, va_list args) {
+  label_args->count = 0;
+  if (!trace_label_structured()) {
+    otter_format_label_va_list(label_buffer, format, args);
+    return get_string_ref(label_buffer);
+  }
+  va_list parse_args;
+  va_copy(parse_args, args);
+  bool parsed = trace_label_parse(format, parse_args, label_args);
+  va_end(parse_args);
+  otter_string_ref_t template_ref = get_string_ref(format);
+  if (parsed) {
+    trace_label_count(template_ref, format, label_args, NULL);
+    if (format_label) {
+      otter_format_label_va_list(label_buffer, format, args);
+    }
+    return template_ref;
+  }
+  label_args->count = 0;
+  otter_format_label_va_list(label_buffer, format, args);
+  trace_label_count(template_ref, format, NULL, label_buffer);
+  return get_string_ref(label_buffer);
+}
+
+static void otter_register_task_label_va_list(otter_task_context *task,
+                                              bool add_to_task_manager,
+                                              const char *format,
+                                              va_list args) {
+  char label_buffer[LABEL_BUFFER_MAX_CHARS] = {0};
+  otter_label_args_t label_args;
+  otter_string_ref_t task_label_ref = otter_intern_label_va_list(
+      &label_args, &label_buffer[0], add_to_task_manager, format, args);
   if (add_to_task_manager) {
     LOG_DEBUG("register task with label: %s", label_buffer);
     TASK_MANAGER_LOCK();
     trace_task_manager_add_task(task_manager, &label_buffer[0], task);
     TASK_MANAGER_UNLOCK();
   }
-  otter_string_ref_t task_label_ref = get_string_ref(&label_buffer[0]);
   otterTaskContext_set_task_label_ref(task, task_label_ref);
+  if (label_args.count != 0) {
+    otterTaskContext_set_task_label_args(task, &label_args);
+  }
+}
+
+/* Whether task-create and task-start events are deferred until it is known
+   whether a task is a leaf task which may be coalesced */
+static inline bool defer_task_events(void) {
+  return opt.coalesce_threshold > 0 || trace_governor_enabled();
+}
+
+/* Record any memory sample which is due and any deferred events now settled,
+   then stop measuring time spent in Otter, recording any resulting change to
+   this thread's sampling stride */
+static inline void leave_otter(uint64_t enter) {
+  if (trace_memory_sample_due()) {
+    trace_graph_event_memory_sample(get_thread_data()->location);
+  }
+  trace_counter_sample(get_thread_data()->location);
+  trace_graph_flush_settled_events();
+  unsigned stride = trace_governor_leave(enter);
+  if (stride != 0) {
+    trace_graph_event_sampling_stride(get_thread_data()->location, stride);
+  }
+}
+
+/* Record an edge of the task dependency graph found in the access map */
+static void record_task_dependence(uint64_t pred_id, uint64_t succ_id,
+                                   void *data) {
+  trace_graph_event_task_dependence(get_thread_data()->location, pred_id,
+                                    succ_id);
+}
+
+/* Prevent a task from being coalesced, so that any of its create or start
+   events which were deferred are recorded by the threads which deferred them */
+static inline void keep_task_events(otter_task_context *task) {
+  otterTaskContext_defer_events(task, otter_deferred_keep);
+}
+
+/* Defer a task-create or task-start event of a task which may be coalesced */
+static inline void defer_task_event(otter_task_context *task,
+                                    otter_deferred_event_t event,
+                                    uint64_t time) {
+  otterTaskContext_defer_events(task, event);
+  trace_graph_defer_task_event(get_thread_data()->location, task, event, time);
+}
+
+typedef struct thread_data_batch_t {
+  thread_data_t **items;
+  size_t count;
+  size_t next;
+} thread_data_batch_t;
+
+static void *destroy_thread_data_worker(void *arg) {
+  thread_data_batch_t *batch = (thread_data_batch_t *)arg;
+  size_t k = 0;
+  while ((k = __sync_fetch_and_add(&batch->next, 1)) < batch->count) {
+    LOG_DEBUG("destroy thread data %p", batch->items[k]);
+    thread_destroy(batch->items[k]);
+  }
+  return NULL;
+}
+
+/* Destroy the thread data in a queue. Destroying a thread's location flushes
+   and closes its event writer, which is independent of all other locations, so
+   this is shared between up to FINALISE_MAX_THREADS threads */
+static void destroy_thread_data(otter_queue_t *queue) {
+  thread_data_batch_t batch = {.items = NULL, .count = 0, .next = 0};
+  batch.items = malloc(queue_length(queue) * sizeof(*batch.items));
+  if (batch.items == NULL) {
+    LOG_ERROR("failed to allocate thread data batch");
+    return;
+  }
+  while (queue_pop(queue, (data_item_t *)&batch.items[batch.count])) {
+    batch.count++;
+  }
+
+  // sysconf() returns -1 if the number of CPUs is unknown
+  long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n_cpus < 1) {
+    n_cpus = 1;
+  }
+  size_t n_threads = n_cpus < FINALISE_MAX_THREADS ? (size_t)n_cpus
+                                                   : FINALISE_MAX_THREADS;
+  if (n_threads > batch.count) {
+    n_threads = batch.count;
+  }
+  pthread_t workers[FINALISE_MAX_THREADS];
+  size_t n_workers = 0;
+  for (; n_workers + 1 < n_threads; n_workers++) {
+    if (pthread_create(&workers[n_workers], NULL, destroy_thread_data_worker,
+                       &batch) != 0) {
+      LOG_WARN("failed to start finalisation thread");
+      break;
+    }
+  }
+  destroy_thread_data_worker(&batch);
+  for (size_t k = 0; k < n_workers; k++) {
+    pthread_join(workers[k], NULL);
+  }
+  free(batch.items);
 }
 
 void otterTraceInitialise(const char *file, const char *func, int line) {
@@ -119,22 +353,91 @@ void otterTraceInitialise(const char *file, const char *func, int line) {
   opt.tracename = getenv(ENV_VAR_TRACE_OUTPUT);
   opt.tracepath = getenv(ENV_VAR_TRACE_PATH);
   opt.append_hostname = getenv(ENV_VAR_APPEND_HOST) == NULL ? false : true;
+  opt.self_profile = getenv(ENV_VAR_SELF_PROFILE) == NULL ? false : true;
+  opt.structured_labels =
+      getenv(ENV_VAR_STRUCTURED_LABELS) == NULL ? false : true;
   opt.event_model = otter_event_model_task_graph;
+  const char *mode = getenv(ENV_VAR_MODE);
+  const char *coalesce_threshold = getenv(ENV_VAR_COALESCE_THRESHOLD);
+  const char *overhead_target = getenv(ENV_VAR_OVERHEAD_TARGET);
+  const char *memory_sample_ms = getenv(ENV_VAR_MEMORY_SAMPLE_MS);
+  const char *string_cache_size = getenv(ENV_VAR_STRING_CACHE_SIZE);
+  const char *counter_mode = getenv(ENV_VAR_COUNTER_MODE);
+  const char *counter_interval_us = getenv(ENV_VAR_COUNTER_INTERVAL_US);
 
   /* Apply defaults if variables not provided */
   if (opt.tracename == NULL)
     opt.tracename = DEFAULT_OTF2_TRACE_OUTPUT;
   if (opt.tracepath == NULL)
     opt.tracepath = DEFAULT_OTF2_TRACE_PATH;
+  if (mode == NULL)
+    mode = DEFAULT_MODE;
+  if (counter_mode == NULL)
+    counter_mode = DEFAULT_COUNTER_MODE;
+
+  if (strcmp(mode, MODE_NAME_PROFILE) == 0) {
+    opt.mode = otter_mode_profile;
+  } else {
+    LOG_WARN_IF(strcmp(mode, MODE_NAME_TRACE) != 0,
+                "unrecognised %s=%s, using %s", ENV_VAR_MODE, mode,
+                MODE_NAME_TRACE);
+    opt.mode = otter_mode_trace;
+  }
+
+  if (coalesce_threshold != NULL) {
+    opt.coalesce_threshold = strtoull(coalesce_threshold, NULL, 10);
+  }
+
+  if (overhead_target != NULL) {
+    opt.overhead_target = strtod(overhead_target, NULL);
+  }
+
+  if (memory_sample_ms != NULL) {
+    opt.memory_sample_ms = strtoull(memory_sample_ms, NULL, 10);
+  }
+
+  if (string_cache_size != NULL) {
+    opt.string_cache_size = strtoull(string_cache_size, NULL, 10);
+  }
+
+  if (strcmp(counter_mode, COUNTER_MODE_NAME_PERIODIC) == 0) {
+    opt.counter_mode = otter_counter_periodic;
+  } else {
+    LOG_WARN_IF(strcmp(counter_mode, COUNTER_MODE_NAME_CHANGE) != 0,
+                "unrecognised %s=%s, using %s", ENV_VAR_COUNTER_MODE,
+                counter_mode, COUNTER_MODE_NAME_CHANGE);
+    opt.counter_mode = otter_counter_change;
+  }
+
+  if (counter_interval_us != NULL) {
+    opt.counter_interval_us = strtoull(counter_interval_us, NULL, 10);
+  }
 
   LOG_INFO("Otter environment variables:");
   LOG_INFO("%-30s %s", "host", opt.hostname);
   LOG_INFO("%-30s %s", ENV_VAR_TRACE_PATH, opt.tracepath);
   LOG_INFO("%-30s %s", ENV_VAR_TRACE_OUTPUT, opt.tracename);
   LOG_INFO("%-30s %s", ENV_VAR_APPEND_HOST, opt.append_hostname ? "Yes" : "No");
+  LOG_INFO("%-30s %s", ENV_VAR_MODE,
+           opt.mode == otter_mode_profile ? MODE_NAME_PROFILE : MODE_NAME_TRACE);
+  LOG_INFO("%-30s %" PRIu64, ENV_VAR_COALESCE_THRESHOLD,
+           opt.coalesce_threshold);
+  LOG_INFO("%-30s %g%%", ENV_VAR_OVERHEAD_TARGET, opt.overhead_target);
+  LOG_INFO("%-30s %s", ENV_VAR_SELF_PROFILE, opt.self_profile ? "Yes" : "No");
+  LOG_INFO("%-30s %" PRIu64, ENV_VAR_MEMORY_SAMPLE_MS, opt.memory_sample_ms);
+  LOG_INFO("%-30s %s", ENV_VAR_STRUCTURED_LABELS,
+           opt.structured_labels ? "Yes" : "No");
+  LOG_INFO("%-30s %" PRIu64, ENV_VAR_STRING_CACHE_SIZE, opt.string_cache_size);
+  LOG_INFO("%-30s %s", ENV_VAR_COUNTER_MODE,
+           opt.counter_mode == otter_counter_periodic
+               ? COUNTER_MODE_NAME_PERIODIC
+               : COUNTER_MODE_NAME_CHANGE);
+  LOG_INFO("%-30s %" PRIu64, ENV_VAR_COUNTER_INTERVAL_US,
+           opt.counter_interval_us);
 
   trace_initialise(&opt);
   task_manager = trace_task_manager_alloc();
+  access_map = interval_map_make();
 
   // Write the definition of a dummy location
   // trace_write_location_definition(...)? or simply via
@@ -187,16 +490,39 @@ void otterTraceFinalise(const char *file, const char *func, int line) {
 #endif
 
   trace_task_manager_free(task_manager);
+  interval_map_delete(access_map);
+  access_map = NULL;
+
+  // must happen before thread locations are destroyed
+  trace_task_graph_finalise();
+  trace_counter_finalise();
 
   // destroy any accumulated thread data
-  void *thread_data = NULL;
-  while (queue_pop(thread_queue.instance, (data_item_t *)&thread_data)) {
-    LOG_DEBUG("destroy thread data %p", thread_data);
-    thread_destroy(thread_data);
-  }
+  destroy_thread_data(thread_queue.instance);
   queue_destroy(thread_queue.instance, false, NULL);
 
-  trace_task_graph_finalise();
+  // destroy each thread's stack of current tasks
+  otter_stack_t *stack = NULL;
+  while (queue_pop(current_tasks_queue.instance, (data_item_t *)&stack)) {
+    data_item_t item = {.ptr = NULL};
+    while (stack_pop(stack, &item)) {
+      otterTaskContext_release((otter_task_context *)item.ptr);
+    }
+    stack_destroy(stack, false, NULL);
+  }
+  queue_destroy(current_tasks_queue.instance, false, NULL);
+  current_tasks_queue.instance = NULL;
+  current_tasks = NULL;
+
+  // must happen before trace_finalise() which releases the task label strings
+  if (opt.mode == otter_mode_profile || profile_only_tasks) {
+    trace_profile_write_summary(&opt);
+  }
+
+  if (opt.structured_labels) {
+    trace_label_write_summary(&opt);
+  }
+
   trace_finalise();
 
   char trace_folder[PATH_MAX] = {0};
@@ -212,20 +538,14 @@ otter_task_context *otterTaskInitialise(otter_task_context *parent, int flavour,
                                         const char *file, const char *func,
                                         int line, const char *format, ...) {
   LOG_DEBUG("%s:%d in %s", file, line, func);
+  uint64_t governor_enter = trace_governor_enter();
   otter_task_context *task = otterTaskContext_alloc();
   otter_src_ref_t init_ref = get_source_location_ref(
       (otter_src_location_t){.file = file, .func = func, .line = line});
 
-  // If no parent given, set the current phase (or root) task as the parent.
-  // Only the implicit root task may have a NULL parent.
+  // If no parent given, set the current task as the parent.
   if (parent == NULL) {
-    if (phase_task != NULL) {
-      parent = phase_task;
-    } else if (root_task != NULL) {
-      parent = root_task;
-    } else {
-      parent = NULL;
-    }
+    parent = get_default_parent();
   }
 
   otterTaskContext_init(task, parent, flavour, init_ref);
@@ -238,9 +558,84 @@ otter_task_context *otterTaskInitialise(otter_task_context *parent, int flavour,
   if (record_task_create_event)
     otterTaskCreate(task, parent, file, func, line);
 
+  leave_otter(governor_enter);
   return task;
 }
 
+void otterTaskInitialiseRange(otter_task_context *parent, int n,
+                              otter_task_context **tasks, int flavour,
+                              otter_add_to_pool_t add_to_pool,
+                              const char *file, const char *func, int line,
+                              const char *format, ...) {
+  LOG_DEBUG("%s:%d in %s (%d tasks)", file, line, func, n);
+  if (tasks == NULL || n <= 0) {
+    LOG_ERROR("IGNORED (tried to initialise %d tasks at %s:%d in %s)", n, file,
+              line, func);
+    return;
+  }
+  uint64_t governor_enter = trace_governor_enter();
+  otter_src_ref_t init_ref = get_source_location_ref(
+      (otter_src_location_t){.file = file, .func = func, .line = line});
+
+  // If no parent given, set the current task as the parent.
+  if (parent == NULL) {
+    parent = get_default_parent();
+  }
+
+  for (int k = 0; k < n; k++) {
+    tasks[k] = otterTaskContext_alloc();
+  }
+  otterTaskContext_init_range(tasks, n, parent, flavour, init_ref);
+
+  char label_buffer[LABEL_BUFFER_MAX_CHARS] = {0};
+  otter_label_args_t label_args;
+  va_list args;
+  va_start(args, format);
+  otter_string_ref_t label_ref = otter_intern_label_va_list(
+      &label_args, &label_buffer[0], add_to_pool == otter_add_to_pool, format,
+      args);
+  va_end(args);
+  for (int k = 0; k < n; k++) {
+    otterTaskContext_set_task_label_ref(tasks[k], label_ref);
+    if (label_args.count != 0) {
+      otterTaskContext_set_task_label_args(tasks[k], &label_args);
+    }
+  }
+  if (add_to_pool == otter_add_to_pool) {
+    LOG_DEBUG("register %d tasks with label: %s", n, label_buffer);
+    TASK_MANAGER_LOCK();
+    for (int k = 0; k < n; k++) {
+      trace_task_manager_add_task(task_manager, &label_buffer[0], tasks[k]);
+    }
+    TASK_MANAGER_UNLOCK();
+  }
+
+  if (opt.mode == otter_mode_profile) {
+    for (int k = 0; k < n; k++) {
+      trace_profile_task_create(tasks[k]);
+    }
+  } else if (defer_task_events()) {
+    // each task may be coalesced, so defer each task-create event as usual
+    keep_task_events(parent);
+    uint64_t time = trace_graph_get_timestamp();
+    for (int k = 0; k < n; k++) {
+      otterTaskContext_set_task_create_time(tasks[k], time);
+      otterTaskContext_set_create_location_ref(tasks[k], init_ref);
+      defer_task_event(tasks[k], otter_deferred_create, time);
+    }
+  } else {
+    trace_graph_event_task_create_range(
+        get_thread_data()->location,
+        otterTaskContext_get_task_context_id(parent),
+        otterTaskContext_get_task_context_id(tasks[0]), (uint64_t)n, label_ref,
+        label_args.count != 0 ? &label_args : NULL, init_ref,
+        trace_graph_get_timestamp());
+  }
+
+  leave_otter(governor_enter);
+  return;
+}
+
 void otterTaskCreate(otter_task_context *task, otter_task_context *parent,
                      const char *file, const char *func, int line) {
   if (task == NULL) {
@@ -249,21 +644,31 @@ void otterTaskCreate(otter_task_context *task, otter_task_context *parent,
     return;
   }
 
-  // If no parent given, set the current phase (or root) task as the parent.
-  // Only the implicit root task may have a NULL parent.
+  // If no parent given, set the current task as the parent.
   if (parent == NULL) {
-    if (phase_task != NULL) {
-      parent = phase_task;
-    } else if (root_task != NULL) {
-      parent = root_task;
-    } else {
-      parent = NULL;
-    }
+    parent = get_default_parent();
   }
 
+  if (is_profiled(task)) {
+    trace_profile_task_create(task);
+    return;
+  }
+
+  uint64_t governor_enter = trace_governor_enter();
   otter_src_ref_t create_ref = get_source_location_ref(
       (otter_src_location_t){.file = file, .func = func, .line = line});
 
+  if (defer_task_events()) {
+    // the parent is not a leaf, so can't be coalesced
+    keep_task_events(parent);
+    uint64_t time = trace_graph_get_timestamp();
+    otterTaskContext_set_task_create_time(task, time);
+    otterTaskContext_set_create_location_ref(task, create_ref);
+    defer_task_event(task, otter_deferred_create, time);
+    leave_otter(governor_enter);
+    return;
+  }
+
   unique_id_t parent_id = otterTaskContext_get_task_context_id(parent);
   unique_id_t child_id = otterTaskContext_get_task_context_id(task);
   otter_string_ref_t label_ref = otterTaskContext_get_task_label_ref(task);
@@ -271,7 +676,10 @@ void otterTaskCreate(otter_task_context *task, otter_task_context *parent,
   LOG_DEBUG("[%lu] create task (child of %lu)", child_id, parent_id);
 
   trace_graph_event_task_create(get_thread_data()->location, parent_id,
-                                child_id, label_ref, create_ref);
+                                child_id, label_ref,
+                                otterTaskContext_get_task_label_args(task),
+                                create_ref, trace_graph_get_timestamp());
+  leave_otter(governor_enter);
   return;
 }
 
@@ -293,34 +701,219 @@ otter_task_context *otterTaskStart(otter_task_context *task, const char *file,
   task_attr.init = otterTaskContext_get_init_location_ref(task);
   LOG_DEBUG("[%lu] begin task (child of %lu)", task_attr.id,
             task_attr.parent_id);
+  push_current_task(task);
+  if (is_profiled(task)) {
+    trace_profile_task_start(task);
+    return task;
+  }
+  uint64_t governor_enter = trace_governor_enter();
   otter_src_ref_t start_ref = get_source_location_ref(
       (otter_src_location_t){.file = file, .func = func, .line = line});
-  trace_graph_event_task_begin(get_thread_data()->location,
-                               otterTaskContext_get_task_context_id(task),
-                               start_ref);
+  if (defer_task_events()) {
+    uint64_t time = trace_graph_get_timestamp();
+    otterTaskContext_set_task_start_time(task, time);
+    otterTaskContext_set_start_location_ref(task, start_ref);
+    defer_task_event(task, otter_deferred_start, time);
+  } else {
+    trace_graph_event_task_begin(get_thread_data()->location,
+                                 otterTaskContext_get_task_context_id(task),
+                                 start_ref, trace_graph_get_timestamp());
+  }
+  leave_otter(governor_enter);
   return task;
 }
 
 void otterTaskEnd(otter_task_context *task, const char *file, const char *func,
                   int line) {
+  if (task == NULL) {
+    LOG_ERROR("IGNORED (tried to end null task at %s:%d in %s)", file, line,
+              func);
+    return;
+  }
   LOG_DEBUG("[%lu] end task", otterTaskContext_get_task_context_id(task));
+  pop_current_task(task);
+  if (is_profiled(task)) {
+    trace_profile_task_end(task);
+    otterTaskContext_release(task);
+    return;
+  }
+  uint64_t governor_enter = trace_governor_enter();
+  uint64_t end_time = trace_graph_get_timestamp();
+  if (defer_task_events()) {
+    int deferred = otterTaskContext_get_deferred_events(task);
+    uint64_t duration = end_time - otterTaskContext_get_task_start_time(task);
+    // Coalesce a short leaf task, or a leaf task not sampled by the governor,
+    // only if none of its events were recorded. A create time with no deferred
+    // create event means it was recorded. Tasks with metrics are never
+    // coalesced as their metrics are exact. Discarding its deferred events
+    // fails if the thread which deferred its create event has just recorded it.
+    bool create_recorded = !(deferred & otter_deferred_create) &&
+                           otterTaskContext_get_task_create_time(task) != 0;
+    if ((deferred & otter_deferred_start) &&
+        !(deferred & otter_deferred_keep) && !create_recorded &&
+        otterTaskContext_get_num_children(task) == 0 &&
+        otterTaskContext_get_metrics(task) == NULL &&
+        (duration < opt.coalesce_threshold || !trace_governor_sample()) &&
+        otterTaskContext_discard_deferred_events(task, deferred)) {
+      trace_graph_event_task_coalesced(
+          get_thread_data()->location,
+          otterTaskContext_get_parent_task_context_id(task), duration,
+          end_time);
+      otterTaskContext_release(task);
+      leave_otter(governor_enter);
+      return;
+    }
+  }
+  if (defer_task_events()) {
+    // the task was not coalesced, so any events deferred by other threads may
+    // now be recorded
+    keep_task_events(task);
+  }
   otter_src_ref_t end_ref = get_source_location_ref(
       (otter_src_location_t){.file = file, .func = func, .line = line});
+  trace_graph_event_task_metrics(get_thread_data()->location,
+                                 otterTaskContext_get_task_context_id(task),
+                                 otterTaskContext_get_metrics(task), end_time);
   trace_graph_event_task_end(get_thread_data()->location,
                              otterTaskContext_get_task_context_id(task),
-                             end_ref);
-  otterTaskContext_delete(task);
+                             end_ref, end_time);
+  otterTaskContext_release(task);
+  leave_otter(governor_enter);
+}
+
+void otterTaskSuspend(otter_task_context *task, const char *file,
+                      const char *func, int line) {
+  if (task == NULL) {
+    LOG_ERROR("IGNORED (tried to suspend null task at %s:%d in %s)", file, line,
+              func);
+    return;
+  }
+  LOG_DEBUG("[%lu] suspend task", otterTaskContext_get_task_context_id(task));
+  uint64_t time = trace_graph_get_timestamp();
+  if (!otterTaskContext_suspend(task, time)) {
+    LOG_ERROR("IGNORED (tried to suspend suspended task at %s:%d in %s)", file,
+              line, func);
+    return;
+  }
+  pop_current_task(task);
+  if (is_profiled(task)) {
+    return;
+  }
+  uint64_t governor_enter = trace_governor_enter();
+  // a suspended task can't be coalesced
+  if (defer_task_events()) {
+    keep_task_events(task);
+  }
+  otter_src_ref_t suspend_ref = get_source_location_ref(
+      (otter_src_location_t){.file = file, .func = func, .line = line});
+  trace_graph_event_task_suspend(get_thread_data()->location,
+                                 otterTaskContext_get_task_context_id(task),
+                                 suspend_ref, time);
+  leave_otter(governor_enter);
+}
+
+void otterTaskResume(otter_task_context *task, const char *file,
+                     const char *func, int line) {
+  if (task == NULL) {
+    LOG_ERROR("IGNORED (tried to resume null task at %s:%d in %s)", file, line,
+              func);
+    return;
+  }
+  LOG_DEBUG("[%lu] resume task", otterTaskContext_get_task_context_id(task));
+  uint64_t time = trace_graph_get_timestamp();
+  if (!otterTaskContext_resume(task, time)) {
+    LOG_ERROR("IGNORED (tried to resume task which is not suspended at %s:%d "
+              "in %s)",
+              file, line, func);
+    return;
+  }
+  push_current_task(task);
+  if (is_profiled(task)) {
+    return;
+  }
+  uint64_t governor_enter = trace_governor_enter();
+  otter_src_ref_t resume_ref = get_source_location_ref(
+      (otter_src_location_t){.file = file, .func = func, .line = line});
+  trace_graph_event_task_resume(get_thread_data()->location,
+                                otterTaskContext_get_task_context_id(task),
+                                resume_ref, time);
+  leave_otter(governor_enter);
+}
+
+void otterTaskSetProfileOnly(otter_task_context *task) {
+  if (task == NULL) {
+    LOG_ERROR("IGNORED (tried to set null task as profile-only)");
+    return;
+  }
+  otterTaskContext_set_profile_only(task);
+  profile_only_tasks = true;
+}
+
+int otterTaskDefineMetric(const char *name, const char *unit) {
+  uint64_t governor_enter = trace_governor_enter();
+  int metric_id = trace_task_metric_define(name, unit);
+  leave_otter(governor_enter);
+  return metric_id;
+}
+
+void otterTaskAddMetric(otter_task_context *task, int metric_id,
+                        uint64_t value) {
+  if (task == NULL) {
+    LOG_ERROR("IGNORED (tried to add metric %d to null task)", metric_id);
+    return;
+  }
+  if (!trace_task_metric_valid(metric_id)) {
+    LOG_ERROR("IGNORED (tried to add undefined metric %d to task %lu)",
+              metric_id, otterTaskContext_get_task_context_id(task));
+    return;
+  }
+  otterTaskContext_add_metric(task, metric_id, value);
+}
+
+int otterCounterDefine(const char *name, const char *unit) {
+  uint64_t governor_enter = trace_governor_enter();
+  int counter_id = trace_counter_define(name, unit);
+  leave_otter(governor_enter);
+  return counter_id;
+}
+
+void otterCounterSet(int counter_id, int64_t value) {
+  trace_counter_set(get_thread_data()->location, counter_id, value);
+}
+
+void otterCounterAdd(int counter_id, int64_t delta) {
+  trace_counter_add(get_thread_data()->location, counter_id, delta);
+}
+
+otter_task_context *otterTaskCurrent(void) {
+  data_item_t top = {.ptr = NULL};
+  if (current_tasks == NULL) {
+    return NULL;
+  }
+  while (stack_peek(current_tasks, &top)) {
+    otter_task_context *task = (otter_task_context *)top.ptr;
+    if (otterTaskContext_get_current_stack(task) == current_tasks) {
+      return task;
+    }
+    // ended or suspended on another thread, so drop this thread's entry
+    stack_pop(current_tasks, &top);
+    otterTaskContext_release(task);
+  }
+  return NULL;
 }
 
 void otterTaskPushLabel(otter_task_context *task, const char *format, ...) {
+  uint64_t governor_enter = trace_governor_enter();
   va_list args;
   va_start(args, format);
   otter_register_task_label_va_list(task, true, format, args);
   va_end(args);
+  leave_otter(governor_enter);
   return;
 }
 
 otter_task_context *otterTaskPopLabel(const char *format, ...) {
+  uint64_t governor_enter = trace_governor_enter();
   char label_buffer[LABEL_BUFFER_MAX_CHARS] = {0};
   va_list args;
   va_start(args, format);
@@ -336,10 +929,12 @@ otter_task_context *otterTaskPopLabel(const char *format, ...) {
   otter_task_context *task =
       trace_task_manager_pop_task(task_manager, label_buffer);
   TASK_MANAGER_UNLOCK();
+  leave_otter(governor_enter);
   return task;
 }
 
 otter_task_context *otterTaskBorrowLabel(const char *format, ...) {
+  uint64_t governor_enter = trace_governor_enter();
   char label_buffer[LABEL_BUFFER_MAX_CHARS] = {0};
   va_list args;
   va_start(args, format);
@@ -355,6 +950,7 @@ otter_task_context *otterTaskBorrowLabel(const char *format, ...) {
   otter_task_context *task =
       trace_task_manager_borrow_task(task_manager, label_buffer);
   TASK_MANAGER_UNLOCK();
+  leave_otter(governor_enter);
   return task;
 }
 
@@ -370,6 +966,15 @@ void otterSynchroniseTasks(otter_task_context *task, otter_task_sync_t mode,
     }
   }
 
+  if (is_profiled(task)) {
+    return;
+  }
+
+  uint64_t governor_enter = trace_governor_enter();
+  if (defer_task_events()) {
+    keep_task_events(task);
+  }
+
   trace_sync_region_attr_t sync_attr;
   sync_attr.type = otter_sync_region_taskwait;
   sync_attr.sync_descendant_tasks =
@@ -378,6 +983,97 @@ void otterSynchroniseTasks(otter_task_context *task, otter_task_sync_t mode,
   trace_graph_synchronise_tasks(get_thread_data()->location,
                                 otterTaskContext_get_task_context_id(task),
                                 sync_attr, endpoint);
+  leave_otter(governor_enter);
+  return;
+}
+
+void otterTaskDependsOn(otter_task_context *task, otter_task_context *pred) {
+  if (task == NULL || pred == NULL) {
+    LOG_ERROR("IGNORED (tried to add dependence of task %p on task %p)", task,
+              pred);
+    return;
+  }
+
+  if (is_profiled(task) || is_profiled(pred)) {
+    return;
+  }
+
+  uint64_t governor_enter = trace_governor_enter();
+  if (defer_task_events()) {
+    // tasks in the dependency graph must be recorded, so can't be coalesced
+    keep_task_events(pred);
+    keep_task_events(task);
+  }
+  trace_graph_event_task_dependence(get_thread_data()->location,
+                                    otterTaskContext_get_task_context_id(pred),
+                                    otterTaskContext_get_task_context_id(task));
+  leave_otter(governor_enter);
+  return;
+}
+
+uint64_t otterTaskGetId(otter_task_context *task) {
+  if (task == NULL) {
+    LOG_ERROR("IGNORED (tried to get ID of null task)");
+    return UINT64_MAX;
+  }
+
+  if (!is_profiled(task) && defer_task_events()) {
+    // a later task may depend on this one after it ends, so it must be recorded
+    keep_task_events(task);
+  }
+  return otterTaskContext_get_task_context_id(task);
+}
+
+void otterTaskDependsOnId(otter_task_context *task, uint64_t pred_id) {
+  if (task == NULL || pred_id == UINT64_MAX) {
+    LOG_ERROR("IGNORED (tried to add dependence of task %p on task %lu)", task,
+              pred_id);
+    return;
+  }
+
+  if (is_profiled(task)) {
+    return;
+  }
+
+  uint64_t governor_enter = trace_governor_enter();
+  if (defer_task_events()) {
+    keep_task_events(task);
+  }
+  trace_graph_event_task_dependence(get_thread_data()->location, pred_id,
+                                    otterTaskContext_get_task_context_id(task));
+  leave_otter(governor_enter);
+  return;
+}
+
+void otterTaskAccess(otter_task_context *task, const void *ptr, size_t bytes,
+                     otter_task_access_t mode) {
+  if (task == NULL) {
+    LOG_ERROR("IGNORED (tried to annotate access to %p by null task)", ptr);
+    return;
+  }
+
+  if (is_profiled(task)) {
+    return;
+  }
+
+  uint64_t governor_enter = trace_governor_enter();
+  if (defer_task_events()) {
+    // a later task may depend on this one, so it can't be coalesced
+    keep_task_events(task);
+  }
+  unique_id_t task_id = otterTaskContext_get_task_context_id(task);
+  LOG_DEBUG("[%lu] access %p (%zu bytes, mode %d)", task_id, ptr, bytes, mode);
+  pthread_mutex_lock(&access_map_mutex);
+  if (mode & otter_access_in) {
+    interval_map_access(access_map, (uintptr_t)ptr, bytes, task_id, false,
+                        record_task_dependence, NULL);
+  }
+  if (mode & otter_access_out) {
+    interval_map_access(access_map, (uintptr_t)ptr, bytes, task_id, true,
+                        record_task_dependence, NULL);
+  }
+  pthread_mutex_unlock(&access_map_mutex);
+  leave_otter(governor_enter);
   return;
 }
 
@@ -470,6 +1166,15 @@ otter_task_context *otterTaskInitialise_f(otter_task_context *parent,
                              format);
 }
 
+void otterTaskInitialiseRange_f(otter_task_context *parent, int n,
+                                otter_task_context **tasks, int flavour,
+                                otter_add_to_pool_t add_to_pool,
+                                const char *file, const char *func, int line,
+                                const char *format) {
+  otterTaskInitialiseRange(parent, n, tasks, flavour, add_to_pool, file, func,
+                           line, "%s", format);
+}
+
 void otterTaskPushLabel_f(otter_task_context *task, const char *format) {
   otterTaskPushLabel(task, format);
 }
@@ -1,12 +1,24 @@
 #include "public/otter-trace/source-location.h"
+#include "public/otter-trace/trace-self-profile.h"
+#include "trace-archive-impl.h"
 #include "trace-state.h"
 
 otter_src_ref_t get_source_location_ref(otter_src_location_t location) {
+  uint64_t self_profile_begin = trace_self_profile_begin();
+  bool new_file = false;
+  bool new_func = false;
   pthread_mutex_lock(&state.strings.lock);
-  uint32_t file_ref =
-      string_registry_insert(state.strings.instance, location.file);
-  uint32_t func_ref =
-      string_registry_insert(state.strings.instance, location.func);
+  uint32_t file_ref = string_registry_try_insert(state.strings.instance,
+                                                 location.file, &new_file);
+  uint32_t func_ref = string_registry_try_insert(state.strings.instance,
+                                                 location.func, &new_func);
   pthread_mutex_unlock(&state.strings.lock);
+  if (new_file) {
+    trace_archive_define_string(file_ref, location.file);
+  }
+  if (new_func) {
+    trace_archive_define_string(func_ref, location.func);
+  }
+  trace_self_profile_end(trace_self_source_location_ref, self_profile_begin);
   return (otter_src_ref_t){file_ref, func_ref, location.line};
 }
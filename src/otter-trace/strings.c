@@ -1,10 +1,19 @@
 #include "public/otter-trace/strings.h"
+#include "public/otter-trace/trace-self-profile.h"
+#include "trace-archive-impl.h"
 #include "trace-state.h"
 
 otter_string_ref_t get_string_ref(const char *string) {
+  uint64_t self_profile_begin = trace_self_profile_begin();
   otter_string_ref_t string_ref = OTTER_STRING_UNDEFINED;
+  bool inserted = false;
   pthread_mutex_lock(&state.strings.lock);
-  string_ref = string_registry_insert(state.strings.instance, string);
+  string_ref =
+      string_registry_try_insert(state.strings.instance, string, &inserted);
   pthread_mutex_unlock(&state.strings.lock);
+  if (inserted) {
+    trace_archive_define_string(string_ref, string);
+  }
+  trace_self_profile_end(trace_self_string_ref, self_profile_begin);
   return string_ref;
 }
@@ -16,4 +16,9 @@
 void trace_archive_write_string_ref(OTF2_GlobalDefWriter *def_writer,
                                     OTF2_StringRef ref, const char *s);
 
+/* Write the definition of a newly-interned string with the global definitions
+   writer, taking its lock. Strings are defined as they are interned so that
+   the string registry need not keep every string until finalisation */
+void trace_archive_define_string(OTF2_StringRef ref, const char *s);
+
 #endif // OTTER_TRACE_ARCHIVE_IMPL_H
@@ -16,12 +16,17 @@
 
 #include "public/debug.h"
 #include "public/otter-common.h"
+#include "public/otter-trace/trace-memory.h"
 #include "public/otter-trace/trace-ompt.h"
+#include "public/otter-trace/trace-self-profile.h"
 #include "public/otter-version.h"
+#include "public/threads.h"
+#include "public/types/memory-accounting.h"
 
 #include "trace-archive-impl.h"
 #include "trace-attributes.h"
 #include "trace-check-error-code.h"
+#include "trace-state.h"
 #include "trace-static-constants.h"
 #include "trace-timestamp.h"
 #include "trace-unique-refs.h"
@@ -30,21 +35,69 @@
 OTF2_StringRef attr_name_ref[n_attr_defined][2] = {0};
 OTF2_StringRef attr_label_ref[n_attr_label_defined] = {0};
 
+/* Start of the flush in progress on this thread, for self-profiling */
+static thread_local uint64_t flush_begin = 0;
+
 /* Pre- and post-flush callbacks required by OTF2 */
 static OTF2_FlushType pre_flush(void *userData, OTF2_FileType fileType,
                                 OTF2_LocationRef location, void *callerData,
                                 bool final) {
+  flush_begin = trace_self_profile_begin();
   return OTF2_FLUSH;
 }
 
 static OTF2_TimeStamp post_flush(void *userData, OTF2_FileType fileType,
                                  OTF2_LocationRef location) {
+  trace_self_profile_end(trace_self_flush, flush_begin);
+  flush_begin = 0;
   return get_timestamp();
 }
 
+/* Chunks allocated for one OTF2 buffer, which are always freed together */
+typedef struct otf2_chunk_t {
+  struct otf2_chunk_t *next;
+  uint64_t size;
+  void *memory;
+} otf2_chunk_t;
+
+/* Memory callbacks which let Otter account for the memory held by OTF2 */
+static void *allocate_chunk(void *userData, OTF2_FileType fileType,
+                            OTF2_LocationRef location, void **perBufferData,
+                            uint64_t chunkSize) {
+  otf2_chunk_t *chunk = malloc(sizeof(*chunk));
+  if (chunk == NULL) {
+    return NULL;
+  }
+  chunk->memory = malloc(chunkSize);
+  if (chunk->memory == NULL) {
+    free(chunk);
+    return NULL;
+  }
+  chunk->size = chunkSize;
+  chunk->next = *perBufferData;
+  *perBufferData = chunk;
+  otter_mem_alloc(otter_mem_otf2_chunks, chunkSize);
+  return chunk->memory;
+}
+
+static void free_all_chunks(void *userData, OTF2_FileType fileType,
+                            OTF2_LocationRef location, void **perBufferData,
+                            bool final) {
+  otf2_chunk_t *chunk = *perBufferData;
+  while (chunk != NULL) {
+    otf2_chunk_t *next = chunk->next;
+    otter_mem_free(otter_mem_otf2_chunks, chunk->size);
+    free(chunk->memory);
+    free(chunk);
+    chunk = next;
+  }
+  *perBufferData = NULL;
+}
+
 bool trace_initialise_archive(const char *archive_path,
                               const char *archive_name,
                               otter_event_model_t event_model,
+                              otter_mode_t mode,
                               OTF2_Archive **archive,
                               OTF2_GlobalDefWriter **global_def_writer) {
   OTF2_ErrorCode ret = OTF2_SUCCESS;
@@ -63,6 +116,11 @@ bool trace_initialise_archive(const char *archive_path,
                                          .otf2_post_flush = post_flush};
   OTF2_Archive_SetFlushCallbacks(_archive, &on_flush, NULL);
 
+  /* set memory callbacks */
+  static OTF2_MemoryCallbacks on_memory = {.otf2_allocate = allocate_chunk,
+                                           .otf2_free_all = free_all_chunks};
+  OTF2_Archive_SetMemoryCallbacks(_archive, &on_memory, NULL);
+
   /* set serial (not MPI) collective callbacks */
   OTF2_Archive_SetSerialCollectiveCallbacks(_archive);
 
@@ -109,6 +167,12 @@ bool trace_initialise_archive(const char *archive_path,
                                  event_model_name, true);
   CHECK_OTF2_ERROR_CODE(ret);
 
+  /* record whether this archive holds a full trace or only a profile */
+  ret = OTF2_Archive_SetProperty(
+      _archive, "OTTER::MODE",
+      mode == otter_mode_profile ? "PROFILE" : "TRACE", true);
+  CHECK_OTF2_ERROR_CODE(ret);
+
   /* get clock resolution & current time for CLOCK_MONOTONIC */
   struct timespec res, tp;
   if (clock_getres(CLOCK_MONOTONIC, &res) != 0) {
@@ -209,6 +273,11 @@ bool trace_finalise_archive(OTF2_Archive *archive) {
   /* close local definition files */
   OTF2_Archive_CloseDefFiles(archive);
 
+  /* record self-profiling counters and memory usage while archive properties
+     can be set */
+  trace_self_profile_finalise();
+  trace_memory_finalise();
+
   /* close OTF2 archive */
   OTF2_Archive_Close(archive);
 
@@ -230,6 +299,14 @@ void trace_archive_write_string_ref(OTF2_GlobalDefWriter *def_writer,
   }
   LOG_DEBUG("writing ref %u for string \"%s\"", ref, s);
   OTF2_ErrorCode r = OTF2_SUCCESS;
+  uint64_t self_profile_begin = trace_self_profile_begin();
   r = OTF2_GlobalDefWriter_WriteString(def_writer, ref, s);
+  trace_self_profile_end(trace_self_def_write, self_profile_begin);
   CHECK_OTF2_ERROR_CODE(r);
 }
+
+void trace_archive_define_string(OTF2_StringRef ref, const char *s) {
+  pthread_mutex_lock(&state.global_def_writer.lock);
+  trace_archive_write_string_ref(state.global_def_writer.instance, ref, s);
+  pthread_mutex_unlock(&state.global_def_writer.lock);
+}
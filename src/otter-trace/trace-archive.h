@@ -20,6 +20,7 @@
 bool trace_initialise_archive(const char *archive_path,
                               const char *archive_name,
                               otter_event_model_t event_model,
+                              otter_mode_t mode,
                               OTF2_Archive **archive,
                               OTF2_GlobalDefWriter **global_def_writer);
 bool trace_finalise_archive(OTF2_Archive *archive);
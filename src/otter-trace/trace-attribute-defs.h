@@ -94,8 +94,19 @@ INCLUDE_LABEL(event_type, master_begin)
 INCLUDE_LABEL(event_type, master_end)
 INCLUDE_LABEL(event_type, phase_begin)
 INCLUDE_LABEL(event_type, phase_end)
+INCLUDE_LABEL(event_type, task_coalesced)
+INCLUDE_LABEL(event_type, sampling_stride)
+INCLUDE_LABEL(event_type, task_compact)
+INCLUDE_LABEL(event_type, sync_wait_begin)
+INCLUDE_LABEL(event_type, sync_wait_end)
+INCLUDE_LABEL(event_type, mutex_released)
+INCLUDE_LABEL(event_type, mutex_acquired)
+INCLUDE_LABEL(event_type, task_create_range)
+INCLUDE_LABEL(event_type, task_suspend)
+INCLUDE_LABEL(event_type, task_resume)
+INCLUDE_LABEL(event_type, task_metrics)
 
-/* Result of call to sched_getcpu() */
+/* CPU of the recording thread, see trace-cpu.h */
 INCLUDE_ATTRIBUTE(OTF2_TYPE_INT32, cpu,
                   "cpu on which the encountering thread is running")
 
@@ -156,6 +167,10 @@ INCLUDE_LABEL(region_type, barrier_explicit)
 INCLUDE_LABEL(region_type, barrier_implementation)
 INCLUDE_LABEL(region_type, taskwait)
 INCLUDE_LABEL(region_type, taskgroup)
+INCLUDE_LABEL(region_type, reduction)
+INCLUDE_LABEL(region_type, barrier_implicit_workshare)
+INCLUDE_LABEL(region_type, barrier_implicit_parallel)
+INCLUDE_LABEL(region_type, barrier_teams)
 /* phase region sub-types */
 INCLUDE_LABEL(region_type, generic_phase)
 
@@ -203,6 +218,18 @@ INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, task_init_func,
 INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, task_label,
                   "the user-supplied label for a task")
 
+/* arguments of a structured task label, whose task_label is the template */
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT8, task_label_arg_count,
+                  "the number of arguments of a structured task label")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, task_label_arg_0,
+                  "the raw value of the first argument of a task label")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, task_label_arg_1,
+                  "the raw value of the second argument of a task label")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, task_label_arg_2,
+                  "the raw value of the third argument of a task label")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, task_label_arg_3,
+                  "the raw value of the fourth argument of a task label")
+
 /* phase name */
 INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, phase_name,
                   "the name of an algorithmic phase")
@@ -218,5 +245,43 @@ INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, caller_return_address,
 /* task flavour */
 INCLUDE_ATTRIBUTE(OTF2_TYPE_INT32, task_flavour, "the flavour of a task")
 
+/* runs of short leaf tasks recorded as a single event */
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, coalesced_task_count,
+                  "the number of short leaf tasks coalesced into this event")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, coalesced_task_time,
+                  "the total execution time of the tasks coalesced into this "
+                  "event")
+
+/* undeferred and merged tasks recorded as a single event at task-complete */
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, task_create_time,
+                  "the time at which a compact task was created")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, task_start_time,
+                  "the time at which a compact task started")
+
+/* time a thread spent waiting in a sync region, see trace-sync-wait.h */
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, sync_wait_time,
+                  "the time spent waiting in a sync region, excluding time "
+                  "spent executing tasks")
+
+/* mutexes held for or waited on longer than a threshold, see trace-mutex.h */
+INCLUDE_ATTRIBUTE(OTF2_TYPE_STRING, mutex_kind,
+                  "the kind of lock, critical section, atomic or ordered region")
+INCLUDE_LABEL(mutex_kind, lock)
+INCLUDE_LABEL(mutex_kind, test_lock)
+INCLUDE_LABEL(mutex_kind, nest_lock)
+INCLUDE_LABEL(mutex_kind, test_nest_lock)
+INCLUDE_LABEL(mutex_kind, critical)
+INCLUDE_LABEL(mutex_kind, atomic)
+INCLUDE_LABEL(mutex_kind, ordered)
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, mutex_wait_time,
+                  "the time spent waiting to acquire a mutex")
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, mutex_hold_time,
+                  "the time for which a mutex was held")
+
+/* sibling tasks created together, see otterTaskInitialiseRange */
+INCLUDE_ATTRIBUTE(OTF2_TYPE_UINT64, task_range_count,
+                  "the number of tasks created, with consecutive IDs from "
+                  "unique_id")
+
 #undef INCLUDE_LABEL
 #undef INCLUDE_ATTRIBUTE
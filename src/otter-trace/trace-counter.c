@@ -0,0 +1,274 @@
+/**
+ * @file trace-counter.c
+ * @brief Implementation of user-defined counters. Each thread keeps its own
+ * value of each counter and a mask of the counters changed since its last
+ * sample, so updating a counter takes no locks and samples are written by the
+ * updating thread on its own location. Each counter has its own metric class,
+ * so a sample writes one metric event per counter.
+ * @version 0.1
+ * @date 2023-05-24
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <inttypes.h>
+#include <otf2/otf2.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "public/debug.h"
+#include "public/otter-trace/trace-counter.h"
+#include "public/otter-trace/trace-self-profile.h"
+#include "public/otter-trace/trace-task-graph.h"
+#include "public/threads.h"
+#include "public/types/queue.h"
+
+#include "trace-archive-impl.h"
+#include "trace-check-error-code.h"
+#include "trace-state.h"
+#include "trace-timestamp.h"
+#include "trace-unique-refs.h"
+
+enum { counter_name_sz = 64 };
+
+typedef struct counter_def_t {
+  char name[counter_name_sz];
+  OTF2_MetricRef metric_class;
+} counter_def_t;
+
+typedef struct counter_thread_t {
+  trace_location_def_t *location;
+  uint32_t used;        // counters updated by this thread
+  uint32_t changed;     // counters changed since this thread's last sample
+  uint64_t next_sample; // earliest time of this thread's next sample
+  int64_t values[OTTER_MAX_COUNTERS];
+} counter_thread_t;
+
+static struct {
+  pthread_mutex_t lock;
+  int count;
+  counter_def_t defs[OTTER_MAX_COUNTERS];
+} counters = {.lock = PTHREAD_MUTEX_INITIALIZER, .count = 0};
+
+static bool enabled = true; // false in profile mode, which records no events
+static otter_counter_mode_t mode = otter_counter_change;
+static uint64_t sample_interval = 0; // ns
+
+// per-thread counter values
+static thread_local counter_thread_t *thread_counters = NULL;
+
+// store per-thread values for flushing at finalisation
+static struct {
+  otter_queue_t *instance;
+  pthread_mutex_t lock;
+} thread_queue = {.instance = NULL, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+void trace_counter_configure(const otter_opt_t *opt) {
+  enabled = opt->mode != otter_mode_profile;
+  mode = opt->counter_mode;
+  sample_interval = opt->counter_interval_us * 1000;
+
+  if (!enabled || opt->event_model != otter_event_model_task_graph) {
+    return;
+  }
+  char interval[32] = {0};
+  snprintf(interval, sizeof(interval), "%" PRIu64, sample_interval);
+  OTF2_ErrorCode err = OTF2_Archive_SetProperty(
+      state.archive.instance, "OTTER::COUNTER_MODE",
+      mode == otter_counter_periodic ? "periodic" : "change", true);
+  CHECK_OTF2_ERROR_CODE(err);
+  err = OTF2_Archive_SetProperty(state.archive.instance,
+                                 "OTTER::COUNTER_INTERVAL_NS", interval, true);
+  CHECK_OTF2_ERROR_CODE(err);
+}
+
+int trace_counter_define(const char *name, const char *unit) {
+  if (name == NULL) {
+    LOG_ERROR("counter name must not be null");
+    return -1;
+  }
+  pthread_mutex_lock(&counters.lock);
+  for (int id = 0; id < counters.count; id++) {
+    if (strncmp(counters.defs[id].name, name, counter_name_sz - 1) == 0) {
+      pthread_mutex_unlock(&counters.lock);
+      return id;
+    }
+  }
+  if (counters.count == OTTER_MAX_COUNTERS) {
+    pthread_mutex_unlock(&counters.lock);
+    LOG_ERROR("can't define counter \"%s\": at most %d counters may be "
+              "defined",
+              name, OTTER_MAX_COUNTERS);
+    return -1;
+  }
+  int id = counters.count;
+  counter_def_t *def = &counters.defs[id];
+  snprintf(def->name, counter_name_sz, "%s", name);
+
+  char member_name[counter_name_sz + 32] = {0};
+  snprintf(member_name, sizeof(member_name), "OTTER::COUNTER::%s", def->name);
+
+  OTF2_ErrorCode err = OTF2_SUCCESS;
+  pthread_mutex_lock(&state.global_def_writer.lock);
+  OTF2_GlobalDefWriter *writer = state.global_def_writer.instance;
+  OTF2_StringRef name_ref = get_unique_str_ref();
+  trace_archive_write_string_ref(writer, name_ref, member_name);
+  OTF2_StringRef unit_ref = get_unique_str_ref();
+  trace_archive_write_string_ref(writer, unit_ref, unit == NULL ? "" : unit);
+  OTF2_MetricMemberRef member = get_unique_metric_member_ref();
+  err = OTF2_GlobalDefWriter_WriteMetricMember(
+      writer, member, name_ref, name_ref, OTF2_METRIC_TYPE_USER,
+      OTF2_METRIC_ABSOLUTE_POINT, OTF2_TYPE_INT64, OTF2_BASE_DECIMAL, 0,
+      unit_ref);
+  CHECK_OTF2_ERROR_CODE(err);
+  def->metric_class = get_unique_metric_ref();
+  err = OTF2_GlobalDefWriter_WriteMetricClass(writer, def->metric_class, 1,
+                                              &member, OTF2_METRIC_ASYNCHRONOUS,
+                                              OTF2_RECORDER_KIND_ABSTRACT);
+  CHECK_OTF2_ERROR_CODE(err);
+  pthread_mutex_unlock(&state.global_def_writer.lock);
+
+  // publish the definition only once its metric class is written
+  __atomic_store_n(&counters.count, id + 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&counters.lock);
+  LOG_DEBUG("defined counter %d: %s", id, def->name);
+  return id;
+}
+
+static inline bool counter_valid(int counter_id) {
+  return counter_id >= 0 &&
+         counter_id < __atomic_load_n(&counters.count, __ATOMIC_ACQUIRE);
+}
+
+static counter_thread_t *get_thread_counters(trace_location_def_t *location) {
+  if (thread_counters == NULL) {
+    thread_counters = calloc(1, sizeof(*thread_counters));
+    if (thread_counters == NULL) {
+      LOG_ERROR("failed to allocate counter values");
+      return NULL;
+    }
+    pthread_mutex_lock(&thread_queue.lock);
+    if (thread_queue.instance == NULL) {
+      thread_queue.instance = queue_create();
+    }
+    queue_push(thread_queue.instance, (data_item_t){.ptr = thread_counters});
+    pthread_mutex_unlock(&thread_queue.lock);
+  }
+  thread_counters->location = location;
+  return thread_counters;
+}
+
+/* Write one metric event for each counter in `which` */
+static void write_counters(counter_thread_t *thread, uint32_t which,
+                           uint64_t time) {
+  OTF2_ErrorCode err = OTF2_SUCCESS;
+  OTF2_EvtWriter *event_writer = NULL;
+  OTF2_Type type = OTF2_TYPE_INT64;
+  OTF2_MetricValue value;
+
+  trace_location_get_otf2(thread->location, NULL, &event_writer, NULL);
+
+  for (int id = 0; id < OTTER_MAX_COUNTERS; id++) {
+    if (!(which & (1u << id)))
+      continue;
+    value.signed_int = thread->values[id];
+    uint64_t self_profile_begin = trace_self_profile_begin();
+    err = OTF2_EvtWriter_Metric(event_writer, NULL, time,
+                                counters.defs[id].metric_class, 1, &type,
+                                &value);
+    trace_self_profile_end(trace_self_event_write, self_profile_begin);
+    CHECK_OTF2_ERROR_CODE(err);
+    trace_location_inc_event_count(thread->location);
+  }
+}
+
+void trace_counter_sample(trace_location_def_t *location) {
+  counter_thread_t *thread = thread_counters;
+  if (thread == NULL) {
+    return;
+  }
+  uint32_t which = mode == otter_counter_periodic ? thread->used
+                                                   : thread->changed;
+  if (which == 0) {
+    return;
+  }
+  uint64_t now = get_timestamp();
+  if (now < thread->next_sample) {
+    return;
+  }
+  thread->next_sample = now + sample_interval;
+  thread->location = location;
+  // events this thread deferred happened earlier, so must be written first
+  trace_graph_flush_pending_events();
+  write_counters(thread, which, now);
+  thread->changed = 0;
+}
+
+void trace_counter_set(trace_location_def_t *location, int counter_id,
+                       int64_t value) {
+  if (!enabled) {
+    return;
+  }
+  if (!counter_valid(counter_id)) {
+    LOG_ERROR("IGNORED (tried to set undefined counter %d)", counter_id);
+    return;
+  }
+  counter_thread_t *thread = get_thread_counters(location);
+  if (thread == NULL) {
+    return;
+  }
+  uint32_t bit = 1u << counter_id;
+  if (!(thread->used & bit) || thread->values[counter_id] != value) {
+    thread->values[counter_id] = value;
+    thread->changed |= bit;
+  }
+  thread->used |= bit;
+  trace_counter_sample(location);
+}
+
+void trace_counter_add(trace_location_def_t *location, int counter_id,
+                       int64_t delta) {
+  if (!enabled) {
+    return;
+  }
+  if (!counter_valid(counter_id)) {
+    LOG_ERROR("IGNORED (tried to add to undefined counter %d)", counter_id);
+    return;
+  }
+  counter_thread_t *thread = get_thread_counters(location);
+  if (thread == NULL) {
+    return;
+  }
+  uint32_t bit = 1u << counter_id;
+  if (!(thread->used & bit) || delta != 0) {
+    thread->values[counter_id] += delta;
+    thread->changed |= bit;
+  }
+  thread->used |= bit;
+  trace_counter_sample(location);
+}
+
+void trace_counter_finalise(void) {
+  LOG_DEBUG("=== Finalising counters ===");
+
+  // record the latest value of any counter changed since its last sample
+  pthread_mutex_lock(&thread_queue.lock);
+  if (thread_queue.instance == NULL) {
+    pthread_mutex_unlock(&thread_queue.lock);
+    return;
+  }
+  counter_thread_t *thread = NULL;
+  while (queue_pop(thread_queue.instance, (data_item_t *)&thread)) {
+    if (thread->changed != 0) {
+      write_counters(thread, thread->changed, get_timestamp());
+    }
+    free(thread);
+  }
+  queue_destroy(thread_queue.instance, false, NULL);
+  thread_queue.instance = NULL;
+  pthread_mutex_unlock(&thread_queue.lock);
+  thread_counters = NULL;
+}
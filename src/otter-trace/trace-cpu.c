@@ -0,0 +1,86 @@
+/**
+ * @file trace-cpu.c
+ * @brief Implementation of CPU tracking for the `cpu` event attribute. The
+ * kernel keeps the cpu_id field of each thread's rseq area up to date, so
+ * reading it costs a single load. glibc 2.35 and later register the area
+ * for every thread and export its offset from the thread pointer.
+ * @version 0.1
+ * @date 2023-05-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <otf2/otf2.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#if defined(__GLIBC__) &&                                                      \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 35)) &&            \
+    defined(__has_include)
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#define OTTER_HAVE_RSEQ 1
+#endif
+#endif
+
+#include "public/debug.h"
+#include "public/otter-trace/trace-cpu.h"
+#include "public/threads.h"
+
+#include "trace-check-error-code.h"
+#include "trace-state.h"
+
+static bool use_rseq = false;
+static uint64_t sample_events = 1;
+
+/* The CPU last read by this thread, and the events until it is read again */
+static thread_local int32_t thread_cpu = -1;
+static thread_local uint64_t thread_countdown = 0;
+
+void trace_cpu_configure(const otter_opt_t *opt) {
+#if defined(OTTER_HAVE_RSEQ)
+  /* __rseq_size is 0 if rseq registration is disabled or unsupported */
+  use_rseq = __rseq_size > 0;
+#endif
+  sample_events = opt->cpu_sample_events > 0 ? opt->cpu_sample_events : 1;
+
+  LOG_DEBUG("reading cpu from %s", use_rseq ? "rseq" : "sched_getcpu");
+
+  char value[32] = {0};
+  OTF2_ErrorCode err =
+      OTF2_Archive_SetProperty(state.archive.instance, "OTTER::CPU_SOURCE",
+                               use_rseq ? "rseq" : "sched_getcpu", true);
+  CHECK_OTF2_ERROR_CODE(err);
+  if (!use_rseq) {
+    snprintf(value, sizeof(value), "%" PRIu64, sample_events);
+    err = OTF2_Archive_SetProperty(state.archive.instance,
+                                   "OTTER::CPU_SAMPLE_EVENTS", value, true);
+    CHECK_OTF2_ERROR_CODE(err);
+  }
+}
+
+int32_t trace_cpu_current(void) {
+#if defined(OTTER_HAVE_RSEQ)
+  if (use_rseq) {
+    const struct rseq *area =
+        (const struct rseq *)((char *)__builtin_thread_pointer() +
+                              __rseq_offset);
+    int32_t cpu = (int32_t)__atomic_load_n(&area->cpu_id, __ATOMIC_RELAXED);
+    if (cpu >= 0) {
+      return cpu;
+    }
+    /* this thread's area is not registered, fall back to sched_getcpu */
+  }
+#endif
+  if (thread_countdown == 0) {
+    thread_cpu = sched_getcpu();
+    thread_countdown = sample_events;
+  }
+  thread_countdown--;
+  return thread_cpu;
+}
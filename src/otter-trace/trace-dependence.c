@@ -0,0 +1,138 @@
+/**
+ * @file trace-dependence.c
+ * @brief Implementation of dependence recording. Edges and declared
+ * dependences are written as metric events of two metric classes, so each
+ * record is a handful of integers with no attribute list.
+ * @version 0.1
+ * @date 2023-05-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <otf2/otf2.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "public/debug.h"
+#include "public/otter-trace/trace-dependence.h"
+#include "public/otter-trace/trace-self-profile.h"
+
+#include "trace-archive-impl.h"
+#include "trace-check-error-code.h"
+#include "trace-state.h"
+#include "trace-timestamp.h"
+#include "trace-unique-refs.h"
+
+/* Members of the metric recorded for each edge */
+enum { edge_pred, edge_succ, edge_n_members };
+
+/* Members of the metric recorded for each declared dependence. The address is
+   only recorded when requested */
+enum { declare_task, declare_type, declare_address, declare_n_members };
+
+static bool record_addresses = false;
+static OTF2_MetricRef edge_metric = OTF2_UNDEFINED_METRIC;
+static OTF2_MetricRef declare_metric = OTF2_UNDEFINED_METRIC;
+
+static OTF2_MetricMemberRef write_metric_member(OTF2_GlobalDefWriter *writer,
+                                                const char *name,
+                                                OTF2_StringRef unit) {
+  OTF2_StringRef name_ref = get_unique_str_ref();
+  trace_archive_write_string_ref(writer, name_ref, name);
+  OTF2_MetricMemberRef member = get_unique_metric_member_ref();
+  OTF2_ErrorCode err = OTF2_GlobalDefWriter_WriteMetricMember(
+      writer, member, name_ref, name_ref, OTF2_METRIC_TYPE_OTHER,
+      OTF2_METRIC_ABSOLUTE_POINT, OTF2_TYPE_UINT64, OTF2_BASE_DECIMAL, 0,
+      unit);
+  CHECK_OTF2_ERROR_CODE(err);
+  return member;
+}
+
+static OTF2_MetricRef write_metric_class(OTF2_GlobalDefWriter *writer,
+                                         uint8_t n_members,
+                                         const OTF2_MetricMemberRef *members) {
+  OTF2_MetricRef metric = get_unique_metric_ref();
+  OTF2_ErrorCode err = OTF2_GlobalDefWriter_WriteMetricClass(
+      writer, metric, n_members, members, OTF2_METRIC_ASYNCHRONOUS,
+      OTF2_RECORDER_KIND_ABSTRACT);
+  CHECK_OTF2_ERROR_CODE(err);
+  return metric;
+}
+
+void trace_dependence_configure(const otter_opt_t *opt) {
+  if (opt->event_model == otter_event_model_omp &&
+      !(opt->ompt_categories & otter_ompt_category_dependences)) {
+    return;
+  }
+  record_addresses = opt->dependence_addresses;
+
+  OTF2_MetricMemberRef members[declare_n_members];
+
+  pthread_mutex_lock(&state.global_def_writer.lock);
+  OTF2_GlobalDefWriter *writer = state.global_def_writer.instance;
+  OTF2_StringRef task = get_unique_str_ref();
+  trace_archive_write_string_ref(writer, task, "task");
+  OTF2_StringRef none = get_unique_str_ref();
+  trace_archive_write_string_ref(writer, none, "");
+
+  members[edge_pred] =
+      write_metric_member(writer, "OTTER::DEPENDENCE::PRED", task);
+  members[edge_succ] =
+      write_metric_member(writer, "OTTER::DEPENDENCE::SUCC", task);
+  edge_metric = write_metric_class(writer, edge_n_members, members);
+
+  members[declare_task] =
+      write_metric_member(writer, "OTTER::DEPENDENCE::TASK", task);
+  members[declare_type] =
+      write_metric_member(writer, "OTTER::DEPENDENCE::TYPE", none);
+  if (record_addresses) {
+    members[declare_address] =
+        write_metric_member(writer, "OTTER::DEPENDENCE::ADDRESS", none);
+  }
+  declare_metric = write_metric_class(
+      writer, record_addresses ? declare_n_members : declare_address, members);
+  pthread_mutex_unlock(&state.global_def_writer.lock);
+
+  OTF2_ErrorCode err = OTF2_Archive_SetProperty(
+      state.archive.instance, "OTTER::DEPENDENCE_ADDRESSES",
+      record_addresses ? "true" : "false", true);
+  CHECK_OTF2_ERROR_CODE(err);
+}
+
+static void write_metric(trace_location_def_t *location, OTF2_MetricRef metric,
+                         uint8_t n_values, const OTF2_MetricValue *values) {
+  OTF2_EvtWriter *event_writer = NULL;
+  OTF2_Type types[declare_n_members] = {OTF2_TYPE_UINT64, OTF2_TYPE_UINT64,
+                                        OTF2_TYPE_UINT64};
+
+  trace_location_get_otf2(location, NULL, &event_writer, NULL);
+
+  uint64_t self_profile_begin = trace_self_profile_begin();
+  OTF2_ErrorCode err = OTF2_EvtWriter_Metric(
+      event_writer, NULL, get_timestamp(), metric, n_values, types, values);
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
+  CHECK_OTF2_ERROR_CODE(err);
+  trace_location_inc_event_count(location);
+}
+
+void trace_dependence_declare(trace_location_def_t *location,
+                              unique_id_t task_id, otter_dependence_t type,
+                              const void *address) {
+  OTF2_MetricValue values[declare_n_members];
+  values[declare_task].unsigned_int = task_id;
+  values[declare_type].unsigned_int = type;
+  values[declare_address].unsigned_int = (uint64_t)(uintptr_t)address;
+  write_metric(location, declare_metric,
+               record_addresses ? declare_n_members : declare_address, values);
+}
+
+void trace_dependence_edge(trace_location_def_t *location, unique_id_t pred_id,
+                           unique_id_t succ_id) {
+  LOG_DEBUG("dependence %lu -> %lu", pred_id, succ_id);
+  OTF2_MetricValue values[edge_n_members];
+  values[edge_pred].unsigned_int = pred_id;
+  values[edge_succ].unsigned_int = succ_id;
+  write_metric(location, edge_metric, edge_n_members, values);
+}
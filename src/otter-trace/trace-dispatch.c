@@ -0,0 +1,206 @@
+/**
+ * @file trace-dispatch.c
+ * @brief Implementation of dispatch recording. The dispatch callback only marks
+ * the start of each chunk, so each thread keeps its open chunk and ends it when
+ * the next chunk is dispatched to it or the workshare ends. Histograms have one
+ * bucket per power of 2 of the iterations in a chunk.
+ * @version 0.1
+ * @date 2023-05-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <inttypes.h>
+#include <otf2/otf2.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "public/debug.h"
+#include "public/otter-trace/trace-dispatch.h"
+#include "public/otter-trace/trace-self-profile.h"
+#include "public/threads.h"
+
+#include "trace-archive-impl.h"
+#include "trace-check-error-code.h"
+#include "trace-state.h"
+#include "trace-timestamp.h"
+#include "trace-unique-refs.h"
+
+/* Bucket k counts chunks of [2^k, 2^(k+1)) iterations, the last is unbounded */
+enum { dispatch_n_buckets = 16 };
+
+/* Members of the metric recorded for each chunk */
+enum {
+  chunk_start,
+  chunk_iterations,
+  chunk_duration,
+  chunk_n_members
+};
+
+/* Members of the metric recorded for each histogram: the time spent in chunks,
+   then the chunks and iterations in each bucket */
+enum { histogram_n_members = 1 + 2 * dispatch_n_buckets };
+
+typedef struct dispatch_thread_t {
+  bool chunk_open;
+  uint64_t chunk_start;
+  uint64_t chunk_iterations;
+  uint64_t chunk_begin_time;
+  uint64_t n_chunks;
+  uint64_t time;
+  uint64_t chunks[dispatch_n_buckets];
+  uint64_t iterations[dispatch_n_buckets];
+} dispatch_thread_t;
+
+static otter_dispatch_mode_t mode = otter_dispatch_events;
+static OTF2_MetricRef metric_class = OTF2_UNDEFINED_METRIC;
+static thread_local dispatch_thread_t dispatch = {0};
+
+static OTF2_MetricMemberRef write_metric_member(OTF2_GlobalDefWriter *writer,
+                                                const char *name,
+                                                OTF2_StringRef unit) {
+  OTF2_StringRef name_ref = get_unique_str_ref();
+  trace_archive_write_string_ref(writer, name_ref, name);
+  OTF2_MetricMemberRef member = get_unique_metric_member_ref();
+  OTF2_ErrorCode err = OTF2_GlobalDefWriter_WriteMetricMember(
+      writer, member, name_ref, name_ref, OTF2_METRIC_TYPE_OTHER,
+      OTF2_METRIC_ABSOLUTE_POINT, OTF2_TYPE_UINT64, OTF2_BASE_DECIMAL, 0,
+      unit);
+  CHECK_OTF2_ERROR_CODE(err);
+  return member;
+}
+
+void trace_dispatch_configure(const otter_opt_t *opt) {
+  if (!(opt->ompt_categories & otter_ompt_category_dispatch)) {
+    return;
+  }
+  mode = opt->dispatch_mode;
+
+  OTF2_ErrorCode err = OTF2_SUCCESS;
+  OTF2_MetricMemberRef members[histogram_n_members];
+  uint8_t n_members = 0;
+  char name[64] = {0};
+
+  pthread_mutex_lock(&state.global_def_writer.lock);
+  OTF2_GlobalDefWriter *writer = state.global_def_writer.instance;
+  OTF2_StringRef iterations = get_unique_str_ref();
+  trace_archive_write_string_ref(writer, iterations, "iterations");
+  OTF2_StringRef ns = get_unique_str_ref();
+  trace_archive_write_string_ref(writer, ns, "ns");
+  if (mode == otter_dispatch_events) {
+    members[n_members++] =
+        write_metric_member(writer, "OTTER::DISPATCH::CHUNK_START", iterations);
+    members[n_members++] = write_metric_member(
+        writer, "OTTER::DISPATCH::CHUNK_ITERATIONS", iterations);
+    members[n_members++] =
+        write_metric_member(writer, "OTTER::DISPATCH::CHUNK_DURATION", ns);
+  } else {
+    OTF2_StringRef chunks = get_unique_str_ref();
+    trace_archive_write_string_ref(writer, chunks, "chunks");
+    members[n_members++] =
+        write_metric_member(writer, "OTTER::DISPATCH::TIME", ns);
+    for (int bucket = 0; bucket < dispatch_n_buckets; bucket++) {
+      snprintf(name, sizeof(name), "OTTER::DISPATCH::CHUNKS_GE_%" PRIu64,
+               (uint64_t)1 << bucket);
+      members[n_members++] = write_metric_member(writer, name, chunks);
+    }
+    for (int bucket = 0; bucket < dispatch_n_buckets; bucket++) {
+      snprintf(name, sizeof(name), "OTTER::DISPATCH::ITERATIONS_GE_%" PRIu64,
+               (uint64_t)1 << bucket);
+      members[n_members++] = write_metric_member(writer, name, iterations);
+    }
+  }
+  metric_class = get_unique_metric_ref();
+  err = OTF2_GlobalDefWriter_WriteMetricClass(writer, metric_class, n_members,
+                                              members, OTF2_METRIC_ASYNCHRONOUS,
+                                              OTF2_RECORDER_KIND_ABSTRACT);
+  CHECK_OTF2_ERROR_CODE(err);
+  pthread_mutex_unlock(&state.global_def_writer.lock);
+
+  err = OTF2_Archive_SetProperty(state.archive.instance,
+                                 "OTTER::DISPATCH_MODE",
+                                 mode == otter_dispatch_events ? "events"
+                                                               : "histogram",
+                                 true);
+  CHECK_OTF2_ERROR_CODE(err);
+}
+
+static void write_metric(trace_location_def_t *location, uint8_t n_values,
+                         const OTF2_MetricValue *values, uint64_t time) {
+  OTF2_EvtWriter *event_writer = NULL;
+  OTF2_Type types[histogram_n_members];
+  for (uint8_t k = 0; k < n_values; k++) {
+    types[k] = OTF2_TYPE_UINT64;
+  }
+
+  trace_location_get_otf2(location, NULL, &event_writer, NULL);
+
+  uint64_t self_profile_begin = trace_self_profile_begin();
+  OTF2_ErrorCode err = OTF2_EvtWriter_Metric(event_writer, NULL, time,
+                                             metric_class, n_values, types,
+                                             values);
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
+  CHECK_OTF2_ERROR_CODE(err);
+  trace_location_inc_event_count(location);
+}
+
+static inline int bucket_of(uint64_t iterations) {
+  if (iterations <= 1) {
+    return 0;
+  }
+  int bucket = 63 - __builtin_clzll(iterations);
+  return bucket < dispatch_n_buckets ? bucket : dispatch_n_buckets - 1;
+}
+
+/* End the open chunk at `time`, recording it as an event or in the histogram */
+static void close_chunk(trace_location_def_t *location, uint64_t time) {
+  if (!dispatch.chunk_open) {
+    return;
+  }
+  dispatch.chunk_open = false;
+  uint64_t duration = time - dispatch.chunk_begin_time;
+  if (mode == otter_dispatch_events) {
+    OTF2_MetricValue values[chunk_n_members];
+    values[chunk_start].unsigned_int = dispatch.chunk_start;
+    values[chunk_iterations].unsigned_int = dispatch.chunk_iterations;
+    values[chunk_duration].unsigned_int = duration;
+    write_metric(location, chunk_n_members, values, time);
+  } else {
+    int bucket = bucket_of(dispatch.chunk_iterations);
+    dispatch.n_chunks++;
+    dispatch.time += duration;
+    dispatch.chunks[bucket]++;
+    dispatch.iterations[bucket] += dispatch.chunk_iterations;
+  }
+}
+
+void trace_dispatch_chunk(trace_location_def_t *location, uint64_t start,
+                          uint64_t iterations) {
+  uint64_t time = get_timestamp();
+  close_chunk(location, time);
+  dispatch.chunk_open = true;
+  dispatch.chunk_start = start;
+  dispatch.chunk_iterations = iterations;
+  dispatch.chunk_begin_time = time;
+}
+
+void trace_dispatch_work_end(trace_location_def_t *location) {
+  uint64_t time = get_timestamp();
+  close_chunk(location, time);
+  if (mode != otter_dispatch_histogram || dispatch.n_chunks == 0) {
+    return;
+  }
+
+  OTF2_MetricValue values[histogram_n_members];
+  values[0].unsigned_int = dispatch.time;
+  for (int bucket = 0; bucket < dispatch_n_buckets; bucket++) {
+    values[1 + bucket].unsigned_int = dispatch.chunks[bucket];
+    values[1 + dispatch_n_buckets + bucket].unsigned_int =
+        dispatch.iterations[bucket];
+  }
+  write_metric(location, histogram_n_members, values, time);
+  memset(&dispatch, 0, sizeof(dispatch));
+}
@@ -0,0 +1,191 @@
+/**
+ * @file trace-governor.c
+ * @author Adam Tuft
+ * @brief Implementation of the overhead governor. Each thread measures the
+ * time it spends inside Otter over a fixed window of wall-clock time. At the
+ * end of each window the thread's sampling stride is doubled if the measured
+ * overhead exceeded the target, or halved if it was below half the target.
+ * All state is thread-local except the largest stride chosen, which is
+ * recorded in the archive at finalisation.
+ * @version 0.1
+ * @date 2023-05-09
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <inttypes.h>
+#include <otf2/otf2.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include "public/debug.h"
+#include "public/otter-trace/trace-governor.h"
+#include "public/otter-trace/trace-self-profile.h"
+#include "public/threads.h"
+
+#include "trace-archive-impl.h"
+#include "trace-attribute-lookup.h"
+#include "trace-attributes.h"
+#include "trace-check-error-code.h"
+#include "trace-state.h"
+#include "trace-timestamp.h"
+#include "trace-unique-refs.h"
+
+enum {
+  governor_window_ns = 10000000, // re-evaluate the stride every 10ms
+  governor_max_level = 10,       // largest stride is 2^10
+  governor_stride_parameter = 0, // OTF2_ParameterRef of the stride parameter
+};
+
+/* The stride level at which each category of events is disabled */
+static const unsigned disable_at_level[trace_governor_n_categories] = {
+    [trace_governor_master] = 1,
+    [trace_governor_workshare] = 2,
+};
+
+typedef struct governor_thread_t {
+  unsigned depth;           // nesting depth of enter/leave
+  unsigned level;           // the sampling stride is 2^level
+  uint64_t window_start;    // start of the present measurement window
+  uint64_t window_overhead; // time inside Otter in the present window
+  uint64_t sample_count;    // items offered to trace_governor_sample()
+  uint64_t scope_skipped[trace_governor_n_categories]; // 1 bit per open scope
+} governor_thread_t;
+
+static bool enabled = false;
+static double target = 0.0; // as a fraction of runtime
+static unsigned max_level = 0;
+
+static thread_local governor_thread_t governor = {0};
+
+void trace_governor_configure(const otter_opt_t *opt) {
+  enabled = opt->overhead_target > 0.0 && opt->mode == otter_mode_trace;
+  if (!enabled) {
+    return;
+  }
+  target = opt->overhead_target / 100.0;
+
+  char value[32] = {0};
+  snprintf(value, sizeof(value), "%g", opt->overhead_target);
+  OTF2_ErrorCode err = OTF2_Archive_SetProperty(
+      state.archive.instance, "OTTER::OVERHEAD_TARGET_PERCENT", value, true);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  // Define the parameter used to record changes in the sampling stride
+  pthread_mutex_lock(&state.global_def_writer.lock);
+  OTF2_StringRef name = get_unique_str_ref();
+  trace_archive_write_string_ref(state.global_def_writer.instance, name,
+                                 "OTTER::SAMPLING_STRIDE");
+  err = OTF2_GlobalDefWriter_WriteParameter(state.global_def_writer.instance,
+                                            governor_stride_parameter, name,
+                                            OTF2_PARAMETER_TYPE_UINT64);
+  CHECK_OTF2_ERROR_CODE(err);
+  pthread_mutex_unlock(&state.global_def_writer.lock);
+}
+
+void trace_governor_finalise(void) {
+  if (!enabled) {
+    return;
+  }
+  char value[32] = {0};
+  snprintf(value, sizeof(value), "%u", 1u << max_level);
+  OTF2_ErrorCode err = OTF2_Archive_SetProperty(
+      state.archive.instance, "OTTER::MAX_SAMPLING_STRIDE", value, true);
+  CHECK_OTF2_ERROR_CODE(err);
+}
+
+bool trace_governor_enabled(void) { return enabled; }
+
+uint64_t trace_governor_enter(void) {
+  if (!enabled || governor.depth++ > 0) {
+    return 0;
+  }
+  return get_timestamp();
+}
+
+unsigned trace_governor_leave(uint64_t enter) {
+  if (!enabled || --governor.depth > 0) {
+    return 0;
+  }
+  uint64_t now = get_timestamp();
+  governor.window_overhead += now - enter;
+  if (governor.window_start == 0) {
+    governor.window_start = enter;
+  }
+  uint64_t elapsed = now - governor.window_start;
+  if (elapsed < governor_window_ns) {
+    return 0;
+  }
+
+  double overhead = (double)governor.window_overhead / (double)elapsed;
+  unsigned level = governor.level;
+  if (overhead > target && level < governor_max_level) {
+    level++;
+  } else if (overhead < target / 2 && level > 0) {
+    level--;
+  }
+  governor.window_start = now;
+  governor.window_overhead = 0;
+  if (level == governor.level) {
+    return 0;
+  }
+
+  LOG_DEBUG("overhead %.2f%% (target %.2f%%): stride %u -> %u",
+            100.0 * overhead, 100.0 * target, 1u << governor.level,
+            1u << level);
+  governor.level = level;
+  unsigned prev_max = max_level;
+  while (level > prev_max &&
+         !__sync_bool_compare_and_swap(&max_level, prev_max, level)) {
+    prev_max = max_level;
+  }
+  return 1u << level;
+}
+
+bool trace_governor_sample(void) {
+  if (governor.level == 0) {
+    return true;
+  }
+  uint64_t mask = (1ull << governor.level) - 1;
+  return (governor.sample_count++ & mask) == 0;
+}
+
+bool trace_governor_begin_scope(trace_governor_category_t category) {
+  bool skip = enabled && governor.level >= disable_at_level[category];
+  governor.scope_skipped[category] =
+      (governor.scope_skipped[category] << 1) | (skip ? 1 : 0);
+  return !skip;
+}
+
+bool trace_governor_end_scope(trace_governor_category_t category) {
+  bool skip = governor.scope_skipped[category] & 1;
+  governor.scope_skipped[category] >>= 1;
+  return !skip;
+}
+
+void trace_governor_write_stride(trace_location_def_t *location,
+                                 unsigned stride) {
+  OTF2_ErrorCode err = OTF2_SUCCESS;
+  OTF2_AttributeList *attr = OTF2_AttributeList_New();
+  OTF2_EvtWriter *event_writer = NULL;
+
+  trace_location_get_otf2(location, NULL, &event_writer, NULL);
+
+  err = OTF2_AttributeList_AddStringRef(
+      attr, attr_event_type, attr_label_ref[attr_event_type_sampling_stride]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddStringRef(attr, attr_endpoint,
+                                        attr_label_ref[attr_endpoint_discrete]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  uint64_t self_profile_begin = trace_self_profile_begin();
+  err = OTF2_EvtWriter_ParameterUnsignedInt(event_writer, attr,
+                                            get_timestamp(),
+                                            governor_stride_parameter, stride);
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  OTF2_AttributeList_Delete(attr);
+}
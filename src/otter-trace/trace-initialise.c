@@ -1,9 +1,21 @@
 #define _GNU_SOURCE
 #include "public/otter-trace/trace-initialise.h"
+#include "public/otter-trace/trace-counter.h"
+#include "public/otter-trace/trace-cpu.h"
+#include "public/otter-trace/trace-dependence.h"
+#include "public/otter-trace/trace-dispatch.h"
+#include "public/otter-trace/trace-governor.h"
+#include "public/otter-trace/trace-label.h"
+#include "public/otter-trace/trace-memory.h"
+#include "public/otter-trace/trace-mutex.h"
+#include "public/otter-trace/trace-ompt.h"
+#include "public/otter-trace/trace-self-profile.h"
+#include "public/otter-trace/trace-sync-wait.h"
 #include "trace-archive-impl.h"
 #include "trace-archive.h"
 #include "public/debug.h"
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,14 +23,12 @@
 #include <unistd.h>
 #define OTTER_TRACE_STATE_GLOBAL_DECL
 #include "trace-state.h"
+#include "trace-check-error-code.h"
 #include "trace-static-constants.h"
 #include "trace-unique-refs.h"
 
 enum { char_buff_sz = 1024 };
 
-static void write_str_ref_cbk(const char *s, OTF2_StringRef ref,
-                              void *def_writer);
-
 /**
  * @brief Copy the process' memory map from /proc/self/maps to aux/maps within
  * the trace directory. This information can be used to match return addresses
@@ -62,11 +72,61 @@ bool trace_initialise(otter_opt_t *opt) {
   /* Store archive name in options struct */
   opt->archive_name = &archive_name[0];
 
+  trace_self_profile_configure(opt);
+
   bool archive_initialised = trace_initialise_archive(
-      &archive_path[0], opt->archive_name, opt->event_model,
+      &archive_path[0], opt->archive_name, opt->event_model, opt->mode,
       &state.archive.instance, &state.global_def_writer.instance);
 
-  state.strings.instance = string_registry_make(get_unique_str_ref);
+  if (opt->coalesce_threshold > 0) {
+    char threshold[32] = {0};
+    snprintf(threshold, sizeof(threshold), "%" PRIu64, opt->coalesce_threshold);
+    OTF2_ErrorCode ret = OTF2_Archive_SetProperty(
+        state.archive.instance, "OTTER::COALESCE_THRESHOLD_NS", threshold,
+        true);
+    CHECK_OTF2_ERROR_CODE(ret);
+  }
+
+  if (opt->event_model == otter_event_model_omp) {
+    /* Record which optional categories of callbacks were requested */
+    char categories[128] = {0};
+#define APPEND_CATEGORY(cat, bit)                                              \
+  if (opt->ompt_categories & otter_ompt_category_##cat) {                      \
+    strcat(categories, categories[0] ? "," #cat : #cat);                       \
+  }
+    FOREACH_OTTER_OMPT_CATEGORY(APPEND_CATEGORY)
+#undef APPEND_CATEGORY
+    OTF2_ErrorCode ret = OTF2_Archive_SetProperty(
+        state.archive.instance, "OTTER::OMPT_CATEGORIES", categories, true);
+    CHECK_OTF2_ERROR_CODE(ret);
+  }
+
+  size_t string_cache_size = opt->string_cache_size;
+  if (string_cache_size > 0 && opt->mode == otter_mode_profile) {
+    // profile statistics are keyed by label, so labels mustn't be evicted
+    LOG_WARN("string cache is unbounded in profile mode");
+    string_cache_size = 0;
+  }
+  state.strings.instance =
+      string_registry_make_bounded(get_unique_str_ref, string_cache_size);
+
+  trace_governor_configure(opt);
+
+  trace_memory_configure(opt);
+
+  if (opt->event_model == otter_event_model_omp) {
+    trace_cpu_configure(opt);
+    trace_ompt_configure(opt);
+    trace_dispatch_configure(opt);
+    trace_sync_wait_configure(opt);
+    trace_mutex_configure(opt);
+  }
+
+  trace_dependence_configure(opt);
+
+  trace_label_configure(opt);
+
+  trace_counter_configure(opt);
 
   trace_copy_proc_maps(opt);
 
@@ -133,14 +193,16 @@ exit_error:
 
 bool trace_finalise(void) {
   LOG_DEBUG("=== Finalising trace ===");
-  string_registry_apply(state.strings.instance, write_str_ref_cbk,
-                        state.global_def_writer.instance);
+  trace_governor_finalise();
+  // strings were defined as they were interned, so only record how many were
+  // evicted from the cache (and so may be defined more than once)
+  char evictions[32] = {0};
+  snprintf(evictions, sizeof(evictions), "%" PRIu64,
+           string_registry_evictions(state.strings.instance));
+  OTF2_ErrorCode ret = OTF2_Archive_SetProperty(
+      state.archive.instance, "OTTER::STRING_EVICTIONS", evictions, true);
+  CHECK_OTF2_ERROR_CODE(ret);
   string_registry_delete(state.strings.instance);
   bool result = trace_finalise_archive(state.archive.instance);
   return result;
 }
-
-static void write_str_ref_cbk(const char *s, OTF2_StringRef ref,
-                              void *def_writer) {
-  trace_archive_write_string_ref((OTF2_GlobalDefWriter *)def_writer, ref, s);
-}
@@ -0,0 +1,489 @@
+/**
+ * @file trace-label.c
+ * @brief Implementation of structured task labels. Each thread counts the
+ * labels made from each template in its own table, estimating the number of
+ * distinct labels with a HyperLogLog sketch of the arguments (or of the
+ * formatted label, for templates which can't be recorded structurally). The
+ * tables keep their own copy of each template, as it may be evicted from the
+ * string registry, and are merged once at finalisation.
+ * @version 0.1
+ * @date 2023-05-22
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "public/debug.h"
+#include "public/otter-trace/trace-label.h"
+#include "public/threads.h"
+#include "public/types/queue.h"
+
+#include "trace-check-error-code.h"
+#include "trace-state.h"
+
+enum {
+  label_hll_bits = 10, // 2^10 registers, a standard error of about 3%
+  label_hll_registers = 1 << label_hll_bits,
+  label_table_init_sz = 16, // must be a power of 2
+  label_path_buff_sz = 1024,
+};
+
+/* Length modifiers of a printf conversion */
+typedef enum {
+  length_none,
+  length_hh,
+  length_h,
+  length_l,
+  length_ll,
+  length_j,
+  length_z,
+  length_t,
+  length_L
+} label_length_t;
+
+typedef struct label_entry_t {
+  bool used;
+  bool structured;
+  otter_string_ref_t template_ref;
+  char *template_str;
+  uint64_t count;
+  uint8_t registers[label_hll_registers];
+} label_entry_t;
+
+typedef struct label_table_t {
+  size_t capacity;
+  size_t length;
+  label_entry_t *entries;
+} label_table_t;
+
+static bool structured = false;
+
+// per-thread counts
+static thread_local label_table_t *thread_table = NULL;
+
+// store per-thread tables for merging at finalisation
+static struct {
+  otter_queue_t *instance;
+  pthread_mutex_t lock;
+} table_queue = {.instance = NULL, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+void trace_label_configure(const otter_opt_t *opt) {
+  if (opt->event_model != otter_event_model_task_graph) {
+    return;
+  }
+  structured = opt->structured_labels;
+  OTF2_ErrorCode err = OTF2_Archive_SetProperty(
+      state.archive.instance, "OTTER::STRUCTURED_LABELS",
+      structured ? "true" : "false", true);
+  CHECK_OTF2_ERROR_CODE(err);
+}
+
+bool trace_label_structured(void) { return structured; }
+
+bool trace_label_parse(const char *format, va_list args,
+                       otter_label_args_t *out) {
+  out->count = 0;
+  for (const char *p = format; *p != '\0'; p++) {
+    if (*p != '%') {
+      continue;
+    }
+    p++;
+    if (*p == '%') {
+      continue;
+    }
+
+    // flags, width and precision don't affect the argument
+    while (*p != '\0' && strchr("-+ #0'", *p) != NULL) {
+      p++;
+    }
+    while (*p >= '0' && *p <= '9') {
+      p++;
+    }
+    if (*p == '*') {
+      return false;
+    }
+    if (*p == '.') {
+      p++;
+      if (*p == '*') {
+        return false;
+      }
+      while (*p >= '0' && *p <= '9') {
+        p++;
+      }
+    }
+
+    label_length_t length = length_none;
+    switch (*p) {
+    case 'h':
+      length = p[1] == 'h' ? length_hh : length_h;
+      p += p[1] == 'h' ? 2 : 1;
+      break;
+    case 'l':
+      length = p[1] == 'l' ? length_ll : length_l;
+      p += p[1] == 'l' ? 2 : 1;
+      break;
+    case 'j':
+      length = length_j;
+      p++;
+      break;
+    case 'z':
+      length = length_z;
+      p++;
+      break;
+    case 't':
+      length = length_t;
+      p++;
+      break;
+    case 'L':
+      length = length_L;
+      p++;
+      break;
+    }
+
+    if (out->count == OTTER_LABEL_MAX_ARGS) {
+      return false;
+    }
+    uint64_t value = 0;
+    switch (*p) {
+    case 'd':
+    case 'i':
+      switch (length) {
+      case length_none:
+        value = (uint64_t)va_arg(args, int);
+        break;
+      case length_hh:
+        value = (uint64_t)(signed char)va_arg(args, int);
+        break;
+      case length_h:
+        value = (uint64_t)(short)va_arg(args, int);
+        break;
+      case length_l:
+        value = (uint64_t)va_arg(args, long);
+        break;
+      case length_ll:
+        value = (uint64_t)va_arg(args, long long);
+        break;
+      case length_j:
+        value = (uint64_t)va_arg(args, intmax_t);
+        break;
+      case length_z:
+        value = (uint64_t)va_arg(args, ssize_t);
+        break;
+      case length_t:
+        value = (uint64_t)va_arg(args, ptrdiff_t);
+        break;
+      default:
+        return false;
+      }
+      break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+      switch (length) {
+      case length_none:
+        value = va_arg(args, unsigned int);
+        break;
+      case length_hh:
+        value = (unsigned char)va_arg(args, unsigned int);
+        break;
+      case length_h:
+        value = (unsigned short)va_arg(args, unsigned int);
+        break;
+      case length_l:
+        value = va_arg(args, unsigned long);
+        break;
+      case length_ll:
+        value = va_arg(args, unsigned long long);
+        break;
+      case length_j:
+        value = va_arg(args, uintmax_t);
+        break;
+      case length_z:
+        value = va_arg(args, size_t);
+        break;
+      case length_t:
+        value = (uint64_t)va_arg(args, ptrdiff_t);
+        break;
+      default:
+        return false;
+      }
+      break;
+    case 'c':
+      if (length != length_none) {
+        return false;
+      }
+      value = (uint64_t)va_arg(args, int);
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A': {
+      if (length == length_L) {
+        return false;
+      }
+      double real = va_arg(args, double);
+      memcpy(&value, &real, sizeof(value));
+      break;
+    }
+    default:
+      // strings and pointers must be formatted, as must anything unrecognised
+      return false;
+    }
+    out->values[out->count++] = value;
+  }
+  return true;
+}
+
+static inline uint64_t label_mix(uint64_t key) {
+  key += 0x9e3779b97f4a7c15ULL;
+  key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+  return key ^ (key >> 31);
+}
+
+static uint64_t label_hash(otter_string_ref_t template_ref,
+                           const otter_label_args_t *args, const char *label) {
+  uint64_t hash = label_mix(template_ref);
+  if (args != NULL) {
+    for (uint8_t k = 0; k < args->count; k++) {
+      hash = label_mix(hash ^ args->values[k]);
+    }
+  } else {
+    // FNV-1a of the formatted label
+    uint64_t fnv = 0xcbf29ce484222325ULL;
+    for (; label != NULL && *label != '\0'; label++) {
+      fnv = (fnv ^ (unsigned char)*label) * 0x100000001b3ULL;
+    }
+    hash = label_mix(hash ^ fnv);
+  }
+  return hash;
+}
+
+static label_table_t *label_table_new(size_t capacity) {
+  label_table_t *table = malloc(sizeof(*table));
+  if (table == NULL) {
+    LOG_ERROR("failed to allocate label table");
+    return NULL;
+  }
+  table->capacity = capacity;
+  table->length = 0;
+  table->entries = calloc(capacity, sizeof(*table->entries));
+  if (table->entries == NULL) {
+    LOG_ERROR("failed to allocate %zu label table entries", capacity);
+    free(table);
+    return NULL;
+  }
+  return table;
+}
+
+static void label_table_delete(label_table_t *table) {
+  if (table == NULL)
+    return;
+  for (size_t k = 0; k < table->capacity; k++) {
+    free(table->entries[k].template_str);
+  }
+  free(table->entries);
+  free(table);
+}
+
+static label_entry_t *label_table_find(label_table_t *table,
+                                       otter_string_ref_t template_ref);
+
+static bool label_table_grow(label_table_t *table) {
+  size_t capacity = table->capacity * 2;
+  label_entry_t *entries = calloc(capacity, sizeof(*entries));
+  if (entries == NULL) {
+    LOG_ERROR("failed to grow label table to %zu entries", capacity);
+    return false;
+  }
+  label_entry_t *old_entries = table->entries;
+  size_t old_capacity = table->capacity;
+  table->entries = entries;
+  table->capacity = capacity;
+  table->length = 0;
+  for (size_t k = 0; k < old_capacity; k++) {
+    if (old_entries[k].used) {
+      label_entry_t *entry =
+          label_table_find(table, old_entries[k].template_ref);
+      *entry = old_entries[k];
+    }
+  }
+  free(old_entries);
+  return true;
+}
+
+/* Get the entry for a template, inserting an empty one if not present */
+static label_entry_t *label_table_find(label_table_t *table,
+                                       otter_string_ref_t template_ref) {
+  if (2 * (table->length + 1) > table->capacity) {
+    if (!label_table_grow(table)) {
+      return NULL;
+    }
+  }
+  size_t mask = table->capacity - 1;
+  size_t k = (size_t)label_mix(template_ref) & mask;
+  while (table->entries[k].used) {
+    if (table->entries[k].template_ref == template_ref) {
+      return &table->entries[k];
+    }
+    k = (k + 1) & mask;
+  }
+  label_entry_t *entry = &table->entries[k];
+  entry->used = true;
+  entry->template_ref = template_ref;
+  table->length++;
+  return entry;
+}
+
+static inline label_table_t *get_thread_table(void) {
+  if (thread_table == NULL) {
+    thread_table = label_table_new(label_table_init_sz);
+    if (thread_table == NULL) {
+      return NULL;
+    }
+    pthread_mutex_lock(&table_queue.lock);
+    if (table_queue.instance == NULL) {
+      table_queue.instance = queue_create();
+    }
+    queue_push(table_queue.instance, (data_item_t){.ptr = thread_table});
+    pthread_mutex_unlock(&table_queue.lock);
+  }
+  return thread_table;
+}
+
+void trace_label_count(otter_string_ref_t template_ref,
+                       const char *template_str,
+                       const otter_label_args_t *args, const char *label) {
+  label_table_t *table = get_thread_table();
+  if (table == NULL) {
+    return;
+  }
+  label_entry_t *entry = label_table_find(table, template_ref);
+  if (entry == NULL) {
+    return;
+  }
+  if (entry->template_str == NULL) {
+    entry->template_str = strdup(template_str);
+  }
+  entry->count++;
+  entry->structured = args != NULL;
+
+  // the top bits select a register which keeps the longest run of leading
+  // zeros seen in the remaining bits
+  uint64_t hash = label_hash(template_ref, args, label);
+  size_t reg = (size_t)(hash >> (64 - label_hll_bits));
+  uint64_t rest = hash << label_hll_bits;
+  uint8_t rank = rest == 0 ? 64 - label_hll_bits + 1
+                           : (uint8_t)(__builtin_clzll(rest) + 1);
+  if (rank > entry->registers[reg]) {
+    entry->registers[reg] = rank;
+  }
+}
+
+/* Estimate the number of distinct labels counted in an entry */
+static uint64_t label_estimate_distinct(const label_entry_t *entry) {
+  const double m = (double)label_hll_registers;
+  double sum = 0.0;
+  unsigned zeros = 0;
+  for (int k = 0; k < label_hll_registers; k++) {
+    sum += 1.0 / (double)((uint64_t)1 << entry->registers[k]);
+    if (entry->registers[k] == 0)
+      zeros++;
+  }
+  double estimate = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+  if (estimate <= 2.5 * m && zeros != 0) {
+    // linear counting is more accurate for small cardinalities
+    estimate = m * log(m / (double)zeros);
+  }
+  uint64_t distinct = (uint64_t)(estimate + 0.5);
+  return distinct < entry->count ? distinct : entry->count;
+}
+
+/* Write a CSV field, quoting it and doubling any embedded quotes */
+static void write_csv_string(FILE *file, const char *s) {
+  fputc('"', file);
+  for (; s != NULL && *s != '\0'; s++) {
+    if (*s == '"')
+      fputc('"', file);
+    fputc(*s, file);
+  }
+  fputc('"', file);
+}
+
+bool trace_label_write_summary(const otter_opt_t *opt) {
+  LOG_DEBUG("=== Writing label summary ===");
+
+  // merge the per-thread tables, taking the maximum of each register
+  label_table_t *merged = label_table_new(label_table_init_sz);
+  if (merged == NULL) {
+    return false;
+  }
+  pthread_mutex_lock(&table_queue.lock);
+  label_table_t *table = NULL;
+  while (table_queue.instance != NULL &&
+         queue_pop(table_queue.instance, (data_item_t *)&table)) {
+    for (size_t k = 0; k < table->capacity; k++) {
+      label_entry_t *from = &table->entries[k];
+      if (!from->used)
+        continue;
+      label_entry_t *into = label_table_find(merged, from->template_ref);
+      if (into == NULL)
+        continue;
+      if (into->template_str == NULL) {
+        into->template_str = from->template_str;
+        from->template_str = NULL;
+      }
+      into->count += from->count;
+      into->structured = from->structured;
+      for (int r = 0; r < label_hll_registers; r++) {
+        if (from->registers[r] > into->registers[r])
+          into->registers[r] = from->registers[r];
+      }
+    }
+    label_table_delete(table);
+  }
+  queue_destroy(table_queue.instance, false, NULL);
+  table_queue.instance = NULL;
+  pthread_mutex_unlock(&table_queue.lock);
+  thread_table = NULL;
+
+  char path[label_path_buff_sz] = {0};
+  snprintf(path, label_path_buff_sz, "%s/%s/labels.csv", opt->tracepath,
+           opt->archive_name);
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    LOG_ERROR("Error opening file %s: %s", path, strerror(errno));
+  } else {
+    fprintf(file, "template,structured,count,distinct_estimate\n");
+    for (size_t k = 0; k < merged->capacity; k++) {
+      label_entry_t *entry = &merged->entries[k];
+      if (!entry->used)
+        continue;
+      write_csv_string(file, entry->template_str);
+      fprintf(file, ",%d,%" PRIu64 ",%" PRIu64 "\n", entry->structured,
+              entry->count, label_estimate_distinct(entry));
+    }
+    fclose(file);
+    fprintf(stderr, "%s%s\n", "OTTER_LABEL_SUMMARY:", path);
+  }
+
+  label_table_delete(merged);
+  return file != NULL;
+}
@@ -10,6 +10,7 @@
 #define _GNU_SOURCE
 
 #include "public/otter-trace/trace-location.h"
+#include "public/otter-trace/trace-self-profile.h"
 #include "trace-archive-impl.h"
 #include "trace-attribute-lookup.h"
 #include "trace-attributes.h"
@@ -78,6 +79,11 @@ void trace_destroy_location(trace_location_def_t *loc) {
   if (loc == NULL)
     return;
   trace_write_location_definition(loc);
+  // no more events can be written, so flush the location's event buffer now
+  // rather than when the archive is closed
+  OTF2_ErrorCode err =
+      OTF2_Archive_CloseEvtWriter(state.archive.instance, loc->evt_writer);
+  CHECK_OTF2_ERROR_CODE(err);
   LOG_DEBUG("[t=%lu] destroying rgn_stack %p", loc->id, loc->rgn_stack);
   stack_destroy(loc->rgn_stack, false, NULL);
   if (loc->rgn_defs) {
@@ -104,6 +110,7 @@ void trace_write_location_definition(trace_location_def_t *loc) {
   snprintf(location_name, default_name_buf_sz, "Thread %lu", loc->id);
 
   LOG_DEBUG("[t=%lu] locking global def writer", loc->id);
+  uint64_t self_profile_begin = trace_self_profile_begin();
   pthread_mutex_lock(&state.global_def_writer.lock);
 
   OTF2_GlobalDefWriter_WriteString(state.global_def_writer.instance,
@@ -116,6 +123,7 @@ void trace_write_location_definition(trace_location_def_t *loc) {
 
   LOG_DEBUG("[t=%lu] unlocking global def writer", loc->id);
   pthread_mutex_unlock(&state.global_def_writer.lock);
+  trace_self_profile_end(trace_self_def_write, self_profile_begin);
   return;
 }
 
@@ -207,6 +215,13 @@ void trace_location_leave_region(trace_location_def_t *loc,
   stack_pop(loc->rgn_stack, (data_item_t *)rgn);
 }
 
+trace_region_def_t *
+trace_location_get_active_region(trace_location_def_t *loc) {
+  data_item_t item = {.ptr = NULL};
+  stack_peek(loc->rgn_stack, &item);
+  return item.ptr;
+}
+
 void trace_location_get_active_regions_from_task(trace_location_def_t *loc,
                                                  trace_region_def_t *task) {
   // Only valid if task is a task region
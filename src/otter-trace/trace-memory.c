@@ -0,0 +1,125 @@
+/**
+ * @file trace-memory.c
+ * @author Adam Tuft
+ * @brief Implementation of the memory report. Samples are claimed with a
+ * compare-and-swap on the time of the next sample, so whichever thread next
+ * records an event after a sample falls due records it on its own location.
+ * @version 0.1
+ * @date 2023-05-11
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <inttypes.h>
+#include <otf2/otf2.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include "public/debug.h"
+#include "public/otter-trace/trace-memory.h"
+#include "public/otter-trace/trace-self-profile.h"
+#include "public/types/memory-accounting.h"
+
+#include "trace-archive-impl.h"
+#include "trace-check-error-code.h"
+#include "trace-state.h"
+#include "trace-timestamp.h"
+#include "trace-unique-refs.h"
+
+static uint64_t sample_interval = 0; // ns, 0 when sampling is disabled
+static uint64_t next_sample = 0;
+static OTF2_MetricRef metric_class = OTF2_UNDEFINED_METRIC;
+
+void trace_memory_configure(const otter_opt_t *opt) {
+  if (opt->memory_sample_ms == 0) {
+    return;
+  }
+
+  OTF2_ErrorCode err = OTF2_SUCCESS;
+  OTF2_MetricMemberRef members[otter_mem_n_categories];
+  char name[64] = {0};
+
+  pthread_mutex_lock(&state.global_def_writer.lock);
+  OTF2_GlobalDefWriter *writer = state.global_def_writer.instance;
+  OTF2_StringRef unit = get_unique_str_ref();
+  trace_archive_write_string_ref(writer, unit, "bytes");
+  for (int category = 0; category < otter_mem_n_categories; category++) {
+    snprintf(name, sizeof(name), "OTTER::MEMORY::%s",
+             otter_mem_category_name(category));
+    OTF2_StringRef name_ref = get_unique_str_ref();
+    trace_archive_write_string_ref(writer, name_ref, name);
+    members[category] = get_unique_metric_member_ref();
+    err = OTF2_GlobalDefWriter_WriteMetricMember(
+        writer, members[category], name_ref, name_ref, OTF2_METRIC_TYPE_OTHER,
+        OTF2_METRIC_ABSOLUTE_POINT, OTF2_TYPE_UINT64, OTF2_BASE_DECIMAL, 0,
+        unit);
+    CHECK_OTF2_ERROR_CODE(err);
+  }
+  metric_class = get_unique_metric_ref();
+  err = OTF2_GlobalDefWriter_WriteMetricClass(
+      writer, metric_class, otter_mem_n_categories, members,
+      OTF2_METRIC_ASYNCHRONOUS, OTF2_RECORDER_KIND_ABSTRACT);
+  CHECK_OTF2_ERROR_CODE(err);
+  pthread_mutex_unlock(&state.global_def_writer.lock);
+
+  sample_interval = opt->memory_sample_ms * 1000000;
+  next_sample = get_timestamp() + sample_interval;
+}
+
+bool trace_memory_sample_due(void) {
+  if (sample_interval == 0) {
+    return false;
+  }
+  uint64_t next = __atomic_load_n(&next_sample, __ATOMIC_RELAXED);
+  uint64_t now = get_timestamp();
+  return now >= next && __atomic_compare_exchange_n(
+                            &next_sample, &next, now + sample_interval, false,
+                            __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+void trace_memory_write_sample(trace_location_def_t *location) {
+  OTF2_ErrorCode err = OTF2_SUCCESS;
+  OTF2_EvtWriter *event_writer = NULL;
+  OTF2_Type types[otter_mem_n_categories];
+  OTF2_MetricValue values[otter_mem_n_categories];
+
+  for (int category = 0; category < otter_mem_n_categories; category++) {
+    types[category] = OTF2_TYPE_UINT64;
+    values[category].unsigned_int = otter_mem_current(category);
+  }
+
+  trace_location_get_otf2(location, NULL, &event_writer, NULL);
+
+  uint64_t self_profile_begin = trace_self_profile_begin();
+  err = OTF2_EvtWriter_Metric(event_writer, NULL, get_timestamp(),
+                              metric_class, otter_mem_n_categories, types,
+                              values);
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
+  CHECK_OTF2_ERROR_CODE(err);
+}
+
+void trace_memory_finalise(void) {
+  LOG_DEBUG("=== Writing memory usage ===");
+  fprintf(stderr, "\nOTTER MEMORY USAGE:\n");
+  for (int category = 0; category < otter_mem_n_categories; category++) {
+    size_t current = otter_mem_current(category);
+    size_t high_water = otter_mem_high_water(category);
+    fprintf(stderr, "%35s: %12zu bytes (high-water %12zu bytes)\n",
+            otter_mem_category_name(category), current, high_water);
+
+    char name[64] = {0};
+    char value[32] = {0};
+    OTF2_ErrorCode err = OTF2_SUCCESS;
+    snprintf(name, sizeof(name), "OTTER::MEMORY::%s_BYTES",
+             otter_mem_category_name(category));
+    snprintf(value, sizeof(value), "%zu", current);
+    err = OTF2_Archive_SetProperty(state.archive.instance, name, value, true);
+    CHECK_OTF2_ERROR_CODE(err);
+    snprintf(name, sizeof(name), "OTTER::MEMORY::%s_HIGH_WATER_BYTES",
+             otter_mem_category_name(category));
+    snprintf(value, sizeof(value), "%zu", high_water);
+    err = OTF2_Archive_SetProperty(state.archive.instance, name, value, true);
+    CHECK_OTF2_ERROR_CODE(err);
+  }
+}
@@ -0,0 +1,594 @@
+/**
+ * @file trace-mutex.c
+ * @brief Implementation of mutex statistics. Each thread keeps the mutexes it
+ * is waiting for or holding in a small array, and accumulates into its own
+ * table keyed by (kind, codeptr_ra). The tables are merged once at
+ * finalisation, in the same way as the otter-task-graph profile. Events are
+ * only written for mutexes waited for at least the event threshold, whose lock
+ * IDs are numbered in a table shared by all threads.
+ * @version 0.1
+ * @date 2023-05-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <otf2/otf2.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "public/debug.h"
+#include "public/otter-trace/trace-cpu.h"
+#include "public/otter-trace/trace-mutex.h"
+#include "public/otter-trace/trace-self-profile.h"
+#include "public/threads.h"
+#include "public/types/queue.h"
+
+#include "trace-attribute-lookup.h"
+#include "trace-attributes.h"
+#include "trace-check-error-code.h"
+#include "trace-state.h"
+#include "trace-timestamp.h"
+#include "trace-types-as-labels.h"
+
+enum {
+  mutex_held_max = 32,        // mutexes a thread may wait for or hold at once
+  mutex_table_init_sz = 64,   // must be a power of 2
+  mutex_path_buff_sz = 1024,
+  mutex_summary_top = 5,      // mutexes printed to stderr at finalisation
+  lock_id_table_init_sz = 64, // must be a power of 2
+};
+
+typedef struct mutex_stats_t {
+  uint64_t acquisitions;
+  uint64_t wait_total;
+  uint64_t wait_max;
+  uint64_t hold_total;
+  uint64_t hold_max;
+  uint64_t inits;
+  uint64_t destroys;
+} mutex_stats_t;
+
+typedef struct mutex_entry_t {
+  bool used;
+  otter_mutex_t kind;
+  const void *codeptr_ra;
+  mutex_stats_t stats;
+} mutex_entry_t;
+
+typedef struct mutex_table_t {
+  size_t capacity;
+  size_t length;
+  mutex_entry_t *entries;
+} mutex_table_t;
+
+/* A mutex the thread is waiting for (acquired == 0) or holding */
+typedef struct mutex_held_t {
+  uint64_t wait_id;
+  otter_mutex_t kind;
+  const void *codeptr_ra;
+  uint64_t acquire;
+  uint64_t acquired;
+  bool recorded;        // whether its acquisition was written as an event
+  uint32_t lock_id;     // if recorded
+  uint32_t acquisition; // if recorded
+} mutex_held_t;
+
+typedef struct mutex_thread_t {
+  mutex_table_t *table;
+  size_t n_held;
+  mutex_held_t held[mutex_held_max];
+  uint32_t acquisitions;
+} mutex_thread_t;
+
+typedef struct lock_id_entry_t {
+  bool used;
+  uint64_t wait_id;
+  uint32_t lock_id;
+} lock_id_entry_t;
+
+static uint64_t event_threshold = 0; // ns, 0 when events are disabled
+static thread_local mutex_thread_t mutex = {0};
+
+// OTF2 lock IDs are 32-bit, so number each lock whose events are written
+static struct {
+  pthread_mutex_t lock;
+  size_t capacity;
+  size_t length;
+  lock_id_entry_t *entries;
+} lock_ids = {.lock = PTHREAD_MUTEX_INITIALIZER,
+              .capacity = 0,
+              .length = 0,
+              .entries = NULL};
+
+// store per-thread tables for merging at finalisation
+static struct {
+  otter_queue_t *instance;
+  pthread_mutex_t lock;
+} table_queue = {.instance = NULL, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+static const char *mutex_kind_name(otter_mutex_t kind) {
+  switch (kind) {
+  case otter_mutex_lock:
+    return "lock";
+  case otter_mutex_test_lock:
+    return "test_lock";
+  case otter_mutex_nest_lock:
+    return "nest_lock";
+  case otter_mutex_test_nest_lock:
+    return "test_nest_lock";
+  case otter_mutex_critical:
+    return "critical";
+  case otter_mutex_atomic:
+    return "atomic";
+  case otter_mutex_ordered:
+    return "ordered";
+  default:
+    return "unknown";
+  }
+}
+
+void trace_mutex_configure(const otter_opt_t *opt) {
+  if (!(opt->ompt_categories & otter_ompt_category_mutex)) {
+    return;
+  }
+  event_threshold = opt->mutex_event_threshold;
+  if (event_threshold > 0) {
+    char threshold[32] = {0};
+    snprintf(threshold, sizeof(threshold), "%" PRIu64, event_threshold);
+    OTF2_ErrorCode err =
+        OTF2_Archive_SetProperty(state.archive.instance,
+                                 "OTTER::MUTEX_EVENT_THRESHOLD_NS", threshold,
+                                 true);
+    CHECK_OTF2_ERROR_CODE(err);
+  }
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*   STATISTICS TABLE                                                        */
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static mutex_table_t *mutex_table_new(size_t capacity) {
+  mutex_table_t *table = malloc(sizeof(*table));
+  if (table == NULL) {
+    LOG_ERROR("failed to allocate mutex table");
+    return NULL;
+  }
+  table->capacity = capacity;
+  table->length = 0;
+  table->entries = calloc(capacity, sizeof(*table->entries));
+  if (table->entries == NULL) {
+    LOG_ERROR("failed to allocate %zu mutex table entries", capacity);
+    free(table);
+    return NULL;
+  }
+  return table;
+}
+
+static void mutex_table_delete(mutex_table_t *table) {
+  if (table == NULL)
+    return;
+  free(table->entries);
+  free(table);
+}
+
+static inline size_t mutex_hash(otter_mutex_t kind, const void *codeptr_ra) {
+  uint64_t key = (uint64_t)codeptr_ra ^ ((uint64_t)kind << 56);
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return (size_t)key;
+}
+
+static mutex_entry_t *mutex_table_find(mutex_table_t *table,
+                                       otter_mutex_t kind,
+                                       const void *codeptr_ra);
+
+static bool mutex_table_grow(mutex_table_t *table) {
+  size_t capacity = table->capacity * 2;
+  mutex_entry_t *entries = calloc(capacity, sizeof(*entries));
+  if (entries == NULL) {
+    LOG_ERROR("failed to grow mutex table to %zu entries", capacity);
+    return false;
+  }
+  mutex_entry_t *old_entries = table->entries;
+  size_t old_capacity = table->capacity;
+  table->entries = entries;
+  table->capacity = capacity;
+  table->length = 0;
+  for (size_t k = 0; k < old_capacity; k++) {
+    if (old_entries[k].used) {
+      mutex_entry_t *entry = mutex_table_find(table, old_entries[k].kind,
+                                              old_entries[k].codeptr_ra);
+      entry->stats = old_entries[k].stats;
+    }
+  }
+  free(old_entries);
+  return true;
+}
+
+/* Get the entry for (kind, codeptr_ra), inserting an empty one if not
+   present */
+static mutex_entry_t *mutex_table_find(mutex_table_t *table,
+                                       otter_mutex_t kind,
+                                       const void *codeptr_ra) {
+  if (2 * (table->length + 1) > table->capacity) {
+    if (!mutex_table_grow(table)) {
+      return NULL;
+    }
+  }
+  size_t mask = table->capacity - 1;
+  size_t k = mutex_hash(kind, codeptr_ra) & mask;
+  while (table->entries[k].used) {
+    if (table->entries[k].kind == kind &&
+        table->entries[k].codeptr_ra == codeptr_ra) {
+      return &table->entries[k];
+    }
+    k = (k + 1) & mask;
+  }
+  mutex_entry_t *entry = &table->entries[k];
+  entry->used = true;
+  entry->kind = kind;
+  entry->codeptr_ra = codeptr_ra;
+  table->length++;
+  return entry;
+}
+
+static void mutex_stats_merge(mutex_stats_t *into, const mutex_stats_t *from) {
+  into->acquisitions += from->acquisitions;
+  into->wait_total += from->wait_total;
+  if (from->wait_max > into->wait_max)
+    into->wait_max = from->wait_max;
+  into->hold_total += from->hold_total;
+  if (from->hold_max > into->hold_max)
+    into->hold_max = from->hold_max;
+  into->inits += from->inits;
+  into->destroys += from->destroys;
+}
+
+static mutex_stats_t *get_thread_stats(otter_mutex_t kind,
+                                       const void *codeptr_ra) {
+  if (mutex.table == NULL) {
+    mutex.table = mutex_table_new(mutex_table_init_sz);
+    if (mutex.table == NULL) {
+      return NULL;
+    }
+    pthread_mutex_lock(&table_queue.lock);
+    if (table_queue.instance == NULL) {
+      table_queue.instance = queue_create();
+    }
+    queue_push(table_queue.instance, (data_item_t){.ptr = mutex.table});
+    pthread_mutex_unlock(&table_queue.lock);
+  }
+  mutex_entry_t *entry = mutex_table_find(mutex.table, kind, codeptr_ra);
+  return entry == NULL ? NULL : &entry->stats;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*   LOCK IDS                                                                */
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static lock_id_entry_t *lock_id_find(lock_id_entry_t *entries, size_t capacity,
+                                     uint64_t wait_id) {
+  size_t mask = capacity - 1;
+  size_t k = mutex_hash(0, (const void *)wait_id) & mask;
+  while (entries[k].used && entries[k].wait_id != wait_id) {
+    k = (k + 1) & mask;
+  }
+  return &entries[k];
+}
+
+/* Get the lock ID of the mutex with the given wait ID, numbering it if this is
+   its first event. Only called when writing events, so rarely contended */
+static uint32_t get_lock_id(uint64_t wait_id) {
+  pthread_mutex_lock(&lock_ids.lock);
+  if (2 * (lock_ids.length + 1) > lock_ids.capacity) {
+    size_t capacity = lock_ids.capacity == 0 ? lock_id_table_init_sz
+                                             : lock_ids.capacity * 2;
+    lock_id_entry_t *entries = calloc(capacity, sizeof(*entries));
+    if (entries == NULL) {
+      pthread_mutex_unlock(&lock_ids.lock);
+      LOG_ERROR("failed to grow lock ID table to %zu entries", capacity);
+      return OTF2_UNDEFINED_UINT32;
+    }
+    for (size_t k = 0; k < lock_ids.capacity; k++) {
+      if (lock_ids.entries[k].used) {
+        *lock_id_find(entries, capacity, lock_ids.entries[k].wait_id) =
+            lock_ids.entries[k];
+      }
+    }
+    free(lock_ids.entries);
+    lock_ids.entries = entries;
+    lock_ids.capacity = capacity;
+  }
+  lock_id_entry_t *entry =
+      lock_id_find(lock_ids.entries, lock_ids.capacity, wait_id);
+  if (!entry->used) {
+    *entry = (lock_id_entry_t){
+        .used = true, .wait_id = wait_id, .lock_id = lock_ids.length++};
+  }
+  uint32_t lock_id = entry->lock_id;
+  pthread_mutex_unlock(&lock_ids.lock);
+  return lock_id;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*   CALLBACKS                                                               */
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Find the most recent mutex with the given wait ID in the thread's array */
+static mutex_held_t *find_held(uint64_t wait_id) {
+  for (size_t k = mutex.n_held; k > 0; k--) {
+    if (mutex.held[k - 1].wait_id == wait_id) {
+      return &mutex.held[k - 1];
+    }
+  }
+  return NULL;
+}
+
+/* Find the mutex with the given wait ID which the thread holds, skipping any
+   entry for the same mutex which was never acquired */
+static mutex_held_t *find_acquired(uint64_t wait_id) {
+  for (size_t k = mutex.n_held; k > 0; k--) {
+    if (mutex.held[k - 1].wait_id == wait_id &&
+        mutex.held[k - 1].acquired != 0) {
+      return &mutex.held[k - 1];
+    }
+  }
+  return NULL;
+}
+
+void trace_mutex_acquire(otter_mutex_t kind, uint64_t wait_id,
+                         const void *codeptr_ra) {
+  /* A failed test-lock leaves an entry which was never acquired */
+  mutex_held_t *held = find_held(wait_id);
+  if (held == NULL || held->acquired != 0) {
+    if (mutex.n_held == mutex_held_max) {
+      LOG_DEBUG("ignoring mutex %lu, %d already held", wait_id,
+                mutex_held_max);
+      return;
+    }
+    held = &mutex.held[mutex.n_held++];
+  }
+  *held = (mutex_held_t){.wait_id = wait_id,
+                         .kind = kind,
+                         .codeptr_ra = codeptr_ra,
+                         .acquire = get_timestamp(),
+                         .acquired = 0,
+                         .recorded = false};
+}
+
+/* Write a ThreadAcquireLock or ThreadReleaseLock event for a mutex whose wait
+   was at least the event threshold. The pair share a lock ID and acquisition
+   number */
+static void write_mutex_event(trace_location_def_t *location,
+                              const mutex_held_t *held, bool acquired,
+                              uint64_t wait, uint64_t hold, uint64_t time) {
+  OTF2_ErrorCode err = OTF2_SUCCESS;
+  OTF2_AttributeList *attributes = NULL;
+  OTF2_EvtWriter *evt_writer = NULL;
+  trace_location_get_otf2(location, &attributes, &evt_writer, NULL);
+
+  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, trace_cpu_current());
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddStringRef(
+      attributes, attr_event_type,
+      attr_label_ref[acquired ? attr_event_type_mutex_acquired
+                              : attr_event_type_mutex_released]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddStringRef(attributes, attr_endpoint,
+                                        attr_label_ref[attr_endpoint_discrete]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddStringRef(
+      attributes, attr_mutex_kind,
+      attr_label_ref[mutex_kind_as_label(held->kind)]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddUint64(attributes, attr_caller_return_address,
+                                     (uint64_t)held->codeptr_ra);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddUint64(attributes, attr_mutex_wait_time, wait);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  if (!acquired) {
+    err = OTF2_AttributeList_AddUint64(attributes, attr_mutex_hold_time, hold);
+    CHECK_OTF2_ERROR_CODE(err);
+  }
+
+  uint64_t self_profile_begin = trace_self_profile_begin();
+  if (acquired) {
+    err = OTF2_EvtWriter_ThreadAcquireLock(evt_writer, attributes, time,
+                                           OTF2_PARADIGM_OPENMP, held->lock_id,
+                                           held->acquisition);
+  } else {
+    err = OTF2_EvtWriter_ThreadReleaseLock(evt_writer, attributes, time,
+                                           OTF2_PARADIGM_OPENMP, held->lock_id,
+                                           held->acquisition);
+  }
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  trace_location_inc_event_count(location);
+}
+
+void trace_mutex_acquired(trace_location_def_t *location, uint64_t wait_id) {
+  mutex_held_t *held = find_held(wait_id);
+  if (held == NULL || held->acquired != 0) {
+    return;
+  }
+  held->acquired = get_timestamp();
+  uint64_t wait = held->acquired - held->acquire;
+  if (event_threshold > 0 && wait >= event_threshold) {
+    held->lock_id = get_lock_id(wait_id);
+    held->acquisition = mutex.acquisitions++;
+    held->recorded = true;
+    write_mutex_event(location, held, true, wait, 0, held->acquired);
+  }
+}
+
+void trace_mutex_nest_lock(uint64_t wait_id, bool begin) {
+  if (!begin) {
+    return;
+  }
+  /* The thread already held the lock, so its latest wait was not an
+     acquisition: discard the entry left by trace_mutex_acquire() */
+  mutex_held_t *held = find_held(wait_id);
+  if (held != NULL && held->acquired == 0) {
+    *held = mutex.held[--mutex.n_held];
+  }
+}
+
+void trace_mutex_released(trace_location_def_t *location, uint64_t wait_id) {
+  mutex_held_t *held = find_acquired(wait_id);
+  if (held == NULL) {
+    return;
+  }
+  uint64_t time = get_timestamp();
+  uint64_t wait = held->acquired - held->acquire;
+  uint64_t hold = time - held->acquired;
+
+  mutex_stats_t *stats = get_thread_stats(held->kind, held->codeptr_ra);
+  if (stats != NULL) {
+    stats->acquisitions++;
+    stats->wait_total += wait;
+    if (wait > stats->wait_max)
+      stats->wait_max = wait;
+    stats->hold_total += hold;
+    if (hold > stats->hold_max)
+      stats->hold_max = hold;
+  }
+
+  if (held->recorded) {
+    write_mutex_event(location, held, false, wait, hold, time);
+  }
+
+  /* Mutexes are usually released in reverse order, so this is usually a pop */
+  *held = mutex.held[--mutex.n_held];
+}
+
+void trace_mutex_lock_init(otter_mutex_t kind, const void *codeptr_ra) {
+  mutex_stats_t *stats = get_thread_stats(kind, codeptr_ra);
+  if (stats != NULL) {
+    stats->inits++;
+  }
+}
+
+void trace_mutex_lock_destroy(otter_mutex_t kind, const void *codeptr_ra) {
+  mutex_stats_t *stats = get_thread_stats(kind, codeptr_ra);
+  if (stats != NULL) {
+    stats->destroys++;
+  }
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*   SUMMARY                                                                 */
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static int compare_wait_total(const void *a, const void *b) {
+  const mutex_entry_t *x = *(const mutex_entry_t *const *)a;
+  const mutex_entry_t *y = *(const mutex_entry_t *const *)b;
+  if (x->stats.wait_total != y->stats.wait_total)
+    return x->stats.wait_total < y->stats.wait_total ? 1 : -1;
+  return x->stats.hold_total < y->stats.hold_total   ? 1
+         : x->stats.hold_total > y->stats.hold_total ? -1
+                                                     : 0;
+}
+
+bool trace_mutex_write_summary(const otter_opt_t *opt) {
+  if (!(opt->ompt_categories & otter_ompt_category_mutex)) {
+    return false;
+  }
+  LOG_DEBUG("=== Writing mutex summary ===");
+
+  // merge the per-thread tables
+  mutex_table_t *merged = mutex_table_new(mutex_table_init_sz);
+  if (merged == NULL) {
+    return false;
+  }
+  pthread_mutex_lock(&table_queue.lock);
+  mutex_table_t *table = NULL;
+  while (table_queue.instance != NULL &&
+         queue_pop(table_queue.instance, (data_item_t *)&table)) {
+    for (size_t k = 0; k < table->capacity; k++) {
+      mutex_entry_t *from = &table->entries[k];
+      if (!from->used)
+        continue;
+      mutex_entry_t *into =
+          mutex_table_find(merged, from->kind, from->codeptr_ra);
+      if (into != NULL)
+        mutex_stats_merge(&into->stats, &from->stats);
+    }
+    mutex_table_delete(table);
+  }
+  queue_destroy(table_queue.instance, false, NULL);
+  table_queue.instance = NULL;
+  pthread_mutex_unlock(&table_queue.lock);
+  mutex.table = NULL;
+
+  pthread_mutex_lock(&lock_ids.lock);
+  free(lock_ids.entries);
+  lock_ids.entries = NULL;
+  lock_ids.capacity = lock_ids.length = 0;
+  pthread_mutex_unlock(&lock_ids.lock);
+
+  // rank by total wait time
+  mutex_entry_t **ranked = calloc(merged->length + 1, sizeof(*ranked));
+  if (ranked == NULL) {
+    LOG_ERROR("failed to allocate mutex ranking");
+    mutex_table_delete(merged);
+    return false;
+  }
+  size_t n_ranked = 0;
+  for (size_t k = 0; k < merged->capacity; k++) {
+    if (merged->entries[k].used)
+      ranked[n_ranked++] = &merged->entries[k];
+  }
+  qsort(ranked, n_ranked, sizeof(*ranked), compare_wait_total);
+
+  char path[mutex_path_buff_sz] = {0};
+  snprintf(path, mutex_path_buff_sz, "%s/%s/mutex.csv", opt->tracepath,
+           opt->archive_name);
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    LOG_ERROR("Error opening file %s: %s", path, strerror(errno));
+  } else {
+    fprintf(file, "kind,codeptr_ra,acquisitions,wait_total_ns,wait_max_ns,"
+                  "hold_total_ns,hold_max_ns,inits,destroys\n");
+    for (size_t k = 0; k < n_ranked; k++) {
+      mutex_stats_t *stats = &ranked[k]->stats;
+      fprintf(file,
+              "%s,%p,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+              ",%" PRIu64 ",%" PRIu64 "\n",
+              mutex_kind_name(ranked[k]->kind), ranked[k]->codeptr_ra,
+              stats->acquisitions, stats->wait_total, stats->wait_max,
+              stats->hold_total, stats->hold_max, stats->inits,
+              stats->destroys);
+    }
+    fclose(file);
+    fprintf(stderr, "%s%s\n", "OTTER_MUTEX_SUMMARY:", path);
+  }
+
+  fprintf(stderr, "\nOTTER MOST CONTENDED MUTEXES:\n");
+  for (size_t k = 0; k < n_ranked && k < mutex_summary_top; k++) {
+    mutex_stats_t *stats = &ranked[k]->stats;
+    fprintf(stderr,
+            "%14s %18p: %10" PRIu64 " acquisitions, %14" PRIu64
+            " ns waiting, %14" PRIu64 " ns held\n",
+            mutex_kind_name(ranked[k]->kind), ranked[k]->codeptr_ra,
+            stats->acquisitions, stats->wait_total, stats->hold_total);
+  }
+
+  free(ranked);
+  mutex_table_delete(merged);
+  return file != NULL;
+}
@@ -1,7 +1,6 @@
 #define _GNU_SOURCE
 
 #include <errno.h>
-#include <sched.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -14,8 +13,12 @@
 #include "public/debug.h"
 #include "public/otter-common.h"
 #include "public/otter-environment-variables.h"
+#include "public/otter-trace/trace-cpu.h"
+#include "public/otter-trace/trace-governor.h"
 #include "public/otter-trace/trace-location.h"
+#include "public/otter-trace/trace-memory.h"
 #include "public/otter-trace/trace-ompt.h"
+#include "public/otter-trace/trace-self-profile.h"
 #include "public/types/queue.h"
 #include "public/types/stack.h"
 
@@ -23,6 +26,7 @@
 #include "trace-attribute-lookup.h"
 #include "trace-attributes.h"
 #include "trace-check-error-code.h"
+#include "trace-state.h"
 #include "trace-static-constants.h"
 #include "trace-timestamp.h"
 #include "trace-types-as-labels.h"
@@ -32,7 +36,45 @@
 /*   WRITE EVENTS                                                            */
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
+static bool compact_tasks = false;
+
+static void trace_event_task_compact(trace_location_def_t *self,
+                                     trace_region_def_t *task);
+
+void trace_ompt_configure(const otter_opt_t *opt) {
+  compact_tasks = opt->compact_tasks;
+  if (compact_tasks) {
+    OTF2_ErrorCode err = OTF2_Archive_SetProperty(
+        state.archive.instance, "OTTER::COMPACT_TASKS", "1", true);
+    CHECK_OTF2_ERROR_CODE(err);
+  }
+}
+
+bool trace_task_is_compact(trace_region_def_t *task) {
+  if (!compact_tasks || task == NULL ||
+      trace_region_get_type(task) != trace_region_task) {
+    return false;
+  }
+  trace_region_attr_t attr = trace_region_get_attributes(task);
+  return attr.task.type == otter_task_explicit && !attr.task.expanded &&
+         (attr.task.flags & (otter_task_undeferred | otter_task_merged));
+}
+
+/* Record any memory sample which is due, then finish measuring the overhead of
+   an event and record any change in the sampling stride */
+static inline void trace_event_finish(trace_location_def_t *self,
+                                      uint64_t governor_enter) {
+  if (trace_memory_sample_due()) {
+    trace_memory_write_sample(self);
+  }
+  unsigned stride = trace_governor_leave(governor_enter);
+  if (stride != 0) {
+    trace_governor_write_stride(self, stride);
+  }
+}
+
 void trace_event_thread_begin(trace_location_def_t *self) {
+  uint64_t governor_enter = trace_governor_enter();
   OTF2_ErrorCode err = OTF2_SUCCESS;
   OTF2_AttributeList *attributes = NULL;
   OTF2_EvtWriter *evt_writer = NULL;
@@ -41,7 +83,7 @@ void trace_event_thread_begin(trace_location_def_t *self) {
   unique_id_t thread_id = trace_location_get_id(self);
   otter_thread_t thread_type = trace_location_get_thread_type(self);
 
-  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, sched_getcpu());
+  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, trace_cpu_current());
   CHECK_OTF2_ERROR_CODE(err);
 
   err = OTF2_AttributeList_AddUint64(attributes, attr_unique_id, thread_id);
@@ -61,16 +103,20 @@ void trace_event_thread_begin(trace_location_def_t *self) {
                                         attr_label_ref[attr_endpoint_enter]);
   CHECK_OTF2_ERROR_CODE(err);
 
+  uint64_t self_profile_begin = trace_self_profile_begin();
   err = OTF2_EvtWriter_ThreadBegin(evt_writer, attributes, get_timestamp(),
                                    OTF2_UNDEFINED_COMM, thread_id);
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
   CHECK_OTF2_ERROR_CODE(err);
 
   trace_location_inc_event_count(self);
 
+  trace_event_finish(self, governor_enter);
   return;
 }
 
 void trace_event_thread_end(trace_location_def_t *self) {
+  uint64_t governor_enter = trace_governor_enter();
   OTF2_ErrorCode err = OTF2_SUCCESS;
   OTF2_AttributeList *attributes = NULL;
   OTF2_EvtWriter *evt_writer = NULL;
@@ -79,7 +125,7 @@ void trace_event_thread_end(trace_location_def_t *self) {
   unique_id_t thread_id = trace_location_get_id(self);
   otter_thread_t thread_type = trace_location_get_thread_type(self);
 
-  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, sched_getcpu());
+  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, trace_cpu_current());
   CHECK_OTF2_ERROR_CODE(err);
 
   err = OTF2_AttributeList_AddUint64(attributes, attr_unique_id, thread_id);
@@ -98,16 +144,20 @@ void trace_event_thread_end(trace_location_def_t *self) {
                                         attr_label_ref[attr_endpoint_leave]);
   CHECK_OTF2_ERROR_CODE(err);
 
+  uint64_t self_profile_begin = trace_self_profile_begin();
   err = OTF2_EvtWriter_ThreadEnd(evt_writer, attributes, get_timestamp(),
                                  OTF2_UNDEFINED_COMM, thread_id);
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
   CHECK_OTF2_ERROR_CODE(err);
 
   trace_location_inc_event_count(self);
 
+  trace_event_finish(self, governor_enter);
   return;
 }
 
 void trace_event_enter(trace_location_def_t *self, trace_region_def_t *region) {
+  uint64_t governor_enter = trace_governor_enter();
   LOG_ERROR_IF((region == NULL), "null region pointer");
 
   OTF2_ErrorCode err = OTF2_SUCCESS;
@@ -150,7 +200,7 @@ void trace_event_enter(trace_location_def_t *self, trace_region_def_t *region) {
     break;
   }
 
-  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, sched_getcpu());
+  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, trace_cpu_current());
   CHECK_OTF2_ERROR_CODE(err);
 
   err = OTF2_AttributeList_AddUint64(attributes, attr_encountering_task_id,
@@ -173,8 +223,10 @@ void trace_event_enter(trace_location_def_t *self, trace_region_def_t *region) {
   trace_add_region_type_attributes(region, attributes);
 
   /* Record the event */
+  uint64_t self_profile_begin = trace_self_profile_begin();
   OTF2_EvtWriter_Enter(evt_writer, attributes, get_timestamp(),
                        trace_region_get_ref(region));
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
 
   trace_location_enter_region(self, region);
 
@@ -184,10 +236,12 @@ void trace_event_enter(trace_location_def_t *self, trace_region_def_t *region) {
   }
 
   trace_location_inc_event_count(self);
+  trace_event_finish(self, governor_enter);
   return;
 }
 
 void trace_event_leave(trace_location_def_t *self) {
+  uint64_t governor_enter = trace_governor_enter();
   OTF2_ErrorCode err = OTF2_SUCCESS;
   OTF2_AttributeList *attributes = NULL;
   OTF2_EvtWriter *evt_writer = NULL;
@@ -227,7 +281,7 @@ void trace_event_leave(trace_location_def_t *self) {
     break;
   }
 
-  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, sched_getcpu());
+  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, trace_cpu_current());
   CHECK_OTF2_ERROR_CODE(err);
 
   err = OTF2_AttributeList_AddUint64(attributes, attr_encountering_task_id,
@@ -250,8 +304,10 @@ void trace_event_leave(trace_location_def_t *self) {
   trace_add_region_type_attributes(region, attributes);
 
   /* Record the event */
+  uint64_t self_profile_begin = trace_self_profile_begin();
   OTF2_EvtWriter_Leave(evt_writer, attributes, get_timestamp(),
                        trace_region_get_ref(region));
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
 
   if (trace_region_is_type(region, trace_region_parallel)) {
     trace_location_leave_region_def_scope(self, region);
@@ -271,11 +327,14 @@ void trace_event_leave(trace_location_def_t *self) {
 
   trace_location_inc_event_count(self);
 
+  trace_event_finish(self, governor_enter);
   return;
 }
 
-void trace_event_task_create(trace_location_def_t *self,
-                             trace_region_def_t *region) {
+/* Write the task-create event of a task. A compact task which fell back to
+   full recording is created late, so also gives its create and start times */
+static void write_task_create_event(trace_location_def_t *self,
+                                    trace_region_def_t *region) {
   OTF2_ErrorCode err = OTF2_SUCCESS;
   OTF2_AttributeList *attributes = NULL;
   OTF2_EvtWriter *evt_writer = NULL;
@@ -290,7 +349,7 @@ void trace_event_task_create(trace_location_def_t *self,
   // conversions now defaults to an error in all C language modes.
   uint64_t task_create_ra = (uint64_t)attr.task.task_create_ra;
 
-  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, sched_getcpu());
+  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, trace_cpu_current());
   CHECK_OTF2_ERROR_CODE(err);
 
   err = OTF2_AttributeList_AddUint64(attributes, attr_encountering_task_id,
@@ -368,50 +427,65 @@ void trace_event_task_create(trace_location_def_t *self,
       attr_label_ref[task_status_as_label(attr.task.task_status)]);
   CHECK_OTF2_ERROR_CODE(err);
 
+  if (attr.task.expanded) {
+    err = OTF2_AttributeList_AddUint64(attributes, attr_task_create_time,
+                                       attr.task.create_time);
+    CHECK_OTF2_ERROR_CODE(err);
+
+    err = OTF2_AttributeList_AddUint64(attributes, attr_task_start_time,
+                                       attr.task.start_time);
+    CHECK_OTF2_ERROR_CODE(err);
+  }
+
+  uint64_t self_profile_begin = trace_self_profile_begin();
   OTF2_EvtWriter_ThreadTaskCreate(evt_writer, attributes, get_timestamp(),
                                   OTF2_UNDEFINED_COMM, OTF2_UNDEFINED_UINT32,
                                   0);
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
 
   trace_location_inc_event_count(self);
+}
+
+void trace_event_task_create(trace_location_def_t *self,
+                             trace_region_def_t *region) {
+  uint64_t governor_enter = trace_governor_enter();
+
+  /* Compact tasks are recorded when they complete */
+  if (trace_task_is_compact(region)) {
+    trace_region_set_task_create_time(region, get_timestamp());
+  } else {
+    write_task_create_event(self, region);
+  }
 
+  trace_event_finish(self, governor_enter);
   return;
 }
 
 void trace_event_task_schedule(trace_location_def_t *self,
                                trace_region_def_t *prior_task,
                                otter_task_status_t prior_status) {
+  uint64_t governor_enter = trace_governor_enter();
   /* Update prior task's status before recording task enter/leave events */
   LOG_ERROR_IF((trace_region_get_type(prior_task) != trace_region_task),
                "invalid region type %d", trace_region_get_type(prior_task));
   trace_region_set_task_status(prior_task, prior_status);
+  trace_event_finish(self, governor_enter);
   return;
 }
 
-void trace_event_task_switch(trace_location_def_t *self,
-                             trace_region_def_t *prior_task,
-                             otter_task_status_t prior_status,
-                             trace_region_def_t *next_task) {
-  // Update prior task's status
-  // Transfer thread's active region stack to prior_task->rgn_stack
-  // Transfer next_task->rgn_stack to thread
-  // Record event with details of tasks swapped & prior_status
-
+/* Write a task-switch event from a task with the given type and attributes to
+   the next task */
+static void write_task_switch_event(trace_location_def_t *self,
+                                    trace_region_type_t prior_task_region_type,
+                                    trace_region_attr_t prior_task_attr,
+                                    otter_task_status_t prior_status,
+                                    trace_region_attr_t next_task_attr) {
   OTF2_ErrorCode err = OTF2_SUCCESS;
   OTF2_AttributeList *attributes = NULL;
   OTF2_EvtWriter *evt_writer = NULL;
   trace_location_get_otf2(self, &attributes, &evt_writer, NULL);
 
-  trace_region_set_task_status(prior_task, prior_status);
-
-  trace_location_store_active_regions_in_task(self, prior_task);
-  trace_location_get_active_regions_from_task(self, next_task);
-
-  trace_region_type_t prior_task_region_type =
-      trace_region_get_type(prior_task);
-  trace_region_attr_t prior_task_attr = trace_region_get_attributes(prior_task);
-  trace_region_attr_t next_task_attr = trace_region_get_attributes(next_task);
-
-  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, sched_getcpu());
+  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, trace_cpu_current());
   CHECK_OTF2_ERROR_CODE(err);
 
   err = OTF2_AttributeList_AddUint64(attributes, attr_encountering_task_id,
@@ -454,9 +528,130 @@ void trace_event_task_switch(trace_location_def_t *self,
       attributes, attr_event_type, attr_label_ref[attr_event_type_task_switch]);
   CHECK_OTF2_ERROR_CODE(err);
 
+  uint64_t self_profile_begin = trace_self_profile_begin();
   OTF2_EvtWriter_ThreadTaskSwitch(evt_writer, attributes, get_timestamp(),
                                   OTF2_UNDEFINED_COMM, OTF2_UNDEFINED_UINT32,
                                   0); /* creating thread, generation number */
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
+}
+
+/* Fall back to full recording of a compact task which is switched out before
+   it completes (e.g. if it yields), so that the switch refers to a task
+   defined in the trace. The task's region definition is stored and its
+   creation and the switch into it from its encountering task are recorded
+   now, with the create and start times given as attributes */
+static void trace_task_expand_compact(trace_location_def_t *self,
+                                      trace_region_def_t *task) {
+  trace_region_set_task_expanded(task);
+  trace_location_store_region_def(self, task);
+  write_task_create_event(self, task);
+  trace_region_attr_t attr = trace_region_get_attributes(task);
+  trace_region_attr_t parent_attr = {
+      .task = {.id = attr.task.parent_id, .type = attr.task.parent_type}};
+  write_task_switch_event(self, trace_region_task, parent_attr,
+                          otter_task_switch, attr);
+}
+
+void trace_event_task_switch(trace_location_def_t *self,
+                             trace_region_def_t *prior_task,
+                             otter_task_status_t prior_status,
+                             trace_region_def_t *next_task) {
+  uint64_t governor_enter = trace_governor_enter();
+  // Update prior task's status
+  // Transfer thread's active region stack to prior_task->rgn_stack
+  // Transfer next_task->rgn_stack to thread
+  // Record event with details of tasks swapped & prior_status
 
+  /* A compact task runs to completion inside its encountering task, so the
+     thread's active regions are left in place when it first starts and when
+     it completes. A compact task switched out before it completes falls back
+     to full recording. */
+  if (trace_task_is_compact(next_task) &&
+      trace_region_get_attributes(next_task).task.start_time == 0) {
+    trace_region_set_task_status(prior_task, prior_status);
+    trace_region_set_task_start_time(next_task, get_timestamp());
+    trace_event_finish(self, governor_enter);
+    return;
+  }
+  if (trace_task_is_compact(prior_task)) {
+    if (prior_status == otter_task_complete) {
+      trace_region_set_task_status(prior_task, prior_status);
+      trace_event_task_compact(self, prior_task);
+      trace_event_finish(self, governor_enter);
+      return;
+    }
+    trace_task_expand_compact(self, prior_task);
+  }
+
+  trace_region_set_task_status(prior_task, prior_status);
+
+  /* A task which started compactly didn't take the thread's active regions,
+     which stay with its encountering task when it completes */
+  trace_region_attr_t prior_task_attr = trace_region_get_attributes(prior_task);
+  if (!(prior_status == otter_task_complete && prior_task_attr.task.expanded)) {
+    trace_location_store_active_regions_in_task(self, prior_task);
+    trace_location_get_active_regions_from_task(self, next_task);
+  }
+
+  write_task_switch_event(self, trace_region_get_type(prior_task),
+                          prior_task_attr, prior_status,
+                          trace_region_get_attributes(next_task));
+
+  trace_event_finish(self, governor_enter);
   return;
 }
+
+/* Record the creation, start and completion of a compact task in one event */
+static void trace_event_task_compact(trace_location_def_t *self,
+                                     trace_region_def_t *task) {
+  OTF2_ErrorCode err = OTF2_SUCCESS;
+  OTF2_AttributeList *attributes = NULL;
+  OTF2_EvtWriter *evt_writer = NULL;
+  trace_location_get_otf2(self, &attributes, &evt_writer, NULL);
+
+  trace_region_attr_t attr = trace_region_get_attributes(task);
+
+  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, trace_cpu_current());
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddUint64(attributes, attr_encountering_task_id,
+                                     attr.task.parent_id);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddStringRef(
+      attributes, attr_event_type,
+      attr_label_ref[attr_event_type_task_compact]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddStringRef(attributes, attr_endpoint,
+                                        attr_label_ref[attr_endpoint_discrete]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddUint64(attributes, attr_unique_id, attr.task.id);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddUint32(attributes, attr_task_flags,
+                                     attr.task.flags);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddUint64(attributes, attr_task_create_ra,
+                                     (uint64_t)attr.task.task_create_ra);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddUint64(attributes, attr_task_create_time,
+                                     attr.task.create_time);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddUint64(attributes, attr_task_start_time,
+                                     attr.task.start_time);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  uint64_t self_profile_begin = trace_self_profile_begin();
+  err = OTF2_EvtWriter_ThreadTaskComplete(evt_writer, attributes,
+                                          get_timestamp(), OTF2_UNDEFINED_COMM,
+                                          OTF2_UNDEFINED_UINT32, 0);
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  trace_location_inc_event_count(self);
+}
@@ -1,5 +1,9 @@
 #include "public/otter-trace/trace-region-def.h"
+#include "public/otter-trace/source-location.h"
+#include "public/otter-trace/strings.h"
 #include "public/otter-trace/trace-ompt.h"
+#include "public/otter-trace/trace-self-profile.h"
+#include "public/types/memory-accounting.h"
 #include "public/types/queue.h"
 #include "public/types/stack.h"
 #include <assert.h>
@@ -27,11 +31,25 @@ typedef struct trace_region_def_t {
   trace_region_attr_t attr;
 } trace_region_def_t;
 
+/* Allocate and free region definitions, accounting for the memory they hold */
+static trace_region_def_t *region_alloc(void) {
+  trace_region_def_t *region = malloc(sizeof(*region));
+  if (region != NULL) {
+    otter_mem_alloc(otter_mem_region_def, sizeof(*region));
+  }
+  return region;
+}
+
+static void region_free(trace_region_def_t *region) {
+  otter_mem_free(otter_mem_region_def, sizeof(*region));
+  free(region);
+}
+
 // Constructors
 
 trace_region_def_t *trace_new_master_region(unique_id_t thread_id,
                                             unique_id_t encountering_task_id) {
-  trace_region_def_t *new = malloc(sizeof(*new));
+  trace_region_def_t *new = region_alloc();
   *new = (trace_region_def_t){.ref = get_unique_rgn_ref(),
                               .role = OTF2_REGION_ROLE_MASTER,
                               .type = trace_region_master,
@@ -45,7 +63,7 @@ trace_region_def_t *
 trace_new_parallel_region(unique_id_t id, unique_id_t master,
                           unique_id_t encountering_task_id, int flags,
                           unsigned int requested_parallelism) {
-  trace_region_def_t *new = malloc(sizeof(*new));
+  trace_region_def_t *new = region_alloc();
   *new = (trace_region_def_t){
       .ref = get_unique_rgn_ref(),
       .role = OTF2_REGION_ROLE_PARALLEL,
@@ -67,7 +85,7 @@ trace_new_parallel_region(unique_id_t id, unique_id_t master,
 trace_region_def_t *trace_new_phase_region(otter_phase_region_t type,
                                            unique_id_t encountering_task_id,
                                            const char *phase_name) {
-  trace_region_def_t *new = malloc(sizeof(*new));
+  trace_region_def_t *new = region_alloc();
   *new = (trace_region_def_t){.ref = get_unique_rgn_ref(),
                               .role = OTF2_REGION_ROLE_CODE,
                               .type = trace_region_phase,
@@ -76,10 +94,7 @@ trace_region_def_t *trace_new_phase_region(otter_phase_region_t type,
                               .attr.phase = {.type = type, .name = 0}};
 
   if (phase_name != NULL) {
-    pthread_mutex_lock(&state.strings.lock);
-    new->attr.phase.name =
-        string_registry_insert(state.strings.instance, phase_name);
-    pthread_mutex_unlock(&state.strings.lock);
+    new->attr.phase.name = get_string_ref(phase_name);
   } else {
     new->attr.phase.name = 0;
   }
@@ -89,7 +104,7 @@ trace_region_def_t *trace_new_phase_region(otter_phase_region_t type,
 trace_region_def_t *trace_new_sync_region(otter_sync_region_t stype,
                                           trace_task_sync_t task_sync_mode,
                                           unique_id_t encountering_task_id) {
-  trace_region_def_t *new = malloc(sizeof(*new));
+  trace_region_def_t *new = region_alloc();
   OTF2_RegionRole role = OTF2_REGION_ROLE_UNKNOWN;
   switch (stype) {
   case otter_sync_region_barrier:
@@ -104,6 +119,13 @@ trace_region_def_t *trace_new_sync_region(otter_sync_region_t stype,
   case otter_sync_region_barrier_implementation:
     role = OTF2_REGION_ROLE_BARRIER;
     break;
+  case otter_sync_region_barrier_implicit_workshare:
+  case otter_sync_region_barrier_implicit_parallel:
+    role = OTF2_REGION_ROLE_IMPLICIT_BARRIER;
+    break;
+  case otter_sync_region_barrier_teams:
+    role = OTF2_REGION_ROLE_BARRIER;
+    break;
   case otter_sync_region_taskwait:
     role = OTF2_REGION_ROLE_TASK_WAIT;
     break;
@@ -141,7 +163,7 @@ trace_new_task_region(trace_region_def_t *parent_task_region, unique_id_t id,
   LOG_DEBUG_IF((src_location), "got src_location(file=%s, func=%s, line=%d)",
                src_location->file, src_location->func, src_location->line);
 
-  trace_region_def_t *new = malloc(sizeof(*new));
+  trace_region_def_t *new = region_alloc();
   *new = (trace_region_def_t){
       .ref = get_unique_rgn_ref(),
       .role = OTF2_REGION_ROLE_TASK,
@@ -166,12 +188,9 @@ trace_new_task_region(trace_region_def_t *parent_task_region, unique_id_t id,
   new->encountering_task_id = new->attr.task.parent_id;
 
   if (src_location != NULL) {
-    pthread_mutex_lock(&state.strings.lock);
-    new->attr.task.source_file_name_ref =
-        string_registry_insert(state.strings.instance, src_location->file);
-    new->attr.task.source_func_name_ref =
-        string_registry_insert(state.strings.instance, src_location->func);
-    pthread_mutex_unlock(&state.strings.lock);
+    otter_src_ref_t ref = get_source_location_ref(*src_location);
+    new->attr.task.source_file_name_ref = ref.file;
+    new->attr.task.source_func_name_ref = ref.func;
     new->attr.task.source_line_number = src_location->line;
   } else {
     new->attr.task.source_file_name_ref = 0;
@@ -184,7 +203,7 @@ trace_new_task_region(trace_region_def_t *parent_task_region, unique_id_t id,
 trace_region_def_t *
 trace_new_workshare_region(otter_work_t wstype, uint64_t count,
                            unique_id_t encountering_task_id) {
-  trace_region_def_t *new = malloc(sizeof(*new));
+  trace_region_def_t *new = region_alloc();
   OTF2_RegionRole role = OTF2_REGION_ROLE_UNKNOWN;
   switch (wstype) {
   case otter_work_loop:
@@ -224,7 +243,7 @@ trace_new_workshare_region(otter_work_t wstype, uint64_t count,
 
 void trace_destroy_master_region(trace_region_def_t *rgn) {
   LOG_DEBUG("region %p", rgn);
-  free(rgn);
+  region_free(rgn);
 }
 
 void trace_destroy_parallel_region(trace_region_def_t *rgn) {
@@ -281,18 +300,18 @@ void trace_destroy_parallel_region(trace_region_def_t *rgn) {
      and all definitions written */
   queue_destroy(rgn->attr.parallel.rgn_defs, false, NULL);
   LOG_DEBUG("region %p (parallel id %lu)", rgn, rgn->attr.parallel.id);
-  free(rgn);
+  region_free(rgn);
   return;
 }
 
 void trace_destroy_phase_region(trace_region_def_t *rgn) {
   LOG_DEBUG("region %p", rgn);
-  free(rgn);
+  region_free(rgn);
 }
 
 void trace_destroy_sync_region(trace_region_def_t *rgn) {
   LOG_DEBUG("region %p", rgn);
-  free(rgn);
+  region_free(rgn);
 }
 
 void trace_destroy_task_region(trace_region_def_t *rgn) {
@@ -303,12 +322,12 @@ void trace_destroy_task_region(trace_region_def_t *rgn) {
             rgn->rgn_stack);
   stack_destroy(rgn->rgn_stack, false, NULL);
   LOG_DEBUG("region %p", rgn);
-  free(rgn);
+  region_free(rgn);
 }
 
 void trace_destroy_workshare_region(trace_region_def_t *rgn) {
   LOG_DEBUG("region %p", rgn);
-  free(rgn);
+  region_free(rgn);
 }
 
 // Add attributes
@@ -386,6 +405,11 @@ void trace_add_sync_attributes(trace_region_def_t *rgn,
   r = OTF2_AttributeList_AddUint8(
       attributes, attr_sync_descendant_tasks,
       (uint8_t)(rgn->attr.sync.sync_descendant_tasks ? 1 : 0));
+  if (rgn->attr.sync.wait_time > 0) {
+    r = OTF2_AttributeList_AddUint64(attributes, attr_sync_wait_time,
+                                     rgn->attr.sync.wait_time);
+    CHECK_OTF2_ERROR_CODE(r);
+  }
   return;
 }
 
@@ -503,6 +527,29 @@ void trace_region_set_task_status(trace_region_def_t *region,
   region->attr.task.task_status = status;
 }
 
+void trace_region_set_task_create_time(trace_region_def_t *region,
+                                       uint64_t time) {
+  assert(region->type == trace_region_task);
+  region->attr.task.create_time = time;
+}
+
+void trace_region_set_task_start_time(trace_region_def_t *region,
+                                      uint64_t time) {
+  assert(region->type == trace_region_task);
+  region->attr.task.start_time = time;
+}
+
+void trace_region_set_task_expanded(trace_region_def_t *region) {
+  assert(region->type == trace_region_task);
+  region->attr.task.expanded = true;
+}
+
+void trace_region_add_sync_wait_time(trace_region_def_t *region,
+                                     uint64_t time) {
+  assert(region->type == trace_region_synchronise);
+  region->attr.sync.wait_time += time;
+}
+
 // Lock and unlock shared regions
 
 bool trace_region_is_type(trace_region_def_t *region,
@@ -545,6 +592,7 @@ void trace_region_write_definition(trace_region_def_t *region) {
   LOG_DEBUG("writing region definition %3u (type=%3d, role=%3u) %p",
             region->ref, region->type, region->role, region);
 
+  uint64_t self_profile_begin = trace_self_profile_begin();
   pthread_mutex_lock(&state.global_def_writer.lock);
   OTF2_GlobalDefWriter *writer = state.global_def_writer.instance;
 
@@ -615,5 +663,6 @@ void trace_region_write_definition(trace_region_def_t *region) {
   }
   }
   pthread_mutex_unlock(&state.global_def_writer.lock);
+  trace_self_profile_end(trace_self_def_write, self_profile_begin);
   return;
 }
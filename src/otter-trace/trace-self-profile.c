@@ -0,0 +1,138 @@
+/**
+ * @file trace-self-profile.c
+ * @author Adam Tuft
+ * @brief Implementation of Otter's self-profiling counters. Each thread counts
+ * calls to and time spent in each stage in its own table, so measurement takes
+ * no locks. The tables are summed once at finalisation.
+ * @version 0.1
+ * @date 2023-05-10
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <inttypes.h>
+#include <otf2/otf2.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "public/debug.h"
+#include "public/otter-trace/trace-self-profile.h"
+#include "public/threads.h"
+#include "public/types/queue.h"
+
+#include "trace-check-error-code.h"
+#include "trace-state.h"
+#include "trace-timestamp.h"
+
+typedef struct self_profile_counters_t {
+  uint64_t calls[trace_self_n_stages];
+  uint64_t time[trace_self_n_stages];
+} self_profile_counters_t;
+
+/* Property name and description of each stage */
+static const struct {
+  const char *name;
+  const char *desc;
+} stage_info[trace_self_n_stages] = {
+    [trace_self_source_location_ref] = {"SOURCE_LOCATION_REF",
+                                        "source location refs"},
+    [trace_self_string_ref] = {"STRING_REF", "string refs"},
+    [trace_self_task_manager_wait] = {"TASK_MANAGER_WAIT",
+                                      "task manager lock waits"},
+    [trace_self_event_write] = {"EVENT_WRITE", "event writes"},
+    [trace_self_flush] = {"FLUSH", "buffer flushes"},
+    [trace_self_def_write] = {"DEF_WRITE", "definition writes"},
+};
+
+static bool enabled = false;
+
+// per-thread counters
+static thread_local self_profile_counters_t *thread_counters = NULL;
+
+// store per-thread counters for summing at finalisation
+static struct {
+  otter_queue_t *instance;
+  pthread_mutex_t lock;
+} counters_queue = {.instance = NULL, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+static inline self_profile_counters_t *get_thread_counters(void) {
+  if (thread_counters == NULL) {
+    thread_counters = calloc(1, sizeof(*thread_counters));
+    if (thread_counters == NULL) {
+      LOG_ERROR("failed to allocate self-profile counters");
+      return NULL;
+    }
+    pthread_mutex_lock(&counters_queue.lock);
+    if (counters_queue.instance == NULL) {
+      counters_queue.instance = queue_create();
+    }
+    queue_push(counters_queue.instance, (data_item_t){.ptr = thread_counters});
+    pthread_mutex_unlock(&counters_queue.lock);
+  }
+  return thread_counters;
+}
+
+void trace_self_profile_configure(const otter_opt_t *opt) {
+  enabled = opt->self_profile;
+}
+
+uint64_t trace_self_profile_begin(void) {
+  return enabled ? get_timestamp() : 0;
+}
+
+void trace_self_profile_end(trace_self_stage_t stage, uint64_t begin) {
+  if (begin == 0) {
+    return;
+  }
+  self_profile_counters_t *counters = get_thread_counters();
+  if (counters == NULL) {
+    return;
+  }
+  counters->calls[stage]++;
+  counters->time[stage] += get_timestamp() - begin;
+}
+
+void trace_self_profile_finalise(void) {
+  if (!enabled) {
+    return;
+  }
+  LOG_DEBUG("=== Writing self-profile ===");
+
+  self_profile_counters_t total = {0};
+  pthread_mutex_lock(&counters_queue.lock);
+  self_profile_counters_t *counters = NULL;
+  while (queue_pop(counters_queue.instance, (data_item_t *)&counters)) {
+    for (int stage = 0; stage < trace_self_n_stages; stage++) {
+      total.calls[stage] += counters->calls[stage];
+      total.time[stage] += counters->time[stage];
+    }
+    free(counters);
+  }
+  queue_destroy(counters_queue.instance, false, NULL);
+  counters_queue.instance = NULL;
+  pthread_mutex_unlock(&counters_queue.lock);
+  thread_counters = NULL;
+  enabled = false;
+
+  fprintf(stderr, "\nOTTER SELF-PROFILE:\n");
+  for (int stage = 0; stage < trace_self_n_stages; stage++) {
+    fprintf(stderr, "%35s: %8" PRIu64 " calls %12" PRIu64 " ns\n",
+            stage_info[stage].desc, total.calls[stage], total.time[stage]);
+
+    char name[64] = {0};
+    char value[32] = {0};
+    OTF2_ErrorCode err = OTF2_SUCCESS;
+    snprintf(name, sizeof(name), "OTTER::SELF_PROFILE::%s_CALLS",
+             stage_info[stage].name);
+    snprintf(value, sizeof(value), "%" PRIu64, total.calls[stage]);
+    err = OTF2_Archive_SetProperty(state.archive.instance, name, value, true);
+    CHECK_OTF2_ERROR_CODE(err);
+    snprintf(name, sizeof(name), "OTTER::SELF_PROFILE::%s_NS",
+             stage_info[stage].name);
+    snprintf(value, sizeof(value), "%" PRIu64, total.time[stage]);
+    err = OTF2_Archive_SetProperty(state.archive.instance, name, value, true);
+    CHECK_OTF2_ERROR_CODE(err);
+  }
+}
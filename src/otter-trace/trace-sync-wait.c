@@ -0,0 +1,284 @@
+/**
+ * @file trace-sync-wait.c
+ * @brief Implementation of sync-region wait recording. A runtime may execute
+ * tasks while a thread waits, so each thread pauses its present wait when it
+ * switches away from the task which encountered the sync region and resumes it
+ * when it switches back. A task executed while its thread waits may itself
+ * wait, so each thread keeps a stack of its active waits.
+ * @version 0.1
+ * @date 2023-05-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <otf2/otf2.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "public/debug.h"
+#include "public/otter-trace/trace-cpu.h"
+#include "public/otter-trace/trace-region-def.h"
+#include "public/otter-trace/trace-self-profile.h"
+#include "public/otter-trace/trace-sync-wait.h"
+#include "public/threads.h"
+
+#include "trace-archive-impl.h"
+#include "trace-attribute-lookup.h"
+#include "trace-attributes.h"
+#include "trace-check-error-code.h"
+#include "trace-state.h"
+#include "trace-timestamp.h"
+#include "trace-types-as-labels.h"
+#include "trace-unique-refs.h"
+
+enum {
+  sync_wait_n_types = otter_sync_region_barrier_teams + 1,
+  sync_wait_max_depth = 16
+};
+
+static const char *sync_wait_names[sync_wait_n_types] = {
+    [otter_sync_region_barrier] = "barrier",
+    [otter_sync_region_barrier_implicit] = "implicit barrier",
+    [otter_sync_region_barrier_explicit] = "explicit barrier",
+    [otter_sync_region_barrier_implementation] = "implementation barrier",
+    [otter_sync_region_taskwait] = "taskwait",
+    [otter_sync_region_taskgroup] = "taskgroup",
+    [otter_sync_region_reduction] = "reduction",
+    [otter_sync_region_barrier_implicit_workshare] =
+        "implicit workshare barrier",
+    [otter_sync_region_barrier_implicit_parallel] = "implicit parallel barrier",
+    [otter_sync_region_barrier_teams] = "teams barrier",
+};
+
+typedef struct sync_wait_t {
+  bool paused;
+  otter_sync_region_t type;
+  unique_id_t task_id;
+  uint64_t resumed;
+  uint64_t wait_time;
+} sync_wait_t;
+
+typedef struct sync_wait_thread_t {
+  int depth; // number of active waits, including any too deep to record
+  sync_wait_t waits[sync_wait_max_depth]; // innermost wait at depth-1
+  bool any;
+  uint64_t totals[sync_wait_n_types];
+} sync_wait_thread_t;
+
+static bool enabled = false;
+static otter_sync_wait_mode_t mode = otter_sync_wait_events;
+static OTF2_RegionRef wait_regions[sync_wait_n_types];
+static OTF2_MetricRef metric_class = OTF2_UNDEFINED_METRIC;
+static thread_local sync_wait_thread_t sync_wait = {0};
+
+void trace_sync_wait_configure(const otter_opt_t *opt) {
+  if (!(opt->ompt_categories & otter_ompt_category_sync_wait)) {
+    return;
+  }
+  enabled = true;
+  mode = opt->sync_wait_mode;
+
+  OTF2_ErrorCode err = OTF2_SUCCESS;
+  char name[64] = {0};
+
+  pthread_mutex_lock(&state.global_def_writer.lock);
+  OTF2_GlobalDefWriter *writer = state.global_def_writer.instance;
+  if (mode == otter_sync_wait_events) {
+    for (int type = 1; type < sync_wait_n_types; type++) {
+      snprintf(name, sizeof(name), "%s wait", sync_wait_names[type]);
+      OTF2_StringRef name_ref = get_unique_str_ref();
+      trace_archive_write_string_ref(writer, name_ref, name);
+      wait_regions[type] = get_unique_rgn_ref();
+      err = OTF2_GlobalDefWriter_WriteRegion(
+          writer, wait_regions[type], name_ref, 0, 0, OTF2_REGION_ROLE_UNKNOWN,
+          OTF2_PARADIGM_UNKNOWN, OTF2_REGION_FLAG_NONE, 0, 0, 0);
+      CHECK_OTF2_ERROR_CODE(err);
+    }
+  } else if (mode == otter_sync_wait_total) {
+    OTF2_MetricMemberRef members[sync_wait_n_types - 1];
+    OTF2_StringRef unit = get_unique_str_ref();
+    trace_archive_write_string_ref(writer, unit, "ns");
+    for (int type = 1; type < sync_wait_n_types; type++) {
+      snprintf(name, sizeof(name), "OTTER::SYNC_WAIT::%s",
+               sync_wait_names[type]);
+      OTF2_StringRef name_ref = get_unique_str_ref();
+      trace_archive_write_string_ref(writer, name_ref, name);
+      members[type - 1] = get_unique_metric_member_ref();
+      err = OTF2_GlobalDefWriter_WriteMetricMember(
+          writer, members[type - 1], name_ref, name_ref,
+          OTF2_METRIC_TYPE_OTHER, OTF2_METRIC_ABSOLUTE_POINT, OTF2_TYPE_UINT64,
+          OTF2_BASE_DECIMAL, 0, unit);
+      CHECK_OTF2_ERROR_CODE(err);
+    }
+    metric_class = get_unique_metric_ref();
+    err = OTF2_GlobalDefWriter_WriteMetricClass(
+        writer, metric_class, sync_wait_n_types - 1, members,
+        OTF2_METRIC_ASYNCHRONOUS, OTF2_RECORDER_KIND_ABSTRACT);
+    CHECK_OTF2_ERROR_CODE(err);
+  }
+  pthread_mutex_unlock(&state.global_def_writer.lock);
+
+  err = OTF2_Archive_SetProperty(state.archive.instance,
+                                 "OTTER::SYNC_WAIT_MODE",
+                                 mode == otter_sync_wait_events ? "events"
+                                 : mode == otter_sync_wait_fold ? "fold"
+                                                                : "total",
+                                 true);
+  CHECK_OTF2_ERROR_CODE(err);
+}
+
+/* Write the enter or leave event of a wait region */
+static void write_wait_event(trace_location_def_t *location,
+                             const sync_wait_t *wait, bool enter) {
+  OTF2_ErrorCode err = OTF2_SUCCESS;
+  OTF2_AttributeList *attributes = NULL;
+  OTF2_EvtWriter *evt_writer = NULL;
+  trace_location_get_otf2(location, &attributes, &evt_writer, NULL);
+
+  err = OTF2_AttributeList_AddInt32(attributes, attr_cpu, trace_cpu_current());
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddUint64(attributes, attr_encountering_task_id,
+                                     wait->task_id);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddStringRef(
+      attributes, attr_event_type,
+      attr_label_ref[enter ? attr_event_type_sync_wait_begin
+                           : attr_event_type_sync_wait_end]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddStringRef(
+      attributes, attr_endpoint,
+      attr_label_ref[enter ? attr_endpoint_enter : attr_endpoint_leave]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddStringRef(
+      attributes, attr_sync_type,
+      attr_label_ref[sync_type_as_label(wait->type)]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  if (!enter) {
+    err = OTF2_AttributeList_AddUint64(attributes, attr_sync_wait_time,
+                                       wait->wait_time);
+    CHECK_OTF2_ERROR_CODE(err);
+  }
+
+  uint64_t self_profile_begin = trace_self_profile_begin();
+  if (enter) {
+    err = OTF2_EvtWriter_Enter(evt_writer, attributes, get_timestamp(),
+                               wait_regions[wait->type]);
+  } else {
+    err = OTF2_EvtWriter_Leave(evt_writer, attributes, get_timestamp(),
+                               wait_regions[wait->type]);
+  }
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  trace_location_inc_event_count(location);
+}
+
+void trace_sync_wait_begin(trace_location_def_t *location,
+                           otter_sync_region_t type, unique_id_t task_id) {
+  if (type < otter_sync_region_barrier ||
+      type > otter_sync_region_barrier_teams) {
+    LOG_DEBUG("ignoring wait in sync region of type %d", type);
+    return;
+  }
+  if (sync_wait.depth++ >= sync_wait_max_depth) {
+    LOG_WARN("ignoring wait nested %d deep in sync region of type %d",
+             sync_wait.depth, type);
+    return;
+  }
+  sync_wait_t *wait = &sync_wait.waits[sync_wait.depth - 1];
+  wait->paused = false;
+  wait->type = type;
+  wait->task_id = task_id;
+  wait->wait_time = 0;
+  wait->resumed = get_timestamp();
+  if (mode == otter_sync_wait_events) {
+    write_wait_event(location, wait, true);
+  }
+}
+
+void trace_sync_wait_end(trace_location_def_t *location) {
+  if (sync_wait.depth == 0) {
+    return;
+  }
+  if (sync_wait.depth-- > sync_wait_max_depth) {
+    return;
+  }
+  sync_wait_t *wait = &sync_wait.waits[sync_wait.depth];
+  if (!wait->paused) {
+    wait->wait_time += get_timestamp() - wait->resumed;
+  }
+
+  switch (mode) {
+  case otter_sync_wait_events:
+    write_wait_event(location, wait, false);
+    break;
+  case otter_sync_wait_fold: {
+    trace_region_def_t *region = trace_location_get_active_region(location);
+    if (region != NULL &&
+        trace_region_is_type(region, trace_region_synchronise)) {
+      trace_region_add_sync_wait_time(region, wait->wait_time);
+    }
+    break;
+  }
+  case otter_sync_wait_total:
+    sync_wait.totals[wait->type] += wait->wait_time;
+    sync_wait.any = true;
+    break;
+  }
+}
+
+void trace_sync_wait_task_switch(unique_id_t prior_task_id,
+                                 unique_id_t next_task_id) {
+  if (!enabled || sync_wait.depth == 0) {
+    return;
+  }
+  // every active wait belongs to a different task, so at most one pauses and
+  // at most one resumes
+  int depth = sync_wait.depth < sync_wait_max_depth ? sync_wait.depth
+                                                    : sync_wait_max_depth;
+  uint64_t now = get_timestamp();
+  for (int k = 0; k < depth; k++) {
+    sync_wait_t *wait = &sync_wait.waits[k];
+    if (!wait->paused && prior_task_id == wait->task_id) {
+      wait->wait_time += now - wait->resumed;
+      wait->paused = true;
+    } else if (wait->paused && next_task_id == wait->task_id) {
+      wait->resumed = now;
+      wait->paused = false;
+    }
+  }
+}
+
+void trace_sync_wait_thread_end(trace_location_def_t *location) {
+  if (mode != otter_sync_wait_total || !sync_wait.any) {
+    return;
+  }
+
+  OTF2_EvtWriter *event_writer = NULL;
+  OTF2_Type types[sync_wait_n_types - 1];
+  OTF2_MetricValue values[sync_wait_n_types - 1];
+  for (int type = 1; type < sync_wait_n_types; type++) {
+    types[type - 1] = OTF2_TYPE_UINT64;
+    values[type - 1].unsigned_int = sync_wait.totals[type];
+  }
+
+  trace_location_get_otf2(location, NULL, &event_writer, NULL);
+
+  uint64_t self_profile_begin = trace_self_profile_begin();
+  OTF2_ErrorCode err = OTF2_EvtWriter_Metric(
+      event_writer, NULL, get_timestamp(), metric_class, sync_wait_n_types - 1,
+      types, values);
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
+  CHECK_OTF2_ERROR_CODE(err);
+  trace_location_inc_event_count(location);
+
+  memset(&sync_wait, 0, sizeof(sync_wait));
+}
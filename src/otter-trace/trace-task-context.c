@@ -13,6 +13,7 @@
 #include "public/otter-common.h"
 #include "public/otter-trace/trace-task-context-interface.h"
 #include "public/otter-version.h"
+#include "public/types/memory-accounting.h"
 #include <assert.h>
 #include <limits.h>
 #include <otf2/otf2.h>
@@ -27,39 +28,119 @@ struct otter_task_context {
   uint64_t task_create_time;
   uint64_t task_start_time;
   uint64_t task_end_time;
+  uint64_t task_suspend_time;
+  uint64_t task_wait_time;
   int flavour;
   otter_src_ref_t init_location;
+  otter_src_ref_t create_location;
+  otter_src_ref_t start_location;
   otter_string_ref_t label;
+  otter_label_args_t label_args;
+  uint64_t num_children;
+  int deferred_events;
+  bool profile_only;
+  otter_task_metrics_t *metrics;
+  void *current_stack; // the stack of current tasks holding the task, if any
+  uint32_t refs; // one until the task ends, plus one per entry in any stack
 };
 
 otter_task_context *otterTaskContext_alloc(void) {
   otter_task_context *task = malloc(sizeof(otter_task_context));
+  if (task != NULL) {
+    otter_mem_alloc(otter_mem_task_context, sizeof(otter_task_context));
+  }
   LOG_DEBUG("allocate task context %p", task);
   return task;
 }
 
 static unique_id_t unique_id = 0;
 
-void otterTaskContext_init(otter_task_context *task, otter_task_context *parent,
-                           int flavour, otter_src_ref_t init_location) {
+/* Initialise every field of a task context other than its parent's child
+   count, which the callers update once for all the tasks they initialise */
+static void task_context_init_fields(otter_task_context *task, unique_id_t id,
+                                     otter_task_context *parent, int flavour,
+                                     otter_src_ref_t init_location) {
   assert(task != NULL);
-  task->task_context_id = __sync_fetch_and_add(&unique_id, 1L);
+  task->task_context_id = id;
+  task->parent_task_context_id =
+      parent == NULL ? TASK_ID_UNDEFINED : parent->task_context_id;
   task->flavour = flavour;
   task->init_location = init_location;
   task->label = OTTER_STRING_UNDEFINED;
-  if (parent == NULL) {
-    task->parent_task_context_id = TASK_ID_UNDEFINED;
-  } else {
-    task->parent_task_context_id = parent->task_context_id;
+  task->label_args.count = 0;
+  task->task_create_time = 0;
+  task->task_start_time = 0;
+  task->task_end_time = 0;
+  task->task_suspend_time = 0;
+  task->task_wait_time = 0;
+  task->create_location = (otter_src_ref_t){0, 0, 0};
+  task->start_location = (otter_src_ref_t){0, 0, 0};
+  task->num_children = 0;
+  task->deferred_events = otter_deferred_none;
+  task->profile_only = false;
+  task->metrics = NULL;
+  task->current_stack = NULL;
+  task->refs = 1;
+}
+
+void otterTaskContext_init(otter_task_context *task, otter_task_context *parent,
+                           int flavour, otter_src_ref_t init_location) {
+  task_context_init_fields(task, __sync_fetch_and_add(&unique_id, 1L), parent,
+                           flavour, init_location);
+  if (parent != NULL) {
+    __sync_fetch_and_add(&parent->num_children, 1);
   }
   LOG_DEBUG("initialised task context %p: %lu", task, task->task_context_id);
 }
 
+void otterTaskContext_init_range(otter_task_context **tasks, int n,
+                                 otter_task_context *parent, int flavour,
+                                 otter_src_ref_t init_location) {
+  assert(tasks != NULL && n > 0);
+  unique_id_t first_id = __sync_fetch_and_add(&unique_id, (unique_id_t)n);
+  for (int k = 0; k < n; k++) {
+    task_context_init_fields(tasks[k], first_id + k, parent, flavour,
+                             init_location);
+  }
+  if (parent != NULL) {
+    __sync_fetch_and_add(&parent->num_children, (uint64_t)n);
+  }
+  LOG_DEBUG("initialised task contexts %lu to %lu", first_id, first_id + n - 1);
+}
+
 void otterTaskContext_delete(otter_task_context *const task) {
   LOG_DEBUG("delete task context %p: %lu", task, task->task_context_id);
+  if (task->metrics != NULL) {
+    otter_mem_free(otter_mem_task_context, sizeof(otter_task_metrics_t));
+    free(task->metrics);
+  }
+  otter_mem_free(otter_mem_task_context, sizeof(otter_task_context));
   free(task);
 }
 
+void otterTaskContext_retain(otter_task_context *task) {
+  if (task == NULL)
+    return;
+  __atomic_add_fetch(&task->refs, 1, __ATOMIC_RELAXED);
+}
+
+bool otterTaskContext_release(otter_task_context *task) {
+  if (task == NULL)
+    return false;
+  if (__atomic_sub_fetch(&task->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+    return false;
+  }
+  otterTaskContext_delete(task);
+  return true;
+}
+
+void *otterTaskContext_exchange_current_stack(otter_task_context *task,
+                                              void *stack) {
+  if (task == NULL)
+    return NULL;
+  return __atomic_exchange_n(&task->current_stack, stack, __ATOMIC_ACQ_REL);
+}
+
 // Getters
 
 unique_id_t
@@ -94,9 +175,174 @@ otterTaskContext_get_task_label_ref(const otter_task_context *task) {
   return task == NULL ? OTTER_STRING_UNDEFINED : task->label;
 }
 
+const otter_label_args_t *
+otterTaskContext_get_task_label_args(const otter_task_context *task) {
+  return task == NULL || task->label_args.count == 0 ? NULL
+                                                     : &task->label_args;
+}
+
+const otter_task_metrics_t *
+otterTaskContext_get_metrics(const otter_task_context *task) {
+  return task == NULL ? NULL
+                      : __atomic_load_n(&task->metrics, __ATOMIC_ACQUIRE);
+}
+
+uint64_t otterTaskContext_get_task_create_time(const otter_task_context *task) {
+  return task == NULL ? 0 : task->task_create_time;
+}
+
+uint64_t otterTaskContext_get_task_start_time(const otter_task_context *task) {
+  return task == NULL ? 0 : task->task_start_time;
+}
+
+uint64_t otterTaskContext_get_task_end_time(const otter_task_context *task) {
+  return task == NULL ? 0 : task->task_end_time;
+}
+
+uint64_t otterTaskContext_get_task_wait_time(const otter_task_context *task) {
+  return task == NULL ? 0 : task->task_wait_time;
+}
+
+bool otterTaskContext_is_suspended(const otter_task_context *task) {
+  return task != NULL && task->task_suspend_time != 0;
+}
+
+void *otterTaskContext_get_current_stack(const otter_task_context *task) {
+  if (task == NULL)
+    return NULL;
+  return __atomic_load_n(&task->current_stack, __ATOMIC_ACQUIRE);
+}
+
+bool otterTaskContext_is_profile_only(const otter_task_context *task) {
+  return task != NULL && task->profile_only;
+}
+
+otter_src_ref_t
+otterTaskContext_get_create_location_ref(const otter_task_context *task) {
+  return task == NULL ? (otter_src_ref_t){0, 0, 0} : task->create_location;
+}
+
+otter_src_ref_t
+otterTaskContext_get_start_location_ref(const otter_task_context *task) {
+  return task == NULL ? (otter_src_ref_t){0, 0, 0} : task->start_location;
+}
+
+uint64_t otterTaskContext_get_num_children(const otter_task_context *task) {
+  return task == NULL ? 0 : task->num_children;
+}
+
+int otterTaskContext_get_deferred_events(const otter_task_context *task) {
+  if (task == NULL)
+    return otter_deferred_none;
+  return __atomic_load_n(&task->deferred_events, __ATOMIC_ACQUIRE);
+}
+
+int otterTaskContext_take_deferred_events(otter_task_context *task,
+                                          int events) {
+  if (task == NULL)
+    return otter_deferred_none;
+  return __sync_fetch_and_and(&task->deferred_events, ~events) & events;
+}
+
+bool otterTaskContext_discard_deferred_events(otter_task_context *task,
+                                              int events) {
+  return task != NULL &&
+         __sync_bool_compare_and_swap(&task->deferred_events, events,
+                                      otter_deferred_none);
+}
+
+// Setters
+
 void otterTaskContext_set_task_label_ref(otter_task_context *task,
                                          otter_string_ref_t label) {
   LOG_DEBUG("otterTaskContext_set_task_label_ref %p", task);
   if (task != NULL)
     task->label = label;
 }
+
+void otterTaskContext_set_task_label_args(otter_task_context *task,
+                                          const otter_label_args_t *args) {
+  if (task != NULL)
+    task->label_args = *args;
+}
+
+void otterTaskContext_add_metric(otter_task_context *task, int metric_id,
+                                 uint64_t value) {
+  if (task == NULL)
+    return;
+  otter_task_metrics_t *metrics =
+      __atomic_load_n(&task->metrics, __ATOMIC_ACQUIRE);
+  if (metrics == NULL) {
+    // allocated on first use, as most tasks have no metrics
+    otter_task_metrics_t *fresh = calloc(1, sizeof(otter_task_metrics_t));
+    if (fresh == NULL) {
+      LOG_ERROR("failed to allocate metrics of task %lu",
+                task->task_context_id);
+      return;
+    }
+    if (__atomic_compare_exchange_n(&task->metrics, &metrics, fresh, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      otter_mem_alloc(otter_mem_task_context, sizeof(otter_task_metrics_t));
+      metrics = fresh;
+    } else {
+      free(fresh); // another thread got there first
+    }
+  }
+  __atomic_fetch_add(&metrics->values[metric_id], value, __ATOMIC_RELAXED);
+  __atomic_fetch_or(&metrics->set, 1u << metric_id, __ATOMIC_RELAXED);
+}
+
+void otterTaskContext_set_task_create_time(otter_task_context *task,
+                                           uint64_t time) {
+  if (task != NULL)
+    task->task_create_time = time;
+}
+
+void otterTaskContext_set_task_start_time(otter_task_context *task,
+                                          uint64_t time) {
+  if (task != NULL)
+    task->task_start_time = time;
+}
+
+void otterTaskContext_set_task_end_time(otter_task_context *task,
+                                        uint64_t time) {
+  if (task != NULL)
+    task->task_end_time = time;
+}
+
+bool otterTaskContext_suspend(otter_task_context *task, uint64_t time) {
+  if (task == NULL || task->task_suspend_time != 0)
+    return false;
+  task->task_suspend_time = time;
+  return true;
+}
+
+bool otterTaskContext_resume(otter_task_context *task, uint64_t time) {
+  if (task == NULL || task->task_suspend_time == 0)
+    return false;
+  task->task_wait_time += time - task->task_suspend_time;
+  task->task_suspend_time = 0;
+  return true;
+}
+
+void otterTaskContext_set_create_location_ref(otter_task_context *task,
+                                             otter_src_ref_t location) {
+  if (task != NULL)
+    task->create_location = location;
+}
+
+void otterTaskContext_set_start_location_ref(otter_task_context *task,
+                                            otter_src_ref_t location) {
+  if (task != NULL)
+    task->start_location = location;
+}
+
+void otterTaskContext_set_profile_only(otter_task_context *task) {
+  if (task != NULL)
+    task->profile_only = true;
+}
+
+void otterTaskContext_defer_events(otter_task_context *task, int events) {
+  if (task != NULL)
+    __sync_fetch_and_or(&task->deferred_events, events);
+}
@@ -1,5 +1,6 @@
 #include "public/otter-trace/trace-task-data.h"
 #include "trace-get-unique-id.h"
+#include <otf2/otf2.h>
 #include <stdlib.h>
 typedef struct task_data_t {
   unique_id_t id;
@@ -29,10 +30,19 @@ void task_destroy(task_data_t *task_data) {
   return;
 }
 
-unique_id_t trace_task_get_id(task_data_t *task) { return task->id; }
+void trace_task_destroy_region(task_data_t *task_data) {
+  trace_destroy_task_region(task_data->region);
+  task_data->region = NULL;
+}
+
+/* task is NULL for explicit tasks when the task-create callback is not
+   requested (see OTTER_OMPT_CATEGORIES) */
+unique_id_t trace_task_get_id(task_data_t *task) {
+  return task ? task->id : OTF2_UNDEFINED_UINT64;
+}
 
 trace_region_def_t *trace_task_get_region_def(task_data_t *task) {
-  return task->region;
+  return task ? task->region : NULL;
 }
 
 otter_task_flag_t trace_task_get_flags(task_data_t *task) {
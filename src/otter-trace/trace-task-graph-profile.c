@@ -0,0 +1,410 @@
+/**
+ * @file trace-task-graph-profile.c
+ * @author Adam Tuft
+ * @brief Lock-free per-thread aggregation of task statistics for the
+ * otter-task-graph profile mode. Each thread accumulates into its own table
+ * keyed by (label, flavour). The tables are merged once at finalisation and
+ * written to a summary file.
+ * @version 0.1
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "public/debug.h"
+#include "public/otter-trace/trace-task-context-interface.h"
+#include "public/otter-trace/trace-task-graph-profile.h"
+#include "public/otter-trace/trace-task-metric.h"
+#include "public/threads.h"
+#include "public/types/queue.h"
+
+#include "trace-state.h"
+#include "trace-timestamp.h"
+
+enum {
+  profile_hist_buckets = 32,   // bucket k counts durations in [2^k, 2^(k+1)) ns
+  profile_table_init_sz = 64,  // must be a power of 2
+  profile_path_buff_sz = 1024,
+};
+
+typedef struct profile_stats_t {
+  uint64_t count;
+  uint64_t exec_total;
+  uint64_t exec_min;
+  uint64_t exec_max;
+  uint64_t latency_count;
+  uint64_t latency_total;
+  uint64_t latency_min;
+  uint64_t latency_max;
+  uint64_t wait_total;
+  uint64_t hist[profile_hist_buckets];
+  uint64_t metric_total[OTTER_TASK_MAX_METRICS];
+} profile_stats_t;
+
+typedef struct profile_entry_t {
+  bool used;
+  otter_string_ref_t label;
+  int flavour;
+  profile_stats_t stats;
+} profile_entry_t;
+
+typedef struct profile_table_t {
+  size_t capacity;
+  size_t length;
+  profile_entry_t *entries;
+} profile_table_t;
+
+// per-thread statistics
+static thread_local profile_table_t *thread_table = NULL;
+
+// incremented whenever the per-thread tables are merged and freed, so that a
+// thread whose table was freed allocates a new one rather than using it
+static unsigned table_generation = 0;
+static thread_local unsigned thread_table_generation = 0;
+
+// store per-thread tables for merging at finalisation
+static struct {
+  otter_queue_t *instance;
+  pthread_mutex_t lock;
+} table_queue = {.instance = NULL, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+static profile_table_t *profile_table_new(size_t capacity) {
+  profile_table_t *table = malloc(sizeof(*table));
+  if (table == NULL) {
+    LOG_ERROR("failed to allocate profile table");
+    return NULL;
+  }
+  table->capacity = capacity;
+  table->length = 0;
+  table->entries = calloc(capacity, sizeof(*table->entries));
+  if (table->entries == NULL) {
+    LOG_ERROR("failed to allocate %zu profile table entries", capacity);
+    free(table);
+    return NULL;
+  }
+  return table;
+}
+
+static void profile_table_delete(void *table) {
+  if (table == NULL)
+    return;
+  free(((profile_table_t *)table)->entries);
+  free(table);
+}
+
+static inline size_t profile_hash(otter_string_ref_t label, int flavour) {
+  uint64_t key = ((uint64_t)label << 32) | (uint32_t)flavour;
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return (size_t)key;
+}
+
+static profile_entry_t *profile_table_find(profile_table_t *table,
+                                           otter_string_ref_t label,
+                                           int flavour);
+
+static bool profile_table_grow(profile_table_t *table) {
+  size_t capacity = table->capacity * 2;
+  profile_entry_t *entries = calloc(capacity, sizeof(*entries));
+  if (entries == NULL) {
+    LOG_ERROR("failed to grow profile table to %zu entries", capacity);
+    return false;
+  }
+  profile_entry_t *old_entries = table->entries;
+  size_t old_capacity = table->capacity;
+  table->entries = entries;
+  table->capacity = capacity;
+  table->length = 0;
+  for (size_t k = 0; k < old_capacity; k++) {
+    if (old_entries[k].used) {
+      profile_entry_t *entry = profile_table_find(table, old_entries[k].label,
+                                                  old_entries[k].flavour);
+      entry->stats = old_entries[k].stats;
+    }
+  }
+  free(old_entries);
+  return true;
+}
+
+/* Get the entry for (label, flavour), inserting an empty one if not present */
+static profile_entry_t *profile_table_find(profile_table_t *table,
+                                           otter_string_ref_t label,
+                                           int flavour) {
+  if (2 * (table->length + 1) > table->capacity) {
+    if (!profile_table_grow(table)) {
+      return NULL;
+    }
+  }
+  size_t mask = table->capacity - 1;
+  size_t k = profile_hash(label, flavour) & mask;
+  while (table->entries[k].used) {
+    if (table->entries[k].label == label &&
+        table->entries[k].flavour == flavour) {
+      return &table->entries[k];
+    }
+    k = (k + 1) & mask;
+  }
+  profile_entry_t *entry = &table->entries[k];
+  entry->used = true;
+  entry->label = label;
+  entry->flavour = flavour;
+  entry->stats.exec_min = UINT64_MAX;
+  entry->stats.latency_min = UINT64_MAX;
+  table->length++;
+  return entry;
+}
+
+static inline int profile_hist_bucket(uint64_t duration) {
+  int bucket = duration == 0 ? 0 : 63 - __builtin_clzll(duration);
+  return bucket < profile_hist_buckets ? bucket : profile_hist_buckets - 1;
+}
+
+static void profile_stats_merge(profile_stats_t *into,
+                                const profile_stats_t *from) {
+  into->count += from->count;
+  into->exec_total += from->exec_total;
+  if (from->exec_min < into->exec_min)
+    into->exec_min = from->exec_min;
+  if (from->exec_max > into->exec_max)
+    into->exec_max = from->exec_max;
+  into->latency_count += from->latency_count;
+  into->latency_total += from->latency_total;
+  if (from->latency_min < into->latency_min)
+    into->latency_min = from->latency_min;
+  if (from->latency_max > into->latency_max)
+    into->latency_max = from->latency_max;
+  into->wait_total += from->wait_total;
+  for (int k = 0; k < profile_hist_buckets; k++) {
+    into->hist[k] += from->hist[k];
+  }
+  for (int k = 0; k < OTTER_TASK_MAX_METRICS; k++) {
+    into->metric_total[k] += from->metric_total[k];
+  }
+}
+
+static inline profile_table_t *get_thread_table(void) {
+  if (thread_table != NULL &&
+      thread_table_generation !=
+          __atomic_load_n(&table_generation, __ATOMIC_ACQUIRE)) {
+    // freed by trace_profile_write_summary()
+    thread_table = NULL;
+  }
+  if (thread_table == NULL) {
+    thread_table = profile_table_new(profile_table_init_sz);
+    if (thread_table == NULL) {
+      return NULL;
+    }
+    pthread_mutex_lock(&table_queue.lock);
+    if (table_queue.instance == NULL) {
+      table_queue.instance = queue_create();
+    }
+    queue_push(table_queue.instance, (data_item_t){.ptr = thread_table});
+    thread_table_generation = table_generation;
+    pthread_mutex_unlock(&table_queue.lock);
+  }
+  return thread_table;
+}
+
+void trace_profile_task_create(otter_task_context *task) {
+  otterTaskContext_set_task_create_time(task, get_timestamp());
+}
+
+void trace_profile_task_start(otter_task_context *task) {
+  otterTaskContext_set_task_start_time(task, get_timestamp());
+}
+
+void trace_profile_task_end(otter_task_context *task) {
+  if (task == NULL) {
+    return;
+  }
+  uint64_t end_time = get_timestamp();
+  otterTaskContext_set_task_end_time(task, end_time);
+  uint64_t create_time = otterTaskContext_get_task_create_time(task);
+  uint64_t start_time = otterTaskContext_get_task_start_time(task);
+  if (start_time == 0) {
+    LOG_WARN("task %lu ended without being started - ignored",
+             otterTaskContext_get_task_context_id(task));
+    return;
+  }
+
+  profile_table_t *table = get_thread_table();
+  if (table == NULL) {
+    return;
+  }
+  profile_entry_t *entry =
+      profile_table_find(table, otterTaskContext_get_task_label_ref(task),
+                         otterTaskContext_get_task_flavour(task));
+  if (entry == NULL) {
+    return;
+  }
+
+  // time spent suspended is not counted as execution time
+  profile_stats_t *stats = &entry->stats;
+  uint64_t wait = otterTaskContext_get_task_wait_time(task);
+  uint64_t exec = end_time - start_time - wait;
+  stats->wait_total += wait;
+  stats->count++;
+  stats->exec_total += exec;
+  if (exec < stats->exec_min)
+    stats->exec_min = exec;
+  if (exec > stats->exec_max)
+    stats->exec_max = exec;
+  stats->hist[profile_hist_bucket(exec)]++;
+
+  const otter_task_metrics_t *metrics = otterTaskContext_get_metrics(task);
+  if (metrics != NULL) {
+    for (int k = 0; k < OTTER_TASK_MAX_METRICS; k++) {
+      stats->metric_total[k] += metrics->values[k];
+    }
+  }
+
+  // latency is only known for tasks with a recorded create time
+  if (create_time != 0 && create_time <= start_time) {
+    uint64_t latency = start_time - create_time;
+    stats->latency_count++;
+    stats->latency_total += latency;
+    if (latency < stats->latency_min)
+      stats->latency_min = latency;
+    if (latency > stats->latency_max)
+      stats->latency_max = latency;
+  }
+}
+
+typedef struct label_lookup_t {
+  const char **names;
+  otter_string_ref_t max_ref;
+} label_lookup_t;
+
+static void lookup_label_cbk(const char *s, otter_string_ref_t ref,
+                             void *data) {
+  label_lookup_t *lookup = (label_lookup_t *)data;
+  if (ref <= lookup->max_ref) {
+    lookup->names[ref] = s;
+  }
+}
+
+/* Write a CSV field, quoting it and doubling any embedded quotes */
+static void write_csv_string(FILE *file, const char *s) {
+  fputc('"', file);
+  for (; s != NULL && *s != '\0'; s++) {
+    if (*s == '"')
+      fputc('"', file);
+    fputc(*s, file);
+  }
+  fputc('"', file);
+}
+
+bool trace_profile_write_summary(const otter_opt_t *opt) {
+  LOG_DEBUG("=== Writing task-graph profile ===");
+
+  // merge the per-thread tables
+  profile_table_t *merged = profile_table_new(profile_table_init_sz);
+  if (merged == NULL) {
+    return false;
+  }
+  pthread_mutex_lock(&table_queue.lock);
+  profile_table_t *table = NULL;
+  while (queue_pop(table_queue.instance, (data_item_t *)&table)) {
+    for (size_t k = 0; k < table->capacity; k++) {
+      profile_entry_t *from = &table->entries[k];
+      if (!from->used)
+        continue;
+      profile_entry_t *into =
+          profile_table_find(merged, from->label, from->flavour);
+      if (into != NULL)
+        profile_stats_merge(&into->stats, &from->stats);
+    }
+    profile_table_delete(table);
+  }
+  queue_destroy(table_queue.instance, false, NULL);
+  table_queue.instance = NULL;
+  __atomic_add_fetch(&table_generation, 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&table_queue.lock);
+  thread_table = NULL;
+
+  // resolve the label refs used into strings
+  label_lookup_t lookup = {.names = NULL, .max_ref = 0};
+  for (size_t k = 0; k < merged->capacity; k++) {
+    if (merged->entries[k].used && merged->entries[k].label > lookup.max_ref)
+      lookup.max_ref = merged->entries[k].label;
+  }
+  lookup.names = calloc((size_t)lookup.max_ref + 1, sizeof(*lookup.names));
+  if (lookup.names == NULL) {
+    LOG_ERROR("failed to allocate label lookup");
+    profile_table_delete(merged);
+    return false;
+  }
+  pthread_mutex_lock(&state.strings.lock);
+  string_registry_apply(state.strings.instance, lookup_label_cbk, &lookup);
+
+  char path[profile_path_buff_sz] = {0};
+  snprintf(path, profile_path_buff_sz, "%s/%s/profile.csv", opt->tracepath,
+           opt->archive_name);
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    LOG_ERROR("Error opening file %s: %s", path, strerror(errno));
+  } else {
+    fprintf(file, "label,flavour,count,exec_total_ns,exec_min_ns,exec_max_ns,"
+                  "latency_count,latency_total_ns,latency_min_ns,"
+                  "latency_max_ns,wait_total_ns,exec_log2_hist,"
+                  "metric_totals\n");
+    for (size_t k = 0; k < merged->capacity; k++) {
+      profile_entry_t *entry = &merged->entries[k];
+      if (!entry->used)
+        continue;
+      profile_stats_t *stats = &entry->stats;
+      if (lookup.names[entry->label] != NULL) {
+        write_csv_string(file, lookup.names[entry->label]);
+      } else {
+        // evicted from a bounded string registry: give the ref of its
+        // definition in the trace instead
+        fprintf(file, "\"#%" PRIu32 "\"", entry->label);
+      }
+      fprintf(file,
+              ",%d,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+              ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",",
+              entry->flavour, stats->count, stats->exec_total,
+              stats->count ? stats->exec_min : 0, stats->exec_max,
+              stats->latency_count, stats->latency_total,
+              stats->latency_count ? stats->latency_min : 0,
+              stats->latency_max, stats->wait_total);
+      // histogram as space-separated "bucket:count" pairs for non-empty buckets
+      const char *sep = "";
+      for (int b = 0; b < profile_hist_buckets; b++) {
+        if (stats->hist[b] != 0) {
+          fprintf(file, "%s%d:%" PRIu64, sep, b, stats->hist[b]);
+          sep = " ";
+        }
+      }
+      // metric totals as space-separated "name:total" pairs
+      fputc(',', file);
+      sep = "";
+      for (int m = 0; m < OTTER_TASK_MAX_METRICS; m++) {
+        const char *name = trace_task_metric_name(m);
+        if (name != NULL) {
+          fprintf(file, "%s%s:%" PRIu64, sep, name, stats->metric_total[m]);
+          sep = " ";
+        }
+      }
+      fputc('\n', file);
+    }
+    fclose(file);
+    fprintf(stderr, "%s%s\n", "OTTER_PROFILE_SUMMARY:", path);
+  }
+  pthread_mutex_unlock(&state.strings.lock);
+
+  free(lookup.names);
+  profile_table_delete(merged);
+  return file != NULL;
+}
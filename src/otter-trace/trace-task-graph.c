@@ -12,14 +12,23 @@
 #include <execinfo.h>
 #include <otf2/otf2.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "public/debug.h"
 #include "public/otter-common.h"
 #include "public/otter-environment-variables.h"
+#include "public/otter-trace/trace-dependence.h"
+#include "public/otter-trace/trace-governor.h"
+#include "public/otter-trace/trace-memory.h"
+#include "public/otter-trace/trace-self-profile.h"
 #include "public/otter-trace/trace-task-context-interface.h"
 #include "public/otter-trace/trace-task-graph.h"
+#include "public/otter-trace/trace-task-metric.h"
 #include "public/otter-trace/trace-thread-data.h"
+#include "public/threads.h"
 #include "public/types/queue.h"
 
 #include "trace-archive-impl.h"
@@ -35,6 +44,204 @@
 
 enum { void_ptr_top_6_bytes_mask = 0xffffffffffff0000 };
 
+/* A run of short leaf tasks with the same parent which completed on the same
+   thread, recorded as a single event when the run ends */
+typedef struct coalesced_tasks_t {
+  trace_location_def_t *location;
+  unique_id_t parent_id;
+  uint64_t count;
+  uint64_t total_time;
+  uint64_t last_end_time;
+} coalesced_tasks_t;
+
+/* A task-create or task-start event deferred in case its task is coalesced */
+typedef struct deferred_event_t {
+  otter_task_context *task;
+  otter_deferred_event_t event;
+  uint64_t time;
+} deferred_event_t;
+
+/* The events of a thread not yet written to its location: its run of
+   coalesced tasks, and the task events it deferred in the order they happened.
+   These are written before any later event of the thread so that its
+   location's timestamps never go backwards */
+typedef struct pending_events_t {
+  trace_location_def_t *location;
+  coalesced_tasks_t run;
+  size_t count;
+  size_t capacity;
+  deferred_event_t *deferred;
+} pending_events_t;
+
+// a thread's deferred events are all written once it holds this many
+enum { deferred_events_initial_capacity = 64, deferred_events_max = 1024 };
+
+// the pending events of this thread
+static thread_local pending_events_t *pending = NULL;
+
+// store per-thread pending events so any left at finalisation can be recorded
+static struct {
+  otter_queue_t *instance;
+  pthread_mutex_t lock;
+} pending_queue = {.instance = NULL, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+static void write_task_create(trace_location_def_t *location,
+                              unique_id_t encountering_task_id,
+                              unique_id_t new_task_id,
+                              otter_string_ref_t task_label,
+                              const otter_label_args_t *label_args,
+                              otter_src_ref_t create_ref, uint64_t time);
+static void write_task_switch(trace_location_def_t *location,
+                              unique_id_t encountering_task_id,
+                              attr_label_enum_t event_type,
+                              attr_label_enum_t endpoint, otter_src_ref_t ref,
+                              uint64_t time);
+static void trace_graph_write_coalesced_tasks(coalesced_tasks_t *run);
+
+static pending_events_t *get_pending_events(void) {
+  if (pending == NULL) {
+    pending = calloc(1, sizeof(*pending));
+    if (pending == NULL) {
+      LOG_ERROR("failed to allocate pending events");
+      return NULL;
+    }
+    pthread_mutex_lock(&pending_queue.lock);
+    if (pending_queue.instance == NULL) {
+      pending_queue.instance = queue_create();
+    }
+    queue_push(pending_queue.instance, (data_item_t){.ptr = pending});
+    pthread_mutex_unlock(&pending_queue.lock);
+  }
+  return pending;
+}
+
+/* Write a deferred event unless it was discarded when its task was coalesced,
+   and release the reference to its task */
+static void write_deferred_event(trace_location_def_t *location,
+                                 const deferred_event_t *deferred) {
+  otter_task_context *task = deferred->task;
+  if (otterTaskContext_take_deferred_events(task, deferred->event) != 0) {
+    unique_id_t task_id = otterTaskContext_get_task_context_id(task);
+    if (deferred->event == otter_deferred_create) {
+      write_task_create(location,
+                        otterTaskContext_get_parent_task_context_id(task),
+                        task_id, otterTaskContext_get_task_label_ref(task),
+                        otterTaskContext_get_task_label_args(task),
+                        otterTaskContext_get_create_location_ref(task),
+                        deferred->time);
+    } else {
+      write_task_switch(location, task_id, attr_event_type_task_enter,
+                        attr_endpoint_enter,
+                        otterTaskContext_get_start_location_ref(task),
+                        deferred->time);
+    }
+  }
+  otterTaskContext_release(task);
+}
+
+/* Write the deferred events of a thread which happened no later than `time` */
+static void flush_deferred_events(pending_events_t *events, uint64_t time) {
+  size_t k = 0;
+  while (k < events->count && events->deferred[k].time <= time) {
+    write_deferred_event(events->location, &events->deferred[k]);
+    k++;
+  }
+  if (k > 0) {
+    events->count -= k;
+    memmove(&events->deferred[0], &events->deferred[k],
+            events->count * sizeof(*events->deferred));
+  }
+}
+
+/* Write all of a thread's pending events, interleaving its run of coalesced
+   tasks with its deferred events by time */
+static void flush_pending_events(pending_events_t *events) {
+  if (events->run.count > 0) {
+    flush_deferred_events(events, events->run.last_end_time);
+    trace_graph_write_coalesced_tasks(&events->run);
+  }
+  flush_deferred_events(events, UINT64_MAX);
+}
+
+/* Whether the outcome of a deferred event is known: either it was discarded
+   when its task was coalesced (or was recorded by another thread), or its task
+   may not be coalesced, as it was marked to be kept or has ended without being
+   coalesced */
+static bool is_settled(const deferred_event_t *deferred) {
+  int events = otterTaskContext_get_deferred_events(deferred->task);
+  return !(events & deferred->event) || (events & otter_deferred_keep);
+}
+
+/* Write the oldest of a thread's deferred events up to the first whose outcome
+   is not yet known, so that a thread which defers many events for tasks run by
+   other threads releases them promptly. Any run of coalesced tasks which ended
+   before an event written is written first */
+static void flush_settled_events(pending_events_t *events) {
+  size_t k = 0;
+  while (k < events->count && is_settled(&events->deferred[k])) {
+    if (events->run.count > 0 &&
+        events->run.last_end_time < events->deferred[k].time) {
+      trace_graph_write_coalesced_tasks(&events->run);
+    }
+    write_deferred_event(events->location, &events->deferred[k]);
+    k++;
+  }
+  if (k > 0) {
+    events->count -= k;
+    memmove(&events->deferred[0], &events->deferred[k],
+            events->count * sizeof(*events->deferred));
+  }
+}
+
+/* Record this thread's pending events (if any) so that they precede any other
+   event recorded by this thread */
+static inline void flush_this_thread(void) {
+  if (pending != NULL) {
+    flush_pending_events(pending);
+  }
+}
+
+/* Make room for one more deferred event, first dropping those discarded since
+   they were deferred so that coalesced tasks are released promptly. Once
+   `deferred_events_max` are held, write them all rather than grow further */
+static bool reserve_deferred_event(pending_events_t *events) {
+  flush_settled_events(events);
+  if (events->count < events->capacity) {
+    return true;
+  }
+  size_t kept = 0;
+  for (size_t k = 0; k < events->count; k++) {
+    deferred_event_t *deferred = &events->deferred[k];
+    if (otterTaskContext_get_deferred_events(deferred->task) &
+        deferred->event) {
+      events->deferred[kept++] = *deferred;
+    } else {
+      otterTaskContext_release(deferred->task);
+    }
+  }
+  events->count = kept;
+  if (kept < events->capacity / 2) {
+    return true;
+  }
+  if (events->capacity >= deferred_events_max) {
+    flush_pending_events(events);
+    return true;
+  }
+  size_t capacity = events->capacity == 0 ? deferred_events_initial_capacity
+                                          : 2 * events->capacity;
+  deferred_event_t *deferred =
+      realloc(events->deferred, capacity * sizeof(*deferred));
+  if (deferred == NULL) {
+    LOG_ERROR("failed to allocate deferred events");
+    return false;
+  }
+  events->deferred = deferred;
+  events->capacity = capacity;
+  return true;
+}
+
+uint64_t trace_graph_get_timestamp(void) { return get_timestamp(); }
+
 static inline void *get_user_code_return_address(void) {
   /**
    * @brief Get the apparent return address of the code which called into
@@ -66,13 +273,40 @@ static inline void *get_user_code_return_address(void) {
   return NULL;
 }
 
+/* Add the arguments of a structured label, if any, to an attribute list */
+static void add_label_args(OTF2_AttributeList *attr,
+                           const otter_label_args_t *label_args) {
+  if (label_args == NULL || label_args->count == 0) {
+    return;
+  }
+  OTF2_ErrorCode err = OTF2_AttributeList_AddUint8(
+      attr, attr_task_label_arg_count, label_args->count);
+  CHECK_OTF2_ERROR_CODE(err);
+  for (uint8_t k = 0; k < label_args->count; k++) {
+    err = OTF2_AttributeList_AddUint64(attr, attr_task_label_arg_0 + k,
+                                       label_args->values[k]);
+    CHECK_OTF2_ERROR_CODE(err);
+  }
+}
+
 void trace_graph_event_task_create(trace_location_def_t *location,
                                    unique_id_t encountering_task_id,
                                    unique_id_t new_task_id,
                                    otter_string_ref_t task_label,
-                                   otter_src_ref_t create_ref) {
+                                   const otter_label_args_t *label_args,
+                                   otter_src_ref_t create_ref, uint64_t time) {
   LOG_DEBUG("record task-graph event: task create");
+  flush_this_thread();
+  write_task_create(location, encountering_task_id, new_task_id, task_label,
+                    label_args, create_ref, time);
+}
 
+static void write_task_create(trace_location_def_t *location,
+                              unique_id_t encountering_task_id,
+                              unique_id_t new_task_id,
+                              otter_string_ref_t task_label,
+                              const otter_label_args_t *label_args,
+                              otter_src_ref_t create_ref, uint64_t time) {
   OTF2_ErrorCode err = OTF2_SUCCESS;
   OTF2_AttributeList *attr = OTF2_AttributeList_New();
   OTF2_EvtWriter *event_writer = NULL;
@@ -104,33 +338,37 @@ void trace_graph_event_task_create(trace_location_def_t *location,
   err = OTF2_AttributeList_AddStringRef(attr, attr_task_label, task_label);
   CHECK_OTF2_ERROR_CODE(err);
 
+  add_label_args(attr, label_args);
+
   err = OTF2_AttributeList_AddStringRef(
       attr, attr_event_type, attr_label_ref[attr_event_type_task_create]);
   CHECK_OTF2_ERROR_CODE(err);
 
-  err = OTF2_EvtWriter_ThreadTaskCreate(event_writer, attr, get_timestamp(),
+  uint64_t self_profile_begin = trace_self_profile_begin();
+  err = OTF2_EvtWriter_ThreadTaskCreate(event_writer, attr, time,
                                         OTF2_UNDEFINED_COMM,
                                         OTF2_UNDEFINED_UINT32, 0);
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
   CHECK_OTF2_ERROR_CODE(err);
 
   OTF2_AttributeList_Delete(attr);
 }
 
 /**
- * @brief Record a task-enter event with these attributes:
- *  - encountering task (the task entered)
- *  - event type i.e. task-enter
- *  - endpoint i.e. enter
- *  - source location
- *
- * @param location
- * @param encountering_task_id
- * @param start_ref
+ * @brief Record the creation of `count` sibling tasks with consecutive IDs
+ * from `first_task_id` as a single task-create event. Its attributes are those
+ * of a task-create event for the first task, with the number of tasks created.
  */
-void trace_graph_event_task_begin(trace_location_def_t *location,
-                                  unique_id_t encountering_task_id,
-                                  otter_src_ref_t start_ref) {
-  LOG_DEBUG("record task-graph event: task begin");
+void trace_graph_event_task_create_range(trace_location_def_t *location,
+                                         unique_id_t encountering_task_id,
+                                         unique_id_t first_task_id,
+                                         uint64_t count,
+                                         otter_string_ref_t task_label,
+                                         const otter_label_args_t *label_args,
+                                         otter_src_ref_t create_ref,
+                                         uint64_t time) {
+  LOG_DEBUG("record task-graph event: task create range (%lu tasks)", count);
+  flush_this_thread();
 
   OTF2_ErrorCode err = OTF2_SUCCESS;
   OTF2_AttributeList *attr = OTF2_AttributeList_New();
@@ -142,48 +380,58 @@ void trace_graph_event_task_begin(trace_location_def_t *location,
                                      encountering_task_id);
   CHECK_OTF2_ERROR_CODE(err);
 
-  err = OTF2_AttributeList_AddStringRef(
-      attr, attr_event_type, attr_label_ref[attr_event_type_task_enter]);
+  err = OTF2_AttributeList_AddUint64(attr, attr_unique_id, first_task_id);
   CHECK_OTF2_ERROR_CODE(err);
 
-  err = OTF2_AttributeList_AddStringRef(attr, attr_endpoint,
-                                        attr_label_ref[attr_endpoint_enter]);
+  err = OTF2_AttributeList_AddUint64(attr, attr_task_range_count, count);
   CHECK_OTF2_ERROR_CODE(err);
 
-  err = OTF2_AttributeList_AddStringRef(attr, attr_source_file, start_ref.file);
+  err =
+      OTF2_AttributeList_AddStringRef(attr, attr_source_file, create_ref.file);
   CHECK_OTF2_ERROR_CODE(err);
 
-  err = OTF2_AttributeList_AddStringRef(attr, attr_source_func, start_ref.func);
+  err =
+      OTF2_AttributeList_AddStringRef(attr, attr_source_func, create_ref.func);
   CHECK_OTF2_ERROR_CODE(err);
 
-  err = OTF2_AttributeList_AddInt32(attr, attr_source_line, start_ref.line);
+  err = OTF2_AttributeList_AddInt32(attr, attr_source_line, create_ref.line);
   CHECK_OTF2_ERROR_CODE(err);
 
-  // Record event
-  err = OTF2_EvtWriter_ThreadTaskSwitch(
-      event_writer, attr, get_timestamp(), OTF2_UNDEFINED_COMM,
-      OTF2_UNDEFINED_UINT32, 0); /* creating thread, generation number */
+  err = OTF2_AttributeList_AddStringRef(attr, attr_endpoint,
+                                        attr_label_ref[attr_endpoint_discrete]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddStringRef(attr, attr_task_label, task_label);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  add_label_args(attr, label_args);
+
+  err = OTF2_AttributeList_AddStringRef(
+      attr, attr_event_type, attr_label_ref[attr_event_type_task_create_range]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  uint64_t self_profile_begin = trace_self_profile_begin();
+  err = OTF2_EvtWriter_ThreadTaskCreate(event_writer, attr, time,
+                                        OTF2_UNDEFINED_COMM,
+                                        OTF2_UNDEFINED_UINT32, 0);
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
   CHECK_OTF2_ERROR_CODE(err);
 
   OTF2_AttributeList_Delete(attr);
 }
 
 /**
- * @brief Record a task-complete event with these attributes:
- *  - encountering task (the task completed)
- *  - event type i.e. task-complete
- *  - endpoint i.e. leave
+ * @brief Record a task-switch event for the given task with these attributes:
+ *  - encountering task (the task entered or left)
+ *  - event type
+ *  - endpoint i.e. enter/leave
  *  - source location
- *
- * @param location
- * @param encountering_task_id
- * @param end_ref
  */
-void trace_graph_event_task_end(trace_location_def_t *location,
-                                unique_id_t encountering_task_id,
-                                otter_src_ref_t end_ref) {
-  LOG_DEBUG("record task-graph event: task leave");
-
+static void write_task_switch(trace_location_def_t *location,
+                              unique_id_t encountering_task_id,
+                              attr_label_enum_t event_type,
+                              attr_label_enum_t endpoint, otter_src_ref_t ref,
+                              uint64_t time) {
   OTF2_ErrorCode err = OTF2_SUCCESS;
   OTF2_AttributeList *attr = OTF2_AttributeList_New();
   OTF2_EvtWriter *event_writer = NULL;
@@ -194,30 +442,106 @@ void trace_graph_event_task_end(trace_location_def_t *location,
                                      encountering_task_id);
   CHECK_OTF2_ERROR_CODE(err);
 
-  err = OTF2_AttributeList_AddStringRef(
-      attr, attr_event_type, attr_label_ref[attr_event_type_task_leave]);
+  err = OTF2_AttributeList_AddStringRef(attr, attr_event_type,
+                                        attr_label_ref[event_type]);
   CHECK_OTF2_ERROR_CODE(err);
 
-  OTF2_AttributeList_AddStringRef(attr, attr_endpoint,
-                                  attr_label_ref[attr_endpoint_leave]);
+  err = OTF2_AttributeList_AddStringRef(attr, attr_endpoint,
+                                        attr_label_ref[endpoint]);
+  CHECK_OTF2_ERROR_CODE(err);
 
-  err = OTF2_AttributeList_AddStringRef(attr, attr_source_file, end_ref.file);
+  err = OTF2_AttributeList_AddStringRef(attr, attr_source_file, ref.file);
   CHECK_OTF2_ERROR_CODE(err);
 
-  err = OTF2_AttributeList_AddStringRef(attr, attr_source_func, end_ref.func);
+  err = OTF2_AttributeList_AddStringRef(attr, attr_source_func, ref.func);
   CHECK_OTF2_ERROR_CODE(err);
 
-  err = OTF2_AttributeList_AddInt32(attr, attr_source_line, end_ref.line);
+  err = OTF2_AttributeList_AddInt32(attr, attr_source_line, ref.line);
   CHECK_OTF2_ERROR_CODE(err);
 
+  // Record event
+  uint64_t self_profile_begin = trace_self_profile_begin();
   err = OTF2_EvtWriter_ThreadTaskSwitch(
-      event_writer, attr, get_timestamp(), OTF2_UNDEFINED_COMM,
+      event_writer, attr, time, OTF2_UNDEFINED_COMM,
       OTF2_UNDEFINED_UINT32, 0); /* creating thread, generation number */
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
   CHECK_OTF2_ERROR_CODE(err);
 
   OTF2_AttributeList_Delete(attr);
 }
 
+/**
+ * @brief Record a task-enter event with these attributes:
+ *  - encountering task (the task entered)
+ *  - event type i.e. task-enter
+ *  - endpoint i.e. enter
+ *  - source location
+ *
+ * @param location
+ * @param encountering_task_id
+ * @param start_ref
+ * @param time
+ */
+void trace_graph_event_task_begin(trace_location_def_t *location,
+                                  unique_id_t encountering_task_id,
+                                  otter_src_ref_t start_ref, uint64_t time) {
+  LOG_DEBUG("record task-graph event: task begin");
+  flush_this_thread();
+  write_task_switch(location, encountering_task_id, attr_event_type_task_enter,
+                    attr_endpoint_enter, start_ref, time);
+}
+
+/**
+ * @brief Record a task-complete event with these attributes:
+ *  - encountering task (the task completed)
+ *  - event type i.e. task-complete
+ *  - endpoint i.e. leave
+ *  - source location
+ *
+ * @param location
+ * @param encountering_task_id
+ * @param end_ref
+ * @param time
+ */
+void trace_graph_event_task_end(trace_location_def_t *location,
+                                unique_id_t encountering_task_id,
+                                otter_src_ref_t end_ref, uint64_t time) {
+  LOG_DEBUG("record task-graph event: task leave");
+  flush_this_thread();
+  write_task_switch(location, encountering_task_id, attr_event_type_task_leave,
+                    attr_endpoint_leave, end_ref, time);
+}
+
+/**
+ * @brief Record that a task was suspended i.e. it stopped executing without
+ * completing. The event has the same attributes as a task-complete event,
+ * with event type task-suspend.
+ */
+void trace_graph_event_task_suspend(trace_location_def_t *location,
+                                    unique_id_t encountering_task_id,
+                                    otter_src_ref_t suspend_ref,
+                                    uint64_t time) {
+  LOG_DEBUG("record task-graph event: task suspend");
+  flush_this_thread();
+  write_task_switch(location, encountering_task_id,
+                    attr_event_type_task_suspend, attr_endpoint_leave,
+                    suspend_ref, time);
+}
+
+/**
+ * @brief Record that a suspended task resumed executing. The event has the
+ * same attributes as a task-enter event, with event type task-resume.
+ */
+void trace_graph_event_task_resume(trace_location_def_t *location,
+                                   unique_id_t encountering_task_id,
+                                   otter_src_ref_t resume_ref, uint64_t time) {
+  LOG_DEBUG("record task-graph event: task resume");
+  flush_this_thread();
+  write_task_switch(location, encountering_task_id,
+                    attr_event_type_task_resume, attr_endpoint_enter,
+                    resume_ref, time);
+}
+
 /**
  * @brief Record a task-sync event with these attributes:
  *  - encountering task (the task which blocks on its dependencies)
@@ -232,6 +556,7 @@ void trace_graph_synchronise_tasks(trace_location_def_t *location,
                                    trace_sync_region_attr_t sync_attr,
                                    otter_endpoint_t endpoint) {
   LOG_DEBUG("record task-graph event: synchronise");
+  flush_this_thread();
 
   OTF2_ErrorCode err = OTF2_SUCCESS;
   OTF2_AttributeList *attr = OTF2_AttributeList_New();
@@ -274,6 +599,7 @@ void trace_graph_synchronise_tasks(trace_location_def_t *location,
                                     sync_attr.sync_descendant_tasks ? 1 : 0);
   CHECK_OTF2_ERROR_CODE(err);
 
+  uint64_t self_profile_begin = trace_self_profile_begin();
   switch (endpoint) {
   case otter_endpoint_enter:
   case otter_endpoint_discrete:
@@ -285,11 +611,178 @@ void trace_graph_synchronise_tasks(trace_location_def_t *location,
                                OTF2_UNDEFINED_REGION);
     break;
   }
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
   CHECK_OTF2_ERROR_CODE(err);
 
   OTF2_AttributeList_Delete(attr);
 }
 
+/**
+ * @brief Fold a completed task into this thread's run of coalesced tasks. The
+ * run is recorded as one event with these attributes when a task with a
+ * different parent is coalesced, when this thread records any other event, or
+ * at finalisation:
+ *  - encountering task (the parent of the coalesced tasks)
+ *  - event type i.e. task-coalesced
+ *  - endpoint i.e. discrete
+ *  - number of tasks coalesced
+ *  - total execution time of the tasks coalesced
+ *
+ * @param location
+ * @param parent_task_id
+ * @param duration
+ * @param end_time
+ */
+void trace_graph_event_task_coalesced(trace_location_def_t *location,
+                                      unique_id_t parent_task_id,
+                                      uint64_t duration, uint64_t end_time) {
+  pending_events_t *events = get_pending_events();
+  if (events == NULL) {
+    return;
+  }
+  coalesced_tasks_t *run = &events->run;
+  if (run->count > 0 &&
+      (run->parent_id != parent_task_id || run->location != location)) {
+    flush_deferred_events(events, run->last_end_time);
+    trace_graph_write_coalesced_tasks(run);
+  }
+  run->location = location;
+  run->parent_id = parent_task_id;
+  run->count++;
+  run->total_time += duration;
+  run->last_end_time = end_time;
+}
+
+/**
+ * @brief Defer a task-create or task-start event of a task which may yet be
+ * coalesced. The event is written on this thread's location, at its original
+ * time, before any later event of this thread, unless the task is coalesced
+ * first. Holds a reference to the task until then.
+ */
+void trace_graph_defer_task_event(trace_location_def_t *location,
+                                  otter_task_context *task,
+                                  otter_deferred_event_t event,
+                                  uint64_t time) {
+  pending_events_t *events = get_pending_events();
+  if (events == NULL || !reserve_deferred_event(events)) {
+    return;
+  }
+  if (events->location != location && events->count > 0) {
+    flush_deferred_events(events, UINT64_MAX);
+  }
+  events->location = location;
+  otterTaskContext_retain(task);
+  events->deferred[events->count++] =
+      (deferred_event_t){.task = task, .event = event, .time = time};
+}
+
+void trace_graph_flush_pending_events(void) { flush_this_thread(); }
+
+void trace_graph_flush_settled_events(void) {
+  if (pending != NULL && pending->count > 0) {
+    flush_settled_events(pending);
+  }
+}
+
+static void trace_graph_write_coalesced_tasks(coalesced_tasks_t *run) {
+  LOG_DEBUG("record task-graph event: %lu tasks coalesced", run->count);
+
+  OTF2_ErrorCode err = OTF2_SUCCESS;
+  OTF2_AttributeList *attr = OTF2_AttributeList_New();
+  OTF2_EvtWriter *event_writer = NULL;
+
+  trace_location_get_otf2(run->location, NULL, &event_writer, NULL);
+
+  err = OTF2_AttributeList_AddUint64(attr, attr_encountering_task_id,
+                                     run->parent_id);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddStringRef(
+      attr, attr_event_type, attr_label_ref[attr_event_type_task_coalesced]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddStringRef(attr, attr_endpoint,
+                                        attr_label_ref[attr_endpoint_discrete]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddUint64(attr, attr_coalesced_task_count,
+                                     run->count);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddUint64(attr, attr_coalesced_task_time,
+                                     run->total_time);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  uint64_t self_profile_begin = trace_self_profile_begin();
+  err = OTF2_EvtWriter_ThreadTaskComplete(event_writer, attr,
+                                          run->last_end_time,
+                                          OTF2_UNDEFINED_COMM,
+                                          OTF2_UNDEFINED_UINT32, 0);
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  OTF2_AttributeList_Delete(attr);
+
+  run->count = 0;
+  run->total_time = 0;
+}
+
+/**
+ * @brief Record an edge in the task dependency graph.
+ */
+void trace_graph_event_task_dependence(trace_location_def_t *location,
+                                       unique_id_t pred_task_id,
+                                       unique_id_t succ_task_id) {
+  LOG_DEBUG("record task-graph event: task dependence");
+  flush_this_thread();
+  trace_dependence_edge(location, pred_task_id, succ_task_id);
+}
+
+/**
+ * @brief Record a change in the sampling stride chosen by the overhead governor
+ * for this location.
+ */
+void trace_graph_event_sampling_stride(trace_location_def_t *location,
+                                       unsigned stride) {
+  LOG_DEBUG("record task-graph event: sampling stride %u", stride);
+  flush_this_thread();
+  trace_governor_write_stride(location, stride);
+}
+
+/**
+ * @brief Record a sample of the memory held by Otter on this location.
+ */
+void trace_graph_event_memory_sample(trace_location_def_t *location) {
+  LOG_DEBUG("record task-graph event: memory sample");
+  flush_this_thread();
+  trace_memory_write_sample(location);
+}
+
+/**
+ * @brief Record the metrics accumulated by a task.
+ */
+void trace_graph_event_task_metrics(trace_location_def_t *location,
+                                    unique_id_t task_id,
+                                    const otter_task_metrics_t *metrics,
+                                    uint64_t time) {
+  LOG_DEBUG("record task-graph event: task metrics");
+  flush_this_thread();
+  trace_task_metric_write(location, task_id, metrics, time);
+}
+
 void trace_task_graph_finalise(void) {
   LOG_DEBUG("=== Finalising trace-task-graph ===");
+
+  // record any events still pending on any thread
+  pthread_mutex_lock(&pending_queue.lock);
+  pending_events_t *events = NULL;
+  while (queue_pop(pending_queue.instance, (data_item_t *)&events)) {
+    flush_pending_events(events);
+    free(events->deferred);
+    free(events);
+  }
+  queue_destroy(pending_queue.instance, false, NULL);
+  pending_queue.instance = NULL;
+  pthread_mutex_unlock(&pending_queue.lock);
+  pending = NULL;
 }
@@ -0,0 +1,176 @@
+/**
+ * @file trace-task-metric.c
+ * @brief Implementation of user-defined per-task metrics. Metric members are
+ * written when each metric is defined, while a metric class is only needed
+ * for each combination of metrics actually recorded by a task, so these are
+ * defined lazily and cached.
+ * @version 0.1
+ * @date 2023-05-23
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <otf2/otf2.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "public/debug.h"
+#include "public/otter-trace/trace-self-profile.h"
+#include "public/otter-trace/trace-task-metric.h"
+
+#include "trace-archive-impl.h"
+#include "trace-attribute-lookup.h"
+#include "trace-attributes.h"
+#include "trace-check-error-code.h"
+#include "trace-state.h"
+#include "trace-unique-refs.h"
+
+enum {
+  metric_name_sz = 64,
+  metric_n_classes = 1 << OTTER_TASK_MAX_METRICS,
+};
+
+typedef struct task_metric_def_t {
+  char name[metric_name_sz];
+  OTF2_MetricMemberRef member;
+} task_metric_def_t;
+
+static struct {
+  pthread_mutex_t lock;
+  int count;
+  task_metric_def_t defs[OTTER_TASK_MAX_METRICS];
+} metrics = {.lock = PTHREAD_MUTEX_INITIALIZER, .count = 0};
+
+// metric class for each combination of metrics, indexed by the set bits of
+// otter_task_metrics_t
+static OTF2_MetricRef metric_classes[metric_n_classes] = {
+    [0 ... metric_n_classes - 1] = OTF2_UNDEFINED_METRIC};
+
+int trace_task_metric_define(const char *name, const char *unit) {
+  if (name == NULL) {
+    LOG_ERROR("metric name must not be null");
+    return -1;
+  }
+  pthread_mutex_lock(&metrics.lock);
+  for (int id = 0; id < metrics.count; id++) {
+    if (strncmp(metrics.defs[id].name, name, metric_name_sz - 1) == 0) {
+      pthread_mutex_unlock(&metrics.lock);
+      return id;
+    }
+  }
+  if (metrics.count == OTTER_TASK_MAX_METRICS) {
+    pthread_mutex_unlock(&metrics.lock);
+    LOG_ERROR("can't define metric \"%s\": at most %d metrics may be defined",
+              name, OTTER_TASK_MAX_METRICS);
+    return -1;
+  }
+  int id = metrics.count;
+  task_metric_def_t *def = &metrics.defs[id];
+  snprintf(def->name, metric_name_sz, "%s", name);
+
+  char member_name[metric_name_sz + 32] = {0};
+  snprintf(member_name, sizeof(member_name), "OTTER::TASK_METRIC::%s",
+           def->name);
+
+  pthread_mutex_lock(&state.global_def_writer.lock);
+  OTF2_GlobalDefWriter *writer = state.global_def_writer.instance;
+  OTF2_StringRef name_ref = get_unique_str_ref();
+  trace_archive_write_string_ref(writer, name_ref, member_name);
+  OTF2_StringRef unit_ref = get_unique_str_ref();
+  trace_archive_write_string_ref(writer, unit_ref, unit == NULL ? "" : unit);
+  def->member = get_unique_metric_member_ref();
+  OTF2_ErrorCode err = OTF2_GlobalDefWriter_WriteMetricMember(
+      writer, def->member, name_ref, name_ref, OTF2_METRIC_TYPE_USER,
+      OTF2_METRIC_ABSOLUTE_POINT, OTF2_TYPE_UINT64, OTF2_BASE_DECIMAL, 0,
+      unit_ref);
+  CHECK_OTF2_ERROR_CODE(err);
+  pthread_mutex_unlock(&state.global_def_writer.lock);
+
+  // publish the definition only once its member is written
+  __atomic_store_n(&metrics.count, id + 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&metrics.lock);
+  LOG_DEBUG("defined task metric %d: %s", id, def->name);
+  return id;
+}
+
+bool trace_task_metric_valid(int metric_id) {
+  return metric_id >= 0 &&
+         metric_id < __atomic_load_n(&metrics.count, __ATOMIC_ACQUIRE);
+}
+
+const char *trace_task_metric_name(int metric_id) {
+  return trace_task_metric_valid(metric_id) ? metrics.defs[metric_id].name
+                                            : NULL;
+}
+
+/* Get the metric class with one member per metric in `set`, defining it if
+   this is the first time this combination is written */
+static OTF2_MetricRef get_metric_class(uint32_t set) {
+  OTF2_MetricRef metric_class =
+      __atomic_load_n(&metric_classes[set], __ATOMIC_ACQUIRE);
+  if (metric_class != OTF2_UNDEFINED_METRIC) {
+    return metric_class;
+  }
+  pthread_mutex_lock(&state.global_def_writer.lock);
+  metric_class = metric_classes[set];
+  if (metric_class == OTF2_UNDEFINED_METRIC) {
+    OTF2_MetricMemberRef members[OTTER_TASK_MAX_METRICS];
+    uint8_t n = 0;
+    for (int id = 0; id < OTTER_TASK_MAX_METRICS; id++) {
+      if (set & (1u << id))
+        members[n++] = metrics.defs[id].member;
+    }
+    metric_class = get_unique_metric_ref();
+    OTF2_ErrorCode err = OTF2_GlobalDefWriter_WriteMetricClass(
+        state.global_def_writer.instance, metric_class, n, members,
+        OTF2_METRIC_ASYNCHRONOUS, OTF2_RECORDER_KIND_ABSTRACT);
+    CHECK_OTF2_ERROR_CODE(err);
+    __atomic_store_n(&metric_classes[set], metric_class, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&state.global_def_writer.lock);
+  return metric_class;
+}
+
+void trace_task_metric_write(trace_location_def_t *location,
+                             unique_id_t task_id,
+                             const otter_task_metrics_t *task_metrics,
+                             uint64_t time) {
+  if (task_metrics == NULL || task_metrics->set == 0) {
+    return;
+  }
+
+  OTF2_Type types[OTTER_TASK_MAX_METRICS];
+  OTF2_MetricValue values[OTTER_TASK_MAX_METRICS];
+  uint8_t n = 0;
+  for (int id = 0; id < OTTER_TASK_MAX_METRICS; id++) {
+    if (task_metrics->set & (1u << id)) {
+      types[n] = OTF2_TYPE_UINT64;
+      values[n].unsigned_int = task_metrics->values[id];
+      n++;
+    }
+  }
+  OTF2_MetricRef metric_class = get_metric_class(task_metrics->set);
+
+  OTF2_ErrorCode err = OTF2_SUCCESS;
+  OTF2_AttributeList *attributes = NULL;
+  OTF2_EvtWriter *evt_writer = NULL;
+  trace_location_get_otf2(location, &attributes, &evt_writer, NULL);
+
+  err = OTF2_AttributeList_AddUint64(attributes, attr_unique_id, task_id);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  err = OTF2_AttributeList_AddStringRef(
+      attributes, attr_event_type,
+      attr_label_ref[attr_event_type_task_metrics]);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  uint64_t self_profile_begin = trace_self_profile_begin();
+  err = OTF2_EvtWriter_Metric(evt_writer, attributes, time, metric_class, n,
+                              types, values);
+  trace_self_profile_end(trace_self_event_write, self_profile_begin);
+  CHECK_OTF2_ERROR_CODE(err);
+
+  trace_location_inc_event_count(location);
+}
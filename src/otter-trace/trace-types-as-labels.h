@@ -41,6 +41,35 @@ sync_type_as_label(otter_sync_region_t sync_type) {
     return attr_region_type_taskwait;
   case otter_sync_region_taskgroup:
     return attr_region_type_taskgroup;
+  case otter_sync_region_reduction:
+    return attr_region_type_reduction;
+  case otter_sync_region_barrier_implicit_workshare:
+    return attr_region_type_barrier_implicit_workshare;
+  case otter_sync_region_barrier_implicit_parallel:
+    return attr_region_type_barrier_implicit_parallel;
+  case otter_sync_region_barrier_teams:
+    return attr_region_type_barrier_teams;
+  default:
+    return attr_label_string_not_defined;
+  }
+}
+
+static inline attr_label_enum_t mutex_kind_as_label(otter_mutex_t kind) {
+  switch (kind) {
+  case otter_mutex_lock:
+    return attr_mutex_kind_lock;
+  case otter_mutex_test_lock:
+    return attr_mutex_kind_test_lock;
+  case otter_mutex_nest_lock:
+    return attr_mutex_kind_nest_lock;
+  case otter_mutex_test_nest_lock:
+    return attr_mutex_kind_test_nest_lock;
+  case otter_mutex_critical:
+    return attr_mutex_kind_critical;
+  case otter_mutex_atomic:
+    return attr_mutex_kind_atomic;
+  case otter_mutex_ordered:
+    return attr_mutex_kind_ordered;
   default:
     return attr_label_string_not_defined;
   }
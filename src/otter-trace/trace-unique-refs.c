@@ -6,6 +6,8 @@ typedef enum {
   trace_region,
   trace_string,
   trace_location,
+  trace_metric,
+  trace_metric_member,
   trace_other,
   NUM_REF_TYPES // NOTE: must be last enum label
 } trace_ref_type_t;
@@ -31,3 +33,11 @@ OTF2_StringRef get_unique_str_ref(void) {
 OTF2_LocationRef get_unique_loc_ref(void) {
   return (OTF2_LocationRef)get_unique_uint64_ref(trace_location);
 }
+
+OTF2_MetricRef get_unique_metric_ref(void) {
+  return (OTF2_MetricRef)get_unique_uint32_ref(trace_metric);
+}
+
+OTF2_MetricMemberRef get_unique_metric_member_ref(void) {
+  return (OTF2_MetricMemberRef)get_unique_uint32_ref(trace_metric_member);
+}
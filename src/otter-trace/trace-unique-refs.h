@@ -9,5 +9,7 @@
 OTF2_RegionRef get_unique_rgn_ref(void);
 OTF2_StringRef get_unique_str_ref(void);
 OTF2_LocationRef get_unique_loc_ref(void);
+OTF2_MetricRef get_unique_metric_ref(void);
+OTF2_MetricMemberRef get_unique_metric_member_ref(void);
 
 #endif // OTTER_TRACE_UNIQUE_REFS_H
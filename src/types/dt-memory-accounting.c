@@ -0,0 +1,43 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "public/types/memory-accounting.h"
+
+static size_t current[otter_mem_n_categories] = {0};
+static size_t high_water[otter_mem_n_categories] = {0};
+
+static const char *category_name[otter_mem_n_categories] = {
+    [otter_mem_string_registry] = "STRING_REGISTRY",
+    [otter_mem_task_manager] = "TASK_MANAGER",
+    [otter_mem_task_context] = "TASK_CONTEXT",
+    [otter_mem_region_def] = "REGION_DEF",
+    [otter_mem_queue_stack] = "QUEUE_STACK",
+    [otter_mem_otf2_chunks] = "OTF2_CHUNKS",
+    [otter_mem_dependences] = "DEPENDENCES",
+};
+
+void otter_mem_alloc(otter_mem_category_t category, size_t bytes) {
+  size_t now =
+      __atomic_add_fetch(&current[category], bytes, __ATOMIC_RELAXED);
+  size_t peak = __atomic_load_n(&high_water[category], __ATOMIC_RELAXED);
+  while (now > peak &&
+         !__atomic_compare_exchange_n(&high_water[category], &peak, now, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+void otter_mem_free(otter_mem_category_t category, size_t bytes) {
+  __atomic_sub_fetch(&current[category], bytes, __ATOMIC_RELAXED);
+}
+
+size_t otter_mem_current(otter_mem_category_t category) {
+  return __atomic_load_n(&current[category], __ATOMIC_RELAXED);
+}
+
+size_t otter_mem_high_water(otter_mem_category_t category) {
+  return __atomic_load_n(&high_water[category], __ATOMIC_RELAXED);
+}
+
+const char *otter_mem_category_name(otter_mem_category_t category) {
+  return category < otter_mem_n_categories ? category_name[category] : "";
+}
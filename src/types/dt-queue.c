@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include "public/debug.h"
+#include "public/types/memory-accounting.h"
 #include "public/types/queue.h"
 
 typedef struct node_t node_t;
@@ -24,6 +25,7 @@ otter_queue_t *queue_create(void) {
     LOG_ERROR("failed to create queue");
     return NULL;
   }
+  otter_mem_alloc(otter_mem_queue_stack, sizeof(*q));
   LOG_DEBUG("%p", q);
   q->head = q->tail = NULL;
   q->length = 0;
@@ -43,6 +45,7 @@ bool queue_push(otter_queue_t *q, data_item_t item) {
     return false;
   }
 
+  otter_mem_alloc(otter_mem_queue_stack, sizeof(*node));
   node->data = item;
   node->next = NULL;
 
@@ -80,6 +83,7 @@ bool queue_pop(otter_queue_t *q, data_item_t *dest) {
   LOG_WARN_IF(
       dest == NULL,
       "queue popped item without returning value (null destination pointer)");
+  otter_mem_free(otter_mem_queue_stack, sizeof(*node));
   free(node);
 
   return true;
@@ -123,6 +127,7 @@ void queue_destroy(otter_queue_t *q, bool items, data_destructor_t destructor) {
       destructor != NULL ? destructor(d.ptr) : free(d.ptr);
   }
   LOG_DEBUG("%p", q);
+  otter_mem_free(otter_mem_queue_stack, sizeof(*q));
   free(q);
   return;
 }
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include "public/debug.h"
+#include "public/types/memory-accounting.h"
 #include "public/types/stack.h"
 
 typedef struct node_t node_t;
@@ -24,6 +25,7 @@ otter_stack_t *stack_create(void) {
     LOG_ERROR("failed to create stack");
     return NULL;
   }
+  otter_mem_alloc(otter_mem_queue_stack, sizeof(*s));
   LOG_DEBUG("%p", s);
   s->head = NULL;
   s->base = NULL;
@@ -44,6 +46,7 @@ bool stack_push(otter_stack_t *s, data_item_t item) {
     return false;
   }
 
+  otter_mem_alloc(otter_mem_queue_stack, sizeof(*node));
   node->data = item;
   node->next = s->head;
   s->head = node;
@@ -73,6 +76,7 @@ bool stack_pop(otter_stack_t *s, data_item_t *dest) {
       *dest = node->data;
     s->head = s->head->next;
     s->size -= 1;
+    otter_mem_free(otter_mem_queue_stack, sizeof(*node));
     free(node);
   }
   if (s->size == 0)
@@ -112,10 +116,40 @@ void stack_destroy(otter_stack_t *s, bool items, data_destructor_t destructor) {
       destructor != NULL ? destructor(d.ptr) : free(d.ptr);
   }
   LOG_DEBUG("%p", s);
+  otter_mem_free(otter_mem_queue_stack, sizeof(*s));
   free(s);
   return;
 }
 
+bool stack_remove(otter_stack_t *s, data_item_t item) {
+  if (s == NULL) {
+    LOG_WARN("stack is null");
+    return false;
+  }
+
+  node_t *prev = NULL;
+  node_t *node = s->head;
+  while (node != NULL && node->data.value != item.value) {
+    prev = node;
+    node = node->next;
+  }
+  if (node == NULL)
+    return false;
+
+  if (prev == NULL)
+    s->head = node->next;
+  else
+    prev->next = node->next;
+  if (s->base == node)
+    s->base = prev;
+  s->size -= 1;
+  otter_mem_free(otter_mem_queue_stack, sizeof(*node));
+  free(node);
+  LOG_DEBUG("%p removed %p", s, item.ptr);
+
+  return true;
+}
+
 bool stack_transfer(otter_stack_t *dest, otter_stack_t *src) {
   if (dest == NULL) {
     LOG_ERROR("Cannot transfer to null stack.");
@@ -0,0 +1,171 @@
+#include "public/types/interval_map.hpp"
+#include "public/types/memory-accounting.h"
+#include <iterator>
+#include <map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+/* The accesses to [start, end), where start is the key of the interval */
+struct interval {
+  uintptr_t end;
+  bool written;
+  uint64_t writer;
+  std::vector<uint64_t> readers;
+
+  bool same_accesses(const interval &other) const {
+    return written == other.written && writer == other.writer &&
+           readers == other.readers;
+  }
+};
+} // namespace
+
+struct interval_map {
+  using mapping = std::map<uintptr_t, interval>;
+  mapping i_map;
+  uint64_t last_task{0};                // the task which made the last access
+  std::unordered_set<uint64_t> i_preds; // edges already reported to last_task
+  std::size_t bytes{0}; // estimated heap memory held by the map
+};
+
+/* Estimate the heap memory held by one node of the map */
+static std::size_t node_bytes(const interval &value) {
+  return 4 * sizeof(void *) + sizeof(uintptr_t) + sizeof(interval) +
+         value.readers.capacity() * sizeof(uint64_t);
+}
+
+/* Update the memory accounted to the map after it changes */
+static void account_bytes(interval_map *map, std::size_t bytes) {
+  if (bytes > map->bytes) {
+    otter_mem_alloc(otter_mem_dependences, bytes - map->bytes);
+  } else if (bytes < map->bytes) {
+    otter_mem_free(otter_mem_dependences, map->bytes - bytes);
+  }
+  map->bytes = bytes;
+}
+
+/* Split the interval containing addr (if any) so that an interval starts at
+   addr */
+static void split_at(interval_map *map, uintptr_t addr) {
+  auto next = map->i_map.upper_bound(addr);
+  if (next == map->i_map.begin()) {
+    return;
+  }
+  auto item = std::prev(next);
+  if (item->first == addr || item->second.end <= addr) {
+    return;
+  }
+  interval upper = item->second;
+  item->second.end = addr;
+  auto added = map->i_map.emplace_hint(next, addr, std::move(upper));
+  account_bytes(map, map->bytes + node_bytes(added->second));
+}
+
+/* Merge the interval at item into its predecessor if they are adjacent and
+   have the same accesses */
+static void merge_with_prev(interval_map *map,
+                            interval_map::mapping::iterator item) {
+  if (item == map->i_map.begin() || item == map->i_map.end()) {
+    return;
+  }
+  auto prev = std::prev(item);
+  if (prev->second.end == item->first &&
+      prev->second.same_accesses(item->second)) {
+    prev->second.end = item->second.end;
+    account_bytes(map, map->bytes - node_bytes(item->second));
+    map->i_map.erase(item);
+  }
+}
+
+static void report_edge(interval_map *map, uint64_t pred, uint64_t task,
+                        interval_map_edge_callback *callback, void *data) {
+  if (pred == task || !map->i_preds.insert(pred).second) {
+    return;
+  }
+  if (callback) {
+    callback(pred, task, data);
+  }
+}
+
+// C wrappers
+
+interval_map *interval_map_make() {
+  interval_map *map = new interval_map();
+  account_bytes(map, sizeof(*map));
+  return map;
+}
+
+void interval_map_delete(interval_map *map) {
+  account_bytes(map, 0);
+  delete map;
+}
+
+void interval_map_access(interval_map *map, uintptr_t start, size_t bytes,
+                         uint64_t task, bool write,
+                         interval_map_edge_callback *callback, void *data) {
+  if (bytes == 0) {
+    return;
+  }
+  uintptr_t end = start + bytes;
+  if (task != map->last_task) {
+    map->last_task = task;
+    map->i_preds.clear();
+  }
+
+  auto &intervals = map->i_map;
+  split_at(map, start);
+  split_at(map, end);
+
+  // Fill any gaps in [start, end) with intervals not yet accessed
+  uintptr_t addr = start;
+  auto item = intervals.lower_bound(start);
+  while (addr < end) {
+    if (item == intervals.end() || item->first > addr) {
+      uintptr_t gap_end =
+          (item == intervals.end() || item->first > end) ? end : item->first;
+      item = intervals.emplace_hint(item, addr,
+                                    interval{gap_end, false, 0, {}});
+      account_bytes(map, map->bytes + node_bytes(item->second));
+    }
+    addr = item->second.end;
+    ++item;
+  }
+
+  // Report the edges of each interval then record this access
+  auto first = intervals.lower_bound(start);
+  for (item = first; item != intervals.end() && item->first < end; ++item) {
+    interval &value = item->second;
+    std::size_t before = node_bytes(value);
+    if (!write) {
+      if (value.written) {
+        report_edge(map, value.writer, task, callback, data);
+      }
+      if (value.readers.empty() || value.readers.back() != task) {
+        value.readers.push_back(task);
+      }
+    } else {
+      if (!value.readers.empty()) {
+        for (uint64_t reader : value.readers) {
+          report_edge(map, reader, task, callback, data);
+        }
+      } else if (value.written) {
+        report_edge(map, value.writer, task, callback, data);
+      }
+      value.written = true;
+      value.writer = task;
+      value.readers.clear();
+      value.readers.shrink_to_fit();
+    }
+    account_bytes(map, map->bytes - before + node_bytes(value));
+  }
+
+  // Merge neighbouring intervals which now have the same accesses
+  item = first;
+  while (item != intervals.end() && item->first <= end) {
+    auto next = std::next(item);
+    merge_with_prev(map, item);
+    item = next;
+  }
+}
+
+size_t interval_map_size(interval_map *map) { return map->i_map.size(); }
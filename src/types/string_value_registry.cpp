@@ -1,20 +1,60 @@
 #include "public/types/string_value_registry.hpp"
+#include "public/types/memory-accounting.h"
 #include <cassert>
+#include <list>
 #include <string>
 #include <unordered_map>
 
 struct string_registry {
-  using mapping = std::unordered_map<std::string, uint32_t>;
-  using mapped_type = mapping::mapped_type;
+  // keys of label_map from most to least recently used, if bounded
+  using recency_list = std::list<const std::string *>;
+  struct entry {
+    uint32_t label;
+    recency_list::iterator position;
+  };
+  using mapping = std::unordered_map<std::string, entry>;
   mapping label_map;
+  recency_list recency;
   labeller_fn *get_label;
-  const mapped_type default_label{};
+  const uint32_t default_label{};
+  std::size_t capacity{0}; // most keys kept, 0 if unbounded
+  uint64_t evictions{0};
+  std::size_t bytes{0}; // estimated heap memory held by label_map & recency
 };
 
+/* Heap memory held by one node of a std::list */
+static constexpr std::size_t list_node_bytes =
+    2 * sizeof(void *) + sizeof(const std::string *);
+
+/* Update the memory accounted to the registry after label_map changes */
+static void account_bytes(string_registry *registry, std::size_t bytes) {
+  if (bytes > registry->bytes) {
+    otter_mem_alloc(otter_mem_string_registry, bytes - registry->bytes);
+  } else if (bytes < registry->bytes) {
+    otter_mem_free(otter_mem_string_registry, registry->bytes - bytes);
+  }
+  registry->bytes = bytes;
+}
+
+/* Memory held for one key of label_map */
+static std::size_t key_bytes(const string_registry *registry,
+                             const std::string &key) {
+  return otter_mem_map_node_bytes(key, sizeof(string_registry::entry)) +
+         (registry->capacity ? list_node_bytes : 0);
+}
+
 string_registry *string_registry_make(labeller_fn *labeller) {
+  return string_registry_make_bounded(labeller, 0);
+}
+
+string_registry *string_registry_make_bounded(labeller_fn *labeller,
+                                              size_t capacity) {
   assert(labeller != nullptr);
   string_registry *registry = new string_registry{};
   registry->get_label = labeller;
+  registry->capacity = capacity;
+  account_bytes(registry, sizeof(*registry) +
+                              otter_mem_map_bucket_bytes(registry->label_map));
   return registry;
 }
 
@@ -22,21 +62,66 @@ void string_registry_apply(string_registry *registry,
                            string_registry_callback *callback, void *data) {
   assert(callback != NULL);
   for (auto &[key, value] : registry->label_map) {
-    callback(key.c_str(), value, data);
+    callback(key.c_str(), value.label, data);
   }
 }
 
 void string_registry_delete(string_registry *registry) {
   assert(registry != NULL);
+  account_bytes(registry, 0);
   delete registry;
 }
 
 uint32_t string_registry_insert(string_registry *registry, const char *str) {
+  bool inserted = false;
+  return string_registry_try_insert(registry, str, &inserted);
+}
+
+/* Evict the least recently used key of a full bounded registry */
+static void evict_lru(string_registry *registry) {
+  const std::string *key = registry->recency.back();
+  std::size_t bytes = registry->bytes - key_bytes(registry, *key);
+  registry->recency.pop_back();
+  registry->label_map.erase(*key);
+  registry->evictions++;
+  account_bytes(registry, bytes);
+}
+
+uint32_t string_registry_try_insert(string_registry *registry, const char *str,
+                                    bool *inserted) {
   assert(registry != NULL);
-  auto label = registry->label_map[str];
-  if (label == registry->default_label) {
-    label = registry->get_label();
-    registry->label_map[str] = label;
+  auto buckets = registry->label_map.bucket_count();
+  auto [entry, is_new] = registry->label_map.try_emplace(
+      str, string_registry::entry{registry->default_label, {}});
+  *inserted = false;
+  if (entry->second.label == registry->default_label) {
+    entry->second.label = registry->get_label();
+    *inserted = true;
+  }
+  if (is_new) {
+    std::size_t bytes = registry->bytes + key_bytes(registry, entry->first);
+    bytes += (registry->label_map.bucket_count() - buckets) * sizeof(void *);
+    account_bytes(registry, bytes);
+    if (registry->capacity) {
+      registry->recency.push_front(&entry->first);
+      entry->second.position = registry->recency.begin();
+      if (registry->label_map.size() > registry->capacity) {
+        evict_lru(registry);
+      }
+    }
+  } else if (registry->capacity) {
+    registry->recency.splice(registry->recency.begin(), registry->recency,
+                             entry->second.position);
   }
-  return label;
+  return entry->second.label;
+}
+
+size_t string_registry_size(const string_registry *registry) {
+  assert(registry != NULL);
+  return registry->label_map.size();
+}
+
+uint64_t string_registry_evictions(const string_registry *registry) {
+  assert(registry != NULL);
+  return registry->evictions;
 }
@@ -1,4 +1,5 @@
 #include "public/types/vptr_manager.hpp"
+#include "public/types/memory-accounting.h"
 #include <string>
 #include <unordered_map>
 
@@ -6,11 +7,40 @@ struct vptr_manager {
   using mapping = std::unordered_map<std::string, void *>;
   mapping i_map;
   std::unordered_map<mapping::key_type, int> i_count;
+  std::size_t bytes{0}; // estimated heap memory held by the maps
 };
 
+/* Update the memory accounted to the manager after its maps change */
+static void account_bytes(vptr_manager *manager, std::size_t bytes) {
+  if (bytes > manager->bytes) {
+    otter_mem_alloc(otter_mem_task_manager, bytes - manager->bytes);
+  } else if (bytes < manager->bytes) {
+    otter_mem_free(otter_mem_task_manager, manager->bytes - bytes);
+  }
+  manager->bytes = bytes;
+}
+
+/* Account for a node added to or removed from one of the manager's maps */
+template <typename Map>
+static void account_node(vptr_manager *manager, const Map &map,
+                         const std::string &key, std::size_t buckets,
+                         bool added) {
+  std::size_t node = otter_mem_map_node_bytes(
+      key, sizeof(typename Map::mapped_type));
+  std::size_t bytes = added ? manager->bytes + node : manager->bytes - node;
+  account_bytes(manager, bytes + (map.bucket_count() - buckets) *
+                                     sizeof(void *));
+}
+
 // C wrappers
 
-vptr_manager *vptr_manager_make() { return new vptr_manager(); }
+vptr_manager *vptr_manager_make() {
+  vptr_manager *manager = new vptr_manager();
+  account_bytes(manager, sizeof(*manager) +
+                             otter_mem_map_bucket_bytes(manager->i_map) +
+                             otter_mem_map_bucket_bytes(manager->i_count));
+  return manager;
+}
 
 void vptr_manager_count_inserts(vptr_manager *manager, vptr_callback *callback,
                                 void *data) {
@@ -21,28 +51,56 @@ void vptr_manager_count_inserts(vptr_manager *manager, vptr_callback *callback,
   }
 }
 
-void vptr_manager_delete(vptr_manager *manager) { delete manager; }
+void vptr_manager_delete(vptr_manager *manager) {
+  account_bytes(manager, 0);
+  delete manager;
+}
 
 void vptr_manager_insert_item(vptr_manager *manager, const char *s,
                               void *value) {
   vptr_manager::mapping::key_type key(s);
-  manager->i_map[key] = value;
-  manager->i_count[key]++;
+  auto buckets = manager->i_map.bucket_count();
+  auto [item, inserted] = manager->i_map.insert_or_assign(key, value);
+  if (inserted) {
+    account_node(manager, manager->i_map, item->first, buckets, true);
+  }
+  buckets = manager->i_count.bucket_count();
+  auto [count, counted] = manager->i_count.try_emplace(key, 0);
+  count->second++;
+  if (counted) {
+    account_node(manager, manager->i_count, count->first, buckets, true);
+  }
   return;
 }
 
 void vptr_manager_delete_item(vptr_manager *manager, const char *s) {
-  manager->i_map.erase(vptr_manager::mapping::key_type(s));
+  auto item = manager->i_map.find(vptr_manager::mapping::key_type(s));
+  if (item != manager->i_map.end()) {
+    auto buckets = manager->i_map.bucket_count();
+    account_node(manager, manager->i_map, item->first, buckets, false);
+    manager->i_map.erase(item);
+  }
   return;
 }
 
 void *vptr_manager_get_item(vptr_manager *manager, const char *s) {
-  return manager->i_map[vptr_manager::mapping::key_type(s)];
+  auto buckets = manager->i_map.bucket_count();
+  auto [item, inserted] =
+      manager->i_map.try_emplace(vptr_manager::mapping::key_type(s), nullptr);
+  if (inserted) {
+    account_node(manager, manager->i_map, item->first, buckets, true);
+  }
+  return item->second;
 }
 
 void *vptr_manager_pop_item(vptr_manager *manager, const char *s) {
-  vptr_manager::mapping::key_type key(s);
-  vptr_manager::mapping::mapped_type value = manager->i_map[key];
-  manager->i_map.erase(key);
+  auto item = manager->i_map.find(vptr_manager::mapping::key_type(s));
+  if (item == manager->i_map.end()) {
+    return nullptr;
+  }
+  vptr_manager::mapping::mapped_type value = item->second;
+  auto buckets = manager->i_map.bucket_count();
+  account_node(manager, manager->i_map, item->first, buckets, false);
+  manager->i_map.erase(item);
   return value;
 }
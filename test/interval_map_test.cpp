@@ -0,0 +1,124 @@
+#include "public/types/interval_map.hpp"
+#include <gtest/gtest.h>
+#include <utility>
+#include <vector>
+
+using edge_list = std::vector<std::pair<uint64_t, uint64_t>>;
+
+static void store_edge(uint64_t pred, uint64_t succ, void *data) {
+  static_cast<edge_list *>(data)->emplace_back(pred, succ);
+}
+
+namespace {
+class TestIntervalMap : public testing::Test {
+protected:
+  interval_map *m1;
+  edge_list edges;
+
+  void SetUp() override {
+    m1 = interval_map_make();
+    edges.clear();
+  }
+
+  virtual void TearDown() override {
+    if (m1) {
+      interval_map_delete(m1);
+      m1 = nullptr;
+    }
+  }
+
+  void Read(uintptr_t start, size_t bytes, uint64_t task) {
+    interval_map_access(m1, start, bytes, task, false, store_edge, &edges);
+  }
+
+  void Write(uintptr_t start, size_t bytes, uint64_t task) {
+    interval_map_access(m1, start, bytes, task, true, store_edge, &edges);
+  }
+};
+
+} // namespace
+
+/*** TESTS ***/
+
+TEST_F(TestIntervalMap, IsNonNull) { ASSERT_NE(m1, nullptr); }
+
+TEST_F(TestIntervalMap, IsEmpty) { ASSERT_EQ(interval_map_size(m1), 0); }
+
+TEST_F(TestIntervalMap, FirstAccessHasNoEdges) {
+  Write(100, 10, 1);
+  Read(200, 10, 2);
+  ASSERT_TRUE(edges.empty());
+  ASSERT_EQ(interval_map_size(m1), 2);
+}
+
+TEST_F(TestIntervalMap, ReadAfterWrite) {
+  Write(100, 10, 1);
+  Read(105, 10, 2);
+  ASSERT_EQ(edges, (edge_list{{1, 2}}));
+}
+
+TEST_F(TestIntervalMap, WriteAfterReads) {
+  Write(100, 10, 1);
+  Read(100, 10, 2);
+  Read(100, 10, 3);
+  edges.clear();
+  Write(100, 10, 4);
+  ASSERT_EQ(edges, (edge_list{{2, 4}, {3, 4}}));
+}
+
+TEST_F(TestIntervalMap, WriteAfterWrite) {
+  Write(100, 10, 1);
+  Write(100, 10, 2);
+  ASSERT_EQ(edges, (edge_list{{1, 2}}));
+}
+
+TEST_F(TestIntervalMap, ReadsAreIndependent) {
+  Read(100, 10, 1);
+  Read(100, 10, 2);
+  ASSERT_TRUE(edges.empty());
+}
+
+TEST_F(TestIntervalMap, DisjointRangesAreIndependent) {
+  Write(100, 10, 1);
+  Write(110, 10, 2);
+  Read(120, 10, 3);
+  ASSERT_TRUE(edges.empty());
+}
+
+TEST_F(TestIntervalMap, OverlappingWritesSplitRanges) {
+  Write(100, 10, 1);
+  Write(110, 10, 2);
+  Read(105, 10, 3);
+  ASSERT_EQ(edges, (edge_list{{1, 3}, {2, 3}}));
+  Write(100, 20, 4);
+  ASSERT_EQ(edges, (edge_list{{1, 3}, {2, 3}, {1, 4}, {3, 4}, {2, 4}}));
+}
+
+TEST_F(TestIntervalMap, EdgesReportedOncePerTask) {
+  Write(100, 10, 1);
+  Read(100, 5, 2);
+  Read(105, 5, 2);
+  ASSERT_EQ(edges, (edge_list{{1, 2}}));
+}
+
+TEST_F(TestIntervalMap, NoSelfEdges) {
+  Write(100, 10, 1);
+  Read(100, 10, 1);
+  Write(100, 10, 1);
+  ASSERT_TRUE(edges.empty());
+}
+
+TEST_F(TestIntervalMap, AdjacentIdenticalRangesMerge) {
+  Write(100, 10, 1);
+  Write(110, 10, 1);
+  ASSERT_EQ(interval_map_size(m1), 1);
+  Write(105, 10, 2);
+  ASSERT_EQ(interval_map_size(m1), 3);
+  Write(100, 20, 3);
+  ASSERT_EQ(interval_map_size(m1), 1);
+}
+
+TEST_F(TestIntervalMap, ZeroBytesIgnored) {
+  Write(100, 0, 1);
+  ASSERT_EQ(interval_map_size(m1), 0);
+}
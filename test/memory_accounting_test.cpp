@@ -0,0 +1,86 @@
+#include "public/types/memory-accounting.h"
+#include "public/types/queue.h"
+#include "public/types/stack.h"
+#include "public/types/string_value_registry.hpp"
+#include "public/types/vptr_manager.hpp"
+#include <gtest/gtest.h>
+
+static uint32_t mock_labeller(void) {
+  static uint32_t label = 0;
+  return ++label;
+}
+
+TEST(MemoryAccounting, AllocIncreasesCurrent) {
+  size_t before = otter_mem_current(otter_mem_region_def);
+  otter_mem_alloc(otter_mem_region_def, 64);
+  ASSERT_EQ(otter_mem_current(otter_mem_region_def), before + 64);
+  otter_mem_free(otter_mem_region_def, 64);
+  ASSERT_EQ(otter_mem_current(otter_mem_region_def), before);
+}
+
+TEST(MemoryAccounting, HighWaterIsKeptAfterFree) {
+  size_t before = otter_mem_current(otter_mem_task_context);
+  otter_mem_alloc(otter_mem_task_context, 1000);
+  otter_mem_free(otter_mem_task_context, 1000);
+  ASSERT_GE(otter_mem_high_water(otter_mem_task_context), before + 1000);
+  ASSERT_EQ(otter_mem_current(otter_mem_task_context), before);
+}
+
+TEST(MemoryAccounting, CategoriesAreIndependent) {
+  size_t before = otter_mem_current(otter_mem_otf2_chunks);
+  otter_mem_alloc(otter_mem_region_def, 32);
+  ASSERT_EQ(otter_mem_current(otter_mem_otf2_chunks), before);
+  otter_mem_free(otter_mem_region_def, 32);
+}
+
+TEST(MemoryAccounting, CategoriesAreNamed) {
+  ASSERT_STREQ(otter_mem_category_name(otter_mem_string_registry),
+               "STRING_REGISTRY");
+  ASSERT_STREQ(otter_mem_category_name(otter_mem_n_categories), "");
+}
+
+TEST(MemoryAccounting, QueueIsBalanced) {
+  size_t before = otter_mem_current(otter_mem_queue_stack);
+  otter_queue_t *q = queue_create();
+  queue_push(q, data_item_t{.value = 1});
+  queue_push(q, data_item_t{.value = 2});
+  ASSERT_GT(otter_mem_current(otter_mem_queue_stack), before);
+  queue_destroy(q, false, nullptr);
+  ASSERT_EQ(otter_mem_current(otter_mem_queue_stack), before);
+}
+
+TEST(MemoryAccounting, StackIsBalanced) {
+  size_t before = otter_mem_current(otter_mem_queue_stack);
+  otter_stack_t *s = stack_create();
+  stack_push(s, data_item_t{.value = 1});
+  ASSERT_GT(otter_mem_current(otter_mem_queue_stack), before);
+  data_item_t item;
+  stack_pop(s, &item);
+  stack_destroy(s, false, nullptr);
+  ASSERT_EQ(otter_mem_current(otter_mem_queue_stack), before);
+}
+
+TEST(MemoryAccounting, StringRegistryIsBalanced) {
+  size_t before = otter_mem_current(otter_mem_string_registry);
+  string_registry *registry = string_registry_make(mock_labeller);
+  size_t empty = otter_mem_current(otter_mem_string_registry);
+  string_registry_insert(registry, "a string long enough to be on the heap");
+  string_registry_insert(registry, "a string long enough to be on the heap");
+  ASSERT_GT(otter_mem_current(otter_mem_string_registry), empty);
+  string_registry_delete(registry);
+  ASSERT_EQ(otter_mem_current(otter_mem_string_registry), before);
+}
+
+TEST(MemoryAccounting, VptrManagerIsBalanced) {
+  size_t before = otter_mem_current(otter_mem_task_manager);
+  vptr_manager *manager = vptr_manager_make();
+  size_t empty = otter_mem_current(otter_mem_task_manager);
+  int value = 0;
+  vptr_manager_insert_item(manager, "key", &value);
+  size_t inserted = otter_mem_current(otter_mem_task_manager);
+  ASSERT_GT(inserted, empty);
+  ASSERT_EQ(vptr_manager_pop_item(manager, "key"), &value);
+  ASSERT_LT(otter_mem_current(otter_mem_task_manager), inserted);
+  vptr_manager_delete(manager);
+  ASSERT_EQ(otter_mem_current(otter_mem_task_manager), before);
+}
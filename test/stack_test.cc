@@ -178,6 +178,55 @@ TEST_F(StackTestFxt, ItemsReturnedLIFO) {
   ASSERT_EQ(item4.value, 1);
 }
 
+// Remove Items
+
+TEST_F(StackTestFxt, RemoveNullStackIsFalse) {
+  data_item_t item{.value = 1};
+  ASSERT_FALSE(stack_remove(nullptr, item));
+}
+
+TEST_F(StackTestFxt, RemoveAbsentItemIsFalse) {
+  data_item_t item1{.value = 1};
+  data_item_t item2{.value = 2};
+  ASSERT_TRUE(stack_push(s1, item1));
+  ASSERT_FALSE(stack_remove(s1, item2));
+  ASSERT_EQ(stack_size(s1), 1);
+}
+
+TEST_F(StackTestFxt, RemoveMiddleItemKeepsOrder) {
+  data_item_t item1{.value = 1};
+  data_item_t item2{.value = 2};
+  data_item_t item3{.value = 3};
+  data_item_t item4{.value = 0};
+  ASSERT_TRUE(stack_push(s1, item1));
+  ASSERT_TRUE(stack_push(s1, item2));
+  ASSERT_TRUE(stack_push(s1, item3));
+  ASSERT_TRUE(stack_remove(s1, item2));
+  ASSERT_EQ(stack_size(s1), 2);
+  ASSERT_TRUE(stack_pop(s1, &item4));
+  ASSERT_EQ(item4.value, 3);
+  ASSERT_TRUE(stack_pop(s1, &item4));
+  ASSERT_EQ(item4.value, 1);
+  ASSERT_TRUE(stack_is_empty(s1));
+}
+
+TEST_F(StackTestFxt, RemoveBaseItemThenTransfer) {
+  data_item_t item1{.value = 1};
+  data_item_t item2{.value = 2};
+  data_item_t item3{.value = 3};
+  data_item_t item4{.value = 0};
+  ASSERT_TRUE(stack_push(s2, item1));
+  ASSERT_TRUE(stack_push(s2, item2));
+  ASSERT_TRUE(stack_remove(s2, item1));
+  ASSERT_TRUE(stack_push(s1, item3));
+  ASSERT_TRUE(stack_transfer(s1, s2));
+  ASSERT_EQ(stack_size(s1), 2);
+  ASSERT_TRUE(stack_pop(s1, &item4));
+  ASSERT_EQ(item4.value, 2);
+  ASSERT_TRUE(stack_pop(s1, &item4));
+  ASSERT_EQ(item4.value, 3);
+}
+
 // Transfer Items
 
 TEST_F(StackTestFxt, TransferToNullStackIsFalse) {
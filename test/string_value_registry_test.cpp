@@ -211,3 +211,49 @@ TEST_F(TestStringRegistry_C, ArgOutlivesScope) {
   ASSERT_EQ(inserted, 3);
   ASSERT_EQ(deleted, 0);
 }
+
+TEST_F(TestStringRegistry_C, TryInsertReportsNewKeys) {
+  bool inserted = false;
+  TestStringRegistry::label_type id1 =
+      string_registry_try_insert(r, "foo", &inserted);
+  ASSERT_TRUE(inserted);
+  TestStringRegistry::label_type id2 =
+      string_registry_try_insert(r, "foo", &inserted);
+  ASSERT_FALSE(inserted);
+  ASSERT_EQ(id1, id2);
+}
+
+TEST_F(TestStringRegistry_C, BoundedEvictsLeastRecentlyUsed) {
+  t = string_registry_make_bounded(mock_labeller, 2);
+  bool inserted = false;
+  TestStringRegistry::label_type foo = string_registry_insert(t, "foo");
+  string_registry_insert(t, "bar");
+  string_registry_insert(t, "foo"); // "bar" is now least recently used
+  string_registry_insert(t, "baz"); // evicts "bar"
+  ASSERT_EQ(string_registry_size(t), 2);
+  ASSERT_EQ(string_registry_evictions(t), 1);
+  ASSERT_EQ(string_registry_try_insert(t, "foo", &inserted), foo);
+  ASSERT_FALSE(inserted);
+  string_registry_try_insert(t, "bar", &inserted);
+  ASSERT_TRUE(inserted);
+  TestStringRegistry::SafeDelete(t, nullptr, nullptr);
+}
+
+TEST_F(TestStringRegistry_C, EvictedKeyGetsNewLabel) {
+  t = string_registry_make_bounded(mock_labeller, 1);
+  TestStringRegistry::label_type id1 = string_registry_insert(t, "foo");
+  string_registry_insert(t, "bar");
+  TestStringRegistry::label_type id2 = string_registry_insert(t, "foo");
+  ASSERT_NE(id1, id2);
+  ASSERT_EQ(string_registry_size(t), 1);
+  TestStringRegistry::SafeDelete(t, nullptr, nullptr);
+}
+
+TEST_F(TestStringRegistry_C, UnboundedNeverEvicts) {
+  const char *keys[] = {"foo", "bar", "baz"};
+  for (auto &key : keys) {
+    string_registry_insert(r, key);
+  }
+  ASSERT_EQ(string_registry_size(r), 3);
+  ASSERT_EQ(string_registry_evictions(r), 0);
+}
@@ -0,0 +1,89 @@
+#include "api/otter-task-graph/otter-task-graph-user.h"
+#include "public/otter-environment-variables.h"
+extern "C" {
+#include "public/otter-trace/trace-task-context-interface.h"
+}
+#include "public/types/memory-accounting.h"
+#include <condition_variable>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <thread>
+
+/* Trace with coalescing enabled, so that task events are deferred, but with a
+   threshold so short that tasks are hardly ever coalesced */
+class TaskGraphEnvironment : public ::testing::Environment {
+public:
+  void SetUp() override {
+    setenv(ENV_VAR_TRACE_PATH, ::testing::TempDir().c_str(), 1);
+    setenv(ENV_VAR_COALESCE_THRESHOLD, "1", 1);
+    OTTER_INITIALISE();
+  }
+  void TearDown() override { OTTER_FINALISE(); }
+};
+
+static ::testing::Environment *const environment =
+    ::testing::AddGlobalTestEnvironment(new TaskGraphEnvironment);
+
+TEST(TaskGraph, IdOfNullTaskIsUndefined) {
+  ASSERT_EQ(otterTaskGetId(OTTER_NULL_TASK), UINT64_MAX);
+}
+
+TEST(TaskGraph, GettingIdPreventsCoalescing) {
+  OTTER_DEFINE_TASK(task, OTTER_NULL_TASK, otter_no_add_to_pool, "task");
+  OTTER_TASK_START(task);
+  ASSERT_FALSE(otterTaskContext_get_deferred_events(task) &
+               otter_deferred_keep);
+  OTTER_TASK_GET_ID(task);
+  ASSERT_TRUE(otterTaskContext_get_deferred_events(task) &
+              otter_deferred_keep);
+  OTTER_TASK_END(task);
+}
+
+TEST(TaskGraph, DependsOnEndedPredecessor) {
+  OTTER_DEFINE_TASK(producer, OTTER_NULL_TASK, otter_no_add_to_pool, "prod");
+  OTTER_TASK_START(producer);
+  uint64_t produced = OTTER_TASK_GET_ID(producer);
+  OTTER_TASK_END(producer);
+
+  OTTER_DEFINE_TASK(consumer, OTTER_NULL_TASK, otter_no_add_to_pool, "cons");
+  OTTER_TASK_DEPENDS_ON_ID(consumer, produced);
+  ASSERT_TRUE(otterTaskContext_get_deferred_events(consumer) &
+              otter_deferred_keep);
+  OTTER_TASK_START(consumer);
+  OTTER_TASK_END(consumer);
+}
+
+TEST(TaskGraph, TasksRunByAnotherThreadAreReleased) {
+  const int n_tasks = 5000;
+  otter_task_context *handoff = OTTER_NULL_TASK;
+  std::mutex lock;
+  std::condition_variable changed;
+
+  std::thread consumer([&] {
+    for (int k = 0; k < n_tasks; k++) {
+      std::unique_lock<std::mutex> guard(lock);
+      changed.wait(guard, [&] { return handoff != OTTER_NULL_TASK; });
+      otter_task_context *task = handoff;
+      handoff = OTTER_NULL_TASK;
+      changed.notify_all();
+      guard.unlock();
+      OTTER_TASK_START(task);
+      OTTER_TASK_END(task);
+    }
+  });
+
+  // this thread only creates tasks, so never records an event of its own
+  for (int k = 0; k < n_tasks; k++) {
+    OTTER_DEFINE_TASK(task, OTTER_NULL_TASK, otter_no_add_to_pool, "task");
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [&] { return handoff == OTTER_NULL_TASK; });
+    handoff = task;
+    changed.notify_all();
+  }
+  consumer.join();
+
+  // only a few tasks are ever alive at once
+  ASSERT_LT(otter_mem_high_water(otter_mem_task_context),
+            (size_t)64 * 1024);
+}